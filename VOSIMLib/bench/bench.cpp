@@ -83,12 +83,12 @@ NONIUS_BENCHMARK("[math][tanh] syn::fast_tanh_rat", [](nonius::chronometer& mete
 NONIUS_BENCHMARK("[units][filters] LadderA", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::LadderFilterA ladder("");
-    double input = 1.0;
+    syn::Sample input = 1.0;
     ladder.setFs(48000.0);
     ladder.setParam(syn::LadderFilterA::pFc, 10000.0);
     ladder.setParam(syn::LadderFilterA::pFb, 0.0);
     ladder.setParam(syn::LadderFilterA::pDrv, 0.0);
-    ladder.connectInput(0, syn::ReadOnlyBuffer<double>{ &input });
+    ladder.connectInput(0, syn::ReadOnlyBuffer<syn::Sample>{ &input });
 
     double x;
     meter.measure([&x, &ladder](int i)
@@ -102,12 +102,12 @@ NONIUS_BENCHMARK("[units][filters] LadderA", [](nonius::chronometer& meter) {
 NONIUS_BENCHMARK("[units][filters] LadderB", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::LadderFilterB ladder("");
-    double input = 1.0;
+    syn::Sample input = 1.0;
     ladder.setFs(48000.0);
     ladder.setParam(syn::LadderFilterA::pFc, 10000.0);
     ladder.setParam(syn::LadderFilterA::pFb, 0.0);
     ladder.setParam(syn::LadderFilterA::pDrv, 0.0);
-    ladder.connectInput(0, syn::ReadOnlyBuffer<double>{ &input });
+    ladder.connectInput(0, syn::ReadOnlyBuffer<syn::Sample>{ &input });
 
     double x;
     meter.measure([&x, &ladder](int i)
@@ -121,11 +121,11 @@ NONIUS_BENCHMARK("[units][filters] LadderB", [](nonius::chronometer& meter) {
 NONIUS_BENCHMARK("[units][filters] SVF", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::StateVariableFilter svf("");
-    double input = 1.0;
+    syn::Sample input = 1.0;
     svf.setFs(48000.0);
     svf.setParam(0, 10000.0);
     svf.setParam(1, 0.0);
-    svf.connectInput(0, syn::ReadOnlyBuffer<double>{ &input });
+    svf.connectInput(0, syn::ReadOnlyBuffer<syn::Sample>{ &input });
 
     double x;
     meter.measure([&x, &svf](int i)
@@ -139,11 +139,11 @@ NONIUS_BENCHMARK("[units][filters] SVF", [](nonius::chronometer& meter) {
 NONIUS_BENCHMARK("[units][filters] TSVF", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::TrapStateVariableFilter tsvf("");
-    double input = 1.0;
+    syn::Sample input = 1.0;
     tsvf.setFs(48000.0);
     tsvf.setParam(0, 10000.0);
     tsvf.setParam(1, 0.0);
-    tsvf.connectInput(0, syn::ReadOnlyBuffer<double>{ &input });
+    tsvf.connectInput(0, syn::ReadOnlyBuffer<syn::Sample>{ &input });
 
     double x;
     meter.measure([&x, &tsvf](int i)
@@ -207,8 +207,8 @@ NONIUS_BENCHMARK("[units][buffer size] syn::VoiceManager (Voices: 8, Buffer Size
     vm.noteOn(66, 127);
     vm.noteOn(67, 127);
 
-    std::vector<double> leftIn(200,0), rightIn(200,0);
-    std::vector<double> leftOut(200,0), rightOut(200,0);
+    std::vector<syn::Sample> leftIn(200,0), rightIn(200,0);
+    std::vector<syn::Sample> leftOut(200,0), rightOut(200,0);
     meter.measure([&leftIn, &leftOut, &rightIn, &rightOut, &vm](int i)
     {
         vm.tick(&leftIn.front(), &rightIn.front(), &leftOut.front(), &rightOut.front());
@@ -235,8 +235,8 @@ NONIUS_BENCHMARK("[units][buffer size] syn::VoiceManager (Voices: 8, Buffer Size
     vm.noteOn(66, 127);
     vm.noteOn(67, 127);
 
-    std::vector<double> leftIn(200, 0), rightIn(200, 0);
-    std::vector<double> leftOut(200, 0), rightOut(200, 0);
+    std::vector<syn::Sample> leftIn(200, 0), rightIn(200, 0);
+    std::vector<syn::Sample> leftOut(200, 0), rightOut(200, 0);
     meter.measure([&leftIn, &leftOut, &rightIn, &rightOut, &vm](int i)
     {
         vm.tick(&leftIn.front(), &rightIn.front(), &leftOut.front(), &rightOut.front());
@@ -282,6 +282,51 @@ NONIUS_BENCHMARK("[lut][saw] band-limited saw", [](nonius::chronometer& meter) {
     });
 })
 
+NONIUS_BENCHMARK("[lut][saw] mipmapped saw", [](nonius::chronometer& meter) {
+    std::vector<double> periods(meter.runs());
+    std::vector<double> phases(meter.runs());
+    std::uniform_int_distribution<> _periodGenerator(2, syn::lut_bl_saw_table().m_size - 1);
+    std::uniform_real_distribution<> _phaseGenerator(0.0, 1.0);
+    std::transform(periods.begin(), periods.end(), periods.begin(), [&_periodGenerator](double& x) {return _periodGenerator(RandomDevice); });
+    std::transform(phases.begin(), phases.end(), phases.begin(), [&_phaseGenerator](double& x) {return _phaseGenerator(RandomDevice); });
+    double x;
+    meter.measure([&x, &periods, &phases](int i)
+    {
+        x = syn::lut_bl_saw_table().getMipmapped(phases[i], periods[i]);
+        return x;
+    });
+})
+
+NONIUS_BENCHMARK("[lut][sinc] getresampled_single", [](nonius::chronometer& meter) {
+    std::vector<double> periods(meter.runs());
+    std::vector<double> phases(meter.runs());
+    const syn::ResampledTable& table = syn::lut_bl_saw_table();
+    std::uniform_real_distribution<> _periodGenerator(0.5 * table.m_size, 2.0 * table.m_size);
+    std::uniform_real_distribution<> _phaseGenerator(0.0, 1.0);
+    std::transform(periods.begin(), periods.end(), periods.begin(), [&_periodGenerator](double& x) {return _periodGenerator(RandomDevice); });
+    std::transform(phases.begin(), phases.end(), phases.begin(), [&_phaseGenerator](double& x) {return _phaseGenerator(RandomDevice); });
+    double x;
+    meter.measure([&x, &periods, &phases, &table](int i)
+    {
+        x = syn::getresampled_single(table.data(), table.m_size, phases[i], periods[i], syn::lut_blimp_table_online());
+        return x;
+    });
+})
+
+NONIUS_BENCHMARK("[lut][sinc] getresampled_single (polyphase filter bank)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(meter.runs());
+    const syn::ResampledTable& table = syn::lut_bl_saw_table();
+    const syn::SincFilterBank bank(syn::lut_blimp_table_online(), 0.7);
+    std::uniform_real_distribution<> _phaseGenerator(0.0, 1.0);
+    std::transform(phases.begin(), phases.end(), phases.begin(), [&_phaseGenerator](double& x) {return _phaseGenerator(RandomDevice); });
+    double x;
+    meter.measure([&x, &phases, &table, &bank](int i)
+    {
+        x = syn::getresampled_single(table.data(), table.m_size, phases[i], bank);
+        return x;
+    });
+})
+
 NONIUS_BENCHMARK("[lut][saw] naive saw", [](nonius::chronometer& meter) {
     std::vector<double> phases(meter.runs());
     std::uniform_real_distribution<> _phaseGenerator(0.0, 1.0);
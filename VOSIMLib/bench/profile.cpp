@@ -34,8 +34,8 @@ int main(int argc, char** argv) {
     vm.noteOn(74, 127);
     vm.noteOn(75, 127);
 
-    std::vector<double> leftIn(bufSize, 0), rightIn(bufSize, 0);
-    std::vector<double> leftOut(bufSize, 0), rightOut(bufSize, 0);
+    std::vector<syn::Sample> leftIn(bufSize, 0), rightIn(bufSize, 0);
+    std::vector<syn::Sample> leftOut(bufSize, 0), rightOut(bufSize, 0);
     for (int i = 0; i < 1; i++) {
         vm.tick(&leftIn.front(), &rightIn.front(), &leftOut.front(), &rightOut.front());
     }
@@ -220,11 +220,10 @@ def RewriteAutomatedSection(full_text, tag, replacement_text):
     result = full_text[:match.start("block")] + replacement_text + full_text[match.end("block"):]
     return result
 
-def MakeTableStr(table, name, ctype="double"):
+def MakeTableStr(table, name, ctype="Sample", cellstr="{:.18f}"):
     rows = int(sqrt(table.size))
     cols = int(ceil(sqrt(table.size)))
     tablestr = "{} {}[{}] = {{\n".format(ctype, name, table.size)
-    cellstr = "{:.18f}"
     ind = 0
     for i in range(rows):
         if i!=0:
@@ -240,6 +239,35 @@ def MakeTableStr(table, name, ctype="double"):
     tablestr+="\n};\n"
     return tablestr
 
+def MakeTableStorageStr(table, name, fmt="sample", quantize=True):
+    """
+    Generates the samples of a table in the requested storage format, along with the syn::TableStorage
+    describing them.
+
+    fmt - "sample" (syn::Sample), "float" or "int16"
+    quantize - if False, "int16" falls back to "float" (for tables whose range is too wide to quantize linearly)
+
+    """
+    if fmt == "int16" and not quantize:
+        fmt = "float"
+    scale, offset = 1.0, 0.0
+    if fmt == "sample":
+        ctype, enum, data, cellstr = "Sample", "Native", table, "{:.18f}"
+    elif fmt == "float":
+        ctype, enum, data, cellstr = "float", "Float32", table, "{:.9e}f"
+    elif fmt == "int16":
+        tmin, tmax = np.min(table), np.max(table)
+        offset = 0.5*(tmax + tmin)
+        scale = 0.5*(tmax - tmin)/32767. if tmax > tmin else 1.0
+        data = np.round((table - offset)/scale).astype(int)
+        ctype, enum, cellstr = "int16_t", "Int16", "{:d}"
+    else:
+        raise ValueError("Unknown table format: {}".format(fmt))
+    datastr = MakeTableStr(data, name+"_DATA", ctype="static const "+ctype, cellstr=cellstr)
+    storagestr = "extern const TableStorage {0:} = {{ TableStorage::{1:}, {0:}_DATA, {2:}, {3:.18e}, {4:.18e} }};\n".format(
+            name, enum, table.size, scale, offset)
+    return datastr + storagestr
+
 def make_symmetric_r(right_half):
     left_half = list(reversed(right_half))
     return hstack([left_half[:-1], right_half])
@@ -495,6 +523,7 @@ def passband_ripple(ir):
 def main(pargs):
     v = pargs.verbose
     clean = pargs.clean
+    fmt = pargs.format
 
     """Sin table"""
     if v:
@@ -552,10 +581,10 @@ def main(pargs):
     NAMESPACE = "syn"
 
     key_order = {
-            "NormalTable":['size'],
-            "AffineTable":['size', 'input_min', 'input_max'],
-            "ResampledTable":['size', 'blimp_online', 'blimp_offline'],
-            "BlimpTable":['size', 'intervals', 'res']
+            "NormalTable":[],
+            "AffineTable":['input_min', 'input_max'],
+            "ResampledTable":['blimp_online', 'blimp_offline'],
+            "BlimpTable":['intervals', 'res']
             }
     tables = [
             ['BLIMP_TABLE_OFFLINE', dict(classname="BlimpTable", data=blimp_offline,
@@ -568,6 +597,7 @@ def main(pargs):
                 res=config.ONLINE_BLIMP_RES)],
             ['PITCH_TABLE', dict(classname="AffineTable", data=pitchtable,
                 size=len(pitchtable),
+                quantize=False,
                 input_min = min(pitches),
                 input_max = max(pitches))],
             ['BL_SAW_TABLE', dict(classname="ResampledTable", data=blsaw,
@@ -600,8 +630,8 @@ def main(pargs):
     tableobjfuncs_decl = ""
     tableobjfuncs_def = ""
     for name, struct in tables:
-        tabledata_def += MakeTableStr(struct['data'], name)
-        tabledata_decl += "extern double {}[];\n".format(name)
+        tabledata_def += MakeTableStorageStr(struct['data'], name, fmt, struct.get('quantize', True))
+        tabledata_decl += "extern const TableStorage {};\n".format(name)
 
         currargs = []
         classname = struct["classname"]
@@ -616,7 +646,7 @@ def main(pargs):
             if type(val)==bool:
                 val = "true" if val else "false"
             currargs.append("{}".format(val))
-        tableargs = "{}, ".format(name)+", ".join(currargs)
+        tableargs = ", ".join([name]+currargs)
         tableobjfunc_currdecl = """{0:}& VOSIMLIB_API lut_{1:}();\n""".format(classname, name.lower())
         tableobjfunc_currdef = """{0:}& lut_{1:}() {{ static {0:} table({2:}); return table; }}\n""".format(classname, name.lower(), tableargs)
         tableobjfuncs_decl += tableobjfunc_currdecl
@@ -634,8 +664,10 @@ def main(pargs):
     if v:
         print("Writing new {}...".format(os.path.realpath(LUT_TABLEDATA_FILE)))
     with open(LUT_TABLEDATA_FILE, 'w') as fp:
-        # Add code to namespace
-        tabledata_def = """namespace {} {{
+        # Add code to namespace. By default tables are stored as syn::Sample, so that single precision builds halve their size
+        tabledata_def = """#include "vosimlib/tables.h"
+
+namespace {} {{
     {}
 }}""".format(NAMESPACE, tabledata_def)
         fp.write(tabledata_def)
@@ -714,6 +746,8 @@ if __name__=="__main__":
     psr.epilog = "Output files: {}".format(", ".join([LUT_TABLESRC_FILE, LUT_TABLEHDR_FILE, LUT_TABLEDATA_FILE]))
     psr.add_argument("-v", "--verbose", action="store_true")
     psr.add_argument("-c", "--clean", action="store_true")
+    psr.add_argument("-f", "--format", choices=["sample", "float", "int16"], default="sample",
+            help="storage format of the generated tables (default: %(default)s)")
     pargs = psr.parse_args()
 
     main(pargs)
@@ -21,10 +21,14 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #define __Circuit__
 #include "vosimlib/Unit.h"
 #include "vosimlib/IntMap.h"
+#include "vosimlib/WorkerPool.h"
+#include <atomic>
 #include <vector>
-#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
 
 #define MAX_UNITS 128
+#define DEFAULT_PARALLEL_WORK_THRESHOLD 1024
 
 namespace syn
 {
@@ -65,12 +69,17 @@ namespace syn
     protected:
         void process_() override
         {
-            BEGIN_PROC_FUNC
             for (int i = 0; i < numInputs(); i++)
             {
+                if (isInputConstant_(i))
+                {
+                    writeConstantOutput_(i, readConstantInput_(i));
+                    continue;
+                }
+                BEGIN_PROC_FUNC
                 WRITE_OUTPUT(i, READ_INPUT(i));
+                END_PROC_FUNC
             }
-            END_PROC_FUNC
         }
     };
 
@@ -99,93 +108,128 @@ namespace syn
 
         void reset() {
             m_adj.clear();
-            m_revAdj.clear();
+            m_nodes.clear();
         }
 
+        /**
+         * Add the edge (a_from, a_to). Parallel edges are allowed and must be removed one at a time.
+         */
         void connect(Node a_from, Node a_to) {
-            m_adj[a_to].emplace(a_from);
-            if (!m_adj.count(a_from)) {
-                m_adj.emplace(a_from, std::unordered_multiset<Node>{});
-            }
-
-            m_revAdj[a_from].emplace(a_to);
-            if (!m_revAdj.count(a_to)) {
-                m_revAdj.emplace(a_to, std::unordered_multiset<Node>{});
-            }
+            _getOrAddNode(a_to).in.push_back(a_from);
+            _getOrAddNode(a_from).out.push_back(a_to);
         }
 
+        /**
+         * Remove one instance of the edge (a_from, a_to). Nodes that are left without any edges are removed
+         * from the graph.
+         */
         void disconnect(Node a_from, Node a_to) {
-            m_adj[a_to].erase(a_from);
-            if (m_adj[a_to].empty()) {
-                m_adj.erase(a_to);
-            }
-
-            m_revAdj[a_from].erase(a_to);
-            if (m_revAdj[a_from].empty()) {
-                m_revAdj.erase(a_from);
-            }
+            auto toIt = m_adj.find(a_to);
+            auto fromIt = m_adj.find(a_from);
+            if (toIt == m_adj.end() || fromIt == m_adj.end())
+                return;
+            auto& in = toIt->second.in;
+            auto& out = fromIt->second.out;
+            auto inEdge = std::find(in.begin(), in.end(), a_from);
+            auto outEdge = std::find(out.begin(), out.end(), a_to);
+            if (inEdge == in.end() || outEdge == out.end())
+                return;
+            in.erase(inEdge);
+            out.erase(outEdge);
+            _removeNodeIfIsolated(a_to);
+            _removeNodeIfIsolated(a_from);
         }
 
+        /**
+         * Sort the nodes that can reach a sink so that every node comes after all of its inputs.
+         *
+         * Runs in O(V+E). Ties are broken by the order in which nodes and edges were added, so the result is
+         * deterministic. Edges that would close a cycle are ignored.
+         *
+         * \returns The sorted nodes along with their layer, i.e. the length of the longest path from the node
+         * to a sink. Nodes on the same layer never depend on each other.
+         */
         std::vector<std::pair<Node,Props>> linearize() const {
-            std::unordered_set<Node> permClosedSet;
-            std::unordered_set<Node> tempClosedSet;
-            std::unordered_map<Node, Props> props;
+            enum { Unvisited = 0, Visiting, Visited };
+            std::unordered_map<Node, int> marks(m_nodes.size());
             std::vector<Node> order;
-            std::function<void(Node, int)> visit = [&](Node node, int depth)
-            {
-                if (tempClosedSet.count(node))
-                    return; // todo: cycle detected
-                if (permClosedSet.count(node)) {
-                    if (depth > props[node].layer)
-                        props[node].layer = depth;
-                    return;
-                }
-                tempClosedSet.insert(node);
-                
-                const auto& children = m_adj.at(node);
-                for (const auto& child : children)
-                {
-                    visit(child, depth + 1);
-                }
-                permClosedSet.insert(node);
-                tempClosedSet.erase(node);
-                props[node].layer = depth;
-                order.push_back(node);
-            };
-
-            // Start the graph search at sink nodes            
-            for (const auto& p : m_revAdj)
-            {
-                if(p.second.empty()) {
-                    visit(p.first, 0);
+            order.reserve(m_nodes.size());
+            std::vector<std::pair<Node, size_t>> stack;
+
+            // Depth first search starting at sink nodes
+            for (const Node& sink : m_nodes) {
+                if (!m_adj.at(sink).out.empty() || marks[sink] != Unvisited)
+                    continue;
+                marks[sink] = Visiting;
+                stack.emplace_back(sink, 0);
+                while (!stack.empty()) {
+                    Node node = stack.back().first;
+                    size_t& nextChild = stack.back().second;
+                    const auto& children = m_adj.at(node).in;
+                    if (nextChild < children.size()) {
+                        Node child = children[nextChild++];
+                        if (marks[child] == Unvisited) {
+                            marks[child] = Visiting;
+                            stack.emplace_back(child, 0);
+                        }
+                    } else {
+                        marks[node] = Visited;
+                        order.push_back(node);
+                        stack.pop_back();
+                    }
                 }
             }
 
-            // Create output
+            // Assign layers in reverse order, so that every node's outputs are resolved first
+            std::unordered_map<Node, int> positions(order.size());
+            for (int i = 0; i < order.size(); i++)
+                positions[order[i]] = i;
             std::vector<std::pair<Node, Props>> out(order.size());
-            std::transform(order.begin(), order.end(), out.begin(), [&props](Node n) {return std::make_pair(n, props[n]); });
+            for (int i = int(order.size()) - 1; i >= 0; i--) {
+                int layer = 0;
+                for (const Node& next : m_adj.at(order[i]).out) {
+                    auto pos = positions.find(next);
+                    if (pos != positions.end() && pos->second > i)
+                        layer = std::max(layer, out[pos->second].second.layer + 1);
+                }
+                out[i].first = order[i];
+                out[i].second.layer = layer;
+            }
             return out;
         }
 
-
     private:
-        /**
-         * \brief Adjacency list
-         * 
-         *  Allows looking up incoming edges. Edges go from value nodes towards
-         *  key nodes. If node `u` is in `m_adj[v]`, then the edge (u,v) is in
-         *  the graph.
-         */
-        std::unordered_map<Node, std::unordered_multiset<Node>> m_adj;
+        struct Adjacency {
+            std::vector<Node> in; ///< Nodes with an edge towards this node
+            std::vector<Node> out; ///< Nodes this node has an edge towards
+        };
 
+        Adjacency& _getOrAddNode(Node a_node) {
+            auto it = m_adj.find(a_node);
+            if (it == m_adj.end()) {
+                m_nodes.push_back(a_node);
+                it = m_adj.emplace(a_node, Adjacency{}).first;
+            }
+            return it->second;
+        }
+
+        void _removeNodeIfIsolated(Node a_node) {
+            auto it = m_adj.find(a_node);
+            if (it == m_adj.end() || !it->second.in.empty() || !it->second.out.empty())
+                return;
+            m_adj.erase(it);
+            m_nodes.erase(std::find(m_nodes.begin(), m_nodes.end(), a_node));
+        }
+
+    private:
         /**
-         * \brief Reversed adjacency list
+         * \brief Adjacency lists
          *
-         *  Allows looking up outgoing edges. Edges go from key nodes towards
-         *  value nodes. If node `u` is in `m_revAdj[v]`, then the edge (v,u) is
-         *  in the graph.
+         *  Allows looking up both incoming and outgoing edges. If node `u` is in `m_adj[v].in`, then the edge
+         *  (u,v) is in the graph, and `v` is in `m_adj[u].out`.
          */
-        std::unordered_map<Node, std::unordered_multiset<Node>> m_revAdj; ///< Reverse adjacency list
+        std::unordered_map<Node, Adjacency> m_adj;
+        std::vector<Node> m_nodes; ///< Nodes in the order they were added
     };
 
     /**
@@ -209,10 +253,16 @@ namespace syn
         virtual ~Circuit();
 
         /**
-         * \returns True if any of its internal units are active
+         * \returns True if any of its scheduled units are active. This runs in constant time: the circuit
+         * keeps count of its active units, which report their transitions (see Unit::updateActivity_).
          */
         bool isActive() const override;
 
+        /**
+         * \returns The number of scheduled units that are active.
+         */
+        int getNumActiveUnits() const { return m_numActiveUnits.load(std::memory_order_relaxed); }
+
         void setVoiceIndex(double a_newVoiceIndex);
         double getVoiceIndex() const;
 
@@ -233,6 +283,17 @@ namespace syn
 
         void setBufferSize(int a_bufferSize) override;
 
+        /**
+         * Catch up on parameter changes for the circuit and every unit it contains.
+         */
+        void updateParameters() override;
+
+        /**
+         * Share the parameters of each unit with the unit of the same id and class in \p a_other, which should
+         * be a Circuit (typically the prototype this circuit was copied from).
+         */
+        void shareParameters(const Unit& a_other) override;
+
         /**
          * Retrieves a list of output ports connected to an input port.
          * \returns A vector of (unit_id, port_id) pairs.
@@ -264,6 +325,26 @@ namespace syn
         bool disconnectInternal(int a_fromId, int a_fromOutputPort, int a_toId, int a_toInputPort);
         bool disconnectInternal(const Unit& a_fromUnit, int a_fromOutputPort, const Unit& a_toUnit, int a_toInputPort);
 
+        /**
+         * \brief Give an output of an internal unit a buffer of its own, so that it can be read after each tick.
+         *
+         * Other outputs may share their buffer with outputs written later in the same tick (see
+         * OutputPort::isOverwritten). Meant for inspecting a circuit, e.g. from scripts.
+         *
+         * \returns False if the unit or output does not exist.
+         */
+        bool setOutputObserved(int a_unitId, int a_outputId, bool a_isObserved = true);
+
+        /**
+         * Start a batch of edits (adding/removing units and connections).
+         *
+         * The execution order and plan are only recomputed once, when the outermost matching endEdit is
+         * called, so a batch of N edits costs O(N) instead of O(N*E). Edits may be nested. The circuit must
+         * not be ticked while an edit is in progress.
+         */
+        void beginEdit();
+        void endEdit();
+
         operator json() const override;
 
         Unit* load(const json& j) override;
@@ -272,6 +353,47 @@ namespace syn
 
         const std::array<Unit*, MAX_UNITS + 1>& execOrder() const { return m_execOrder; }
 
+        /**
+         * \brief Enable the layer-parallel scheduler.
+         *
+         * When a pool is set, units are executed layer by layer (see DirectedProcGraph::linearize), and the
+         * units of a layer are processed concurrently on the pool, with a barrier between layers. Layers whose
+         * estimated work is below the threshold (see Circuit::setParallelWorkThreshold) are still processed
+         * serially on the calling thread. Pass nullptr to go back to fully serial processing.
+         *
+         * The pool is not owned by the circuit.
+         */
+        void setWorkerPool(WorkerPool* a_pool);
+        WorkerPool* getWorkerPool() const { return m_workerPool; }
+
+        /**
+         * Set the minimum estimated work (number of units in a layer times the buffer size) for a layer to be
+         * processed in parallel.
+         */
+        void setParallelWorkThreshold(int a_numSamples) { m_parallelWorkThreshold = a_numSamples; }
+        int getParallelWorkThreshold() const { return m_parallelWorkThreshold; }
+
+        /**
+         * \returns The pool that units cloned into this circuit and its internal buffers are allocated from,
+         * which is the pool of the MemoryPool::Scope the circuit was constructed in (nullptr for the heap).
+         */
+        MemoryPool* getMemoryPool() const { return m_memoryPool; }
+
+        /**
+         * \returns True if both circuits execute the same sequence of unit classes with the same buffer size,
+         * so that they can be ticked together by Circuit::tickLanes.
+         */
+        bool isLaneCompatible(const Circuit& a_other) const;
+
+        /**
+         * \brief Tick up to SYN_LANES lane-compatible circuits (e.g. voices of one instrument) in lockstep.
+         *
+         * Each step of the execution plan is processed for all circuits at once through Unit::processLanes_,
+         * so units with a vectorized kernel advance every voice in a single pass. Like Unit::tick, only the
+         * first \p a_numSamples samples of each circuit's buffers are processed.
+         */
+        static void tickLanes(Circuit* const* a_circuits, int a_numCircuits, int a_numSamples);
+
     protected:
         void process_() override;
 
@@ -279,6 +401,8 @@ namespace syn
 
         void onTempoChange_() override;
 
+        void onControlPeriodChange_() override;
+
         void onNoteOn_() override;
 
         void onNoteOff_() override;
@@ -298,8 +422,49 @@ namespace syn
     private:
         void _recomputeGraph();
 
+        /**
+         * Resolve the ports and parameters of every scheduled unit into the contiguous execution plan.
+         * Must be called whenever the execution order or any internal buffer changes.
+         */
+        void _compileProcPlan();
+
+        /**
+         * Bind the outputs of scheduled units to a small pool of shared buffers.
+         *
+         * The lifetime of each output spans from the execution step that writes it to the last step that
+         * reads it. Units of the same step may run concurrently, so they never share buffers. Outputs whose
+         * lifetimes do not overlap share a buffer, which is assigned greedily in execution order (interval graph
+         * coloring). Outputs that feed back into an earlier unit must survive across ticks, so they keep their
+         * own buffer.
+         */
+        void _assignInternalBuffers();
+
+        /**
+         * Prepare the execution plan for a tick: rebind the circuit's inputs and forward the number of samples
+         * to process to every scheduled unit.
+         */
+        void _beginProcess();
+
+        /**
+         * Copy the buffers of the output unit to the circuit's output ports.
+         */
+        void _pushOutputs();
+
+        /**
+         * Called by a scheduled unit when it becomes active or inactive. Units of the same layer may report
+         * concurrently, hence the atomic counter.
+         */
+        void _onUnitActivityChange(bool a_isActive) { m_numActiveUnits.fetch_add(a_isActive ? 1 : -1, std::memory_order_relaxed); }
+
+        /**
+         * Poll every scheduled unit for its activity and recount the active ones. Called whenever the
+         * execution plan changes.
+         */
+        void _countActiveUnits();
+
     private:
         friend class VoiceManager;
+        friend class Unit;
 
         double m_voiceIndex; ///< A number between 0 and 1 assigned to the circuit by a VoiceManager
         IntMap<Unit*, MAX_UNITS> m_units;
@@ -307,9 +472,17 @@ namespace syn
         InputUnit* m_inputUnit;
         OutputUnit* m_outputUnit;
 
-        DirectedProcGraph<Unit*> m_procGraph;
+        DirectedProcGraph<Unit*> m_procGraph; ///< Kept in sync with m_connectionRecords
+        int m_editDepth; ///< Number of unmatched beginEdit calls
+        bool m_graphDirty; ///< True if the execution order must be recomputed once editing ends
         std::array<Unit*, MAX_UNITS+1> m_execOrder; ///< Unit execution order
-        std::vector<std::vector<double>> m_internalBuffers;
+        PoolVector<ProcRecord> m_procPlan; ///< Pre-resolved unit records, in execution order
+        std::vector<int> m_stepStarts; ///< Plan index at which each execution step begins, followed by the plan size
+        WorkerPool* m_workerPool; ///< When set, each step is a whole layer whose units may run concurrently
+        int m_parallelWorkThreshold;
+        MemoryPool* m_memoryPool; ///< Not owned
+        std::vector<PoolVector<Sample>> m_internalBuffers; ///< Buffer pool shared by unit outputs
+        std::atomic<int> m_numActiveUnits; ///< Number of scheduled units whose last reported activity is true
     };
 };
 
@@ -0,0 +1,129 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ *  \file CommandQueue.h
+ *  \brief Allocation-free single-producer single-consumer queue of functors.
+ *  \details
+ *  \author Austen Satterlee
+ *  \date 10/2026
+ */
+
+#ifndef __COMMANDQUEUE__
+#define __COMMANDQUEUE__
+#include "vosimlib/common.h"
+#include <boost/lockfree/spsc_queue.hpp>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define COMMAND_STORAGE_SIZE 128
+
+namespace syn
+{
+    /**
+     * \class CommandQueue
+     *
+     * \brief Fixed-capacity queue of zero-argument functors, stored inline in preallocated slots.
+     *
+     * The producer constructs each functor directly in a free slot and hands the slot index to the consumer.
+     * Once the consumer has run the functor, it sends the slot back through a return queue, and the producer
+     * destroys the functor the next time it pushes (or calls CommandQueue::collect). The consumer therefore
+     * never allocates nor frees memory, and anything the functor owns (e.g. a captured string) is released on
+     * the producer's thread.
+     *
+     * Functors must fit in COMMAND_STORAGE_SIZE bytes, which is checked at compile time.
+     */
+    class VOSIMLIB_API CommandQueue
+    {
+    public:
+        explicit CommandQueue(int a_capacity);
+
+        CommandQueue(const CommandQueue&) = delete;
+        CommandQueue& operator=(const CommandQueue&) = delete;
+
+        ~CommandQueue();
+
+        /**
+         * Queue a copy of \p a_command. Must only be called from the producer thread.
+         *
+         * \returns True if the command was queued, false if the queue was full.
+         */
+        template <typename F>
+        bool push(F&& a_command);
+
+        /**
+         * Run up to \p a_maxCommands queued commands, in order. Must only be called from the consumer thread.
+         *
+         * \returns The number of commands that were run.
+         */
+        int process(int a_maxCommands);
+
+        /**
+         * Destroy the commands that have already been run. Must only be called from the producer thread.
+         */
+        void collect();
+
+        /**
+         * \returns True once every queued command has been run (and destroyed). Must only be called from the
+         * producer thread.
+         */
+        bool isDrained();
+
+        int capacity() const { return static_cast<int>(m_slots.size()); }
+
+    private:
+        struct Slot
+        {
+            std::aligned_storage<COMMAND_STORAGE_SIZE, alignof(std::max_align_t)>::type storage;
+            void (*invoke)(void*);
+            void (*destroy)(void*);
+        };
+
+        std::vector<Slot> m_slots;
+        std::vector<int> m_freeSlots; ///< only accessed by the producer
+        boost::lockfree::spsc_queue<int> m_pending; ///< slots holding commands to run, producer to consumer
+        boost::lockfree::spsc_queue<int> m_completed; ///< slots holding commands to destroy, consumer to producer
+    };
+
+    template <typename F>
+    bool CommandQueue::push(F&& a_command)
+    {
+        typedef typename std::decay<F>::type Functor;
+        static_assert(sizeof(Functor) <= COMMAND_STORAGE_SIZE, "Command does not fit in a CommandQueue slot; capture less state.");
+        static_assert(alignof(Functor) <= alignof(std::max_align_t), "Command is over-aligned for a CommandQueue slot.");
+
+        collect();
+        if (m_freeSlots.empty())
+            return false;
+        int slotIndex = m_freeSlots.back();
+        m_freeSlots.pop_back();
+
+        Slot& slot = m_slots[slotIndex];
+        new (&slot.storage) Functor(std::forward<F>(a_command));
+        slot.invoke = [](void* a_storage) { (*static_cast<Functor*>(a_storage))(); };
+        slot.destroy = [](void* a_storage) { static_cast<Functor*>(a_storage)->~Functor(); };
+        // Every slot fits in the queue, so this cannot fail
+        m_pending.push(slotIndex);
+        return true;
+    }
+}
+#endif
@@ -38,6 +38,11 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #define SYN_VEC_FIND_IF(VEC, ELEM) SYN_FIND_IF(VEC, ELEM) - VEC.begin()
 
 namespace syn {
+    /**
+     * Magnitude below which the state of a unit fed with silence is considered to have decayed (about -200 dB).
+     */
+    const double c_silenceThreshold = 1e-10;
+
     /**
      * Linearly interpolate between pt1 and pt2.
      */
@@ -19,7 +19,7 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 
 /**
  *  \file MemoryPool.h
- *  \brief
+ *  \brief Bounded-time allocator for memory touched by the real-time thread.
  *  \details
  *  \author Austen Satterlee
  *  \date 06/2016
@@ -28,48 +28,254 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #ifndef __MEMORYPOOL__
 #define __MEMORYPOOL__
 #include "vosimlib/common.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 
+#define SYN_CACHE_LINE_SIZE 64
+
 namespace syn
 {
+    /**
+     * \class MemoryPool
+     *
+     * \brief Two-level segregated fit (TLSF) allocator over a single preallocated region.
+     *
+     * Free blocks are binned by size class: the first level splits sizes by powers of two, and the second
+     * level splits each power of two into MEMORYPOOL_SL_COUNT linear classes. Two bitmaps record which bins are
+     * non-empty, so that MemoryPool::allocate finds a block with a couple of bit scans, and MemoryPool::free
+     * merges a block with its physical neighbours in constant time. Neither ever touches the system allocator.
+     *
+     * The pool is guarded by a spin lock, which is only ever held for a handful of instructions, so that the
+     * voices of a VoiceManager may be rendered (and resize their delay lines) on several threads at once.
+     *
+     * Containers and units draw from the pool through PoolAllocator and Unit::operator new, which fall back
+     * to the heap once the pool is exhausted (see MemoryPool::allocateFrom). The pool to use is set for the
+     * current thread with a MemoryPool::Scope.
+     *
+     * A pool may also be carved out of a parent pool, which it falls back to before the heap. This is how a
+     * VoiceManager lays out each voice in its own contiguous slice of a single arena.
+     */
     class VOSIMLIB_API MemoryPool
     {
-        struct Chunk
+    public:
+        struct Stats
         {
-            size_t size;
-            uint8_t* addr;
-            bool isFree;
-            Chunk* next;
-            Chunk* prev;
+            size_t capacity; ///< Bytes managed by the pool, block headers included
+            size_t bytesUsed; ///< Bytes taken by live allocations, block headers and padding included
+            size_t peakBytesUsed; ///< Highest value of `bytesUsed` since the pool was created
+            size_t largestFreeBlock; ///< Size of the largest allocation that is guaranteed to succeed
+            int numAllocations; ///< Number of live allocations
+            int numFailedAllocations; ///< Number of requests the pool could not satisfy
+        };
 
-            ~Chunk();
+        /**
+         * Where the region managed by a pool comes from.
+         */
+        enum Backing
+        {
+            HeapBacking,
+            PageBacking, ///< Mapped pages, which the OS may back with transparent huge pages
+            HugePageBacking, ///< Explicitly reserved huge pages
+            ParentBacking ///< A block of the parent pool
         };
 
-        struct ChunkSortBySize
+        /**
+         * One block of the region, as listed by MemoryPool::getMemoryMap.
+         */
+        struct BlockInfo
         {
-            bool operator ()(const Chunk& a_lhs, const Chunk& a_rhs) const;
+            const void* address; ///< Start of the payload
+            size_t numBytes; ///< Size of the payload
+            bool isFree;
         };
 
-        struct ChunkSortByAddr
+        /**
+         * \brief Make \p a_pool the pool used by PoolAllocator and Unit::operator new on this thread, until
+         * the scope ends. A null pool selects the heap.
+         */
+        class VOSIMLIB_API Scope
         {
-            bool operator ()(const Chunk& a_lhs, const Chunk& a_rhs) const;
+        public:
+            explicit Scope(MemoryPool* a_pool);
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        private:
+            MemoryPool* m_previous;
         };
 
-        std::vector<uint8_t> m_bytes;
-        std::vector<Chunk*> m_freeChunks;
-        std::vector<Chunk*> m_usedChunks;
-        Chunk m_head;
-        size_t m_bytesUsed;
-    public:
-        MemoryPool(size_t a_numBytes);
+        /**
+         * Manage a new region of \p a_numBytes bytes, aligned to a page. With \p a_useHugePages, the region is
+         * backed by huge pages if the OS allows it (see MemoryPool::getBacking), which cuts TLB misses when the
+         * region is much larger than a page.
+         */
+        explicit MemoryPool(size_t a_numBytes, bool a_useHugePages = false);
+
+        /**
+         * Manage a region of \p a_numBytes bytes carved from \p a_parent, aligned to a cache line. Requests the
+         * region cannot satisfy are passed on to the parent, which must outlive this pool.
+         */
+        MemoryPool(MemoryPool& a_parent, size_t a_numBytes);
+
+        MemoryPool(const MemoryPool&) = delete;
+        MemoryPool& operator=(const MemoryPool&) = delete;
 
         virtual ~MemoryPool();
 
-        void* allocate(size_t a_numBytes);
+        /**
+         * Allocate \p a_numBytes bytes aligned to \p a_alignment, which must be a power of two.
+         * \returns The new block, or nullptr if the pool has no free block large enough.
+         */
+        void* allocate(size_t a_numBytes, size_t a_alignment = alignof(std::max_align_t));
 
+        /**
+         * Return a block obtained from MemoryPool::allocate to the pool.
+         */
         void free(void* a_ptr);
+
+        /**
+         * \returns True if \p a_ptr points into the region managed by the pool.
+         */
+        bool owns(const void* a_ptr) const { return a_ptr >= m_begin && a_ptr < m_end; }
+
+        size_t capacity() const { return static_cast<size_t>(m_end - m_begin); }
+
+        const void* begin() const { return m_begin; }
+
+        Backing getBacking() const { return m_backing; }
+
+        MemoryPool* parent() const { return m_parent; }
+
+        /**
+         * Collect usage statistics. This walks one free list, so avoid it on the real-time thread.
+         */
+        Stats getStats() const;
+
+        /**
+         * List every block of the region, free or not, in address order. Not real-time safe.
+         */
+        std::vector<BlockInfo> getMemoryMap() const;
+
+        /**
+         * \brief Allocate from \p a_pool, then from its parents, and finally from the heap if they are all
+         * exhausted (or if the pool is null).
+         *
+         * Free the result with MemoryPool::release, passing the same pool.
+         * \throws std::bad_alloc if the heap is exhausted as well.
+         */
+        static void* allocateFrom(MemoryPool* a_pool, size_t a_numBytes, size_t a_alignment);
+
+        /**
+         * Free a block obtained from MemoryPool::allocateFrom.
+         */
+        static void release(MemoryPool* a_pool, void* a_ptr);
+
+        /**
+         * \returns The pool selected for this thread by the innermost MemoryPool::Scope, or nullptr.
+         */
+        static MemoryPool* current();
+
+    private:
+        struct Block;
+
+        /**
+         * Lay out a single free block over `[m_begin, m_end)`.
+         */
+        void _initRegion();
+
+        void _lock() const;
+
+        void _unlock() const;
+
+        void _insertFreeBlock(Block* a_block);
+
+        void _removeFreeBlock(Block* a_block);
+
+        /**
+         * Find a free block of at least \p a_size bytes and take it off its free list.
+         */
+        Block* _takeFreeBlock(size_t a_size);
+
+        /**
+         * Split the tail of \p a_block beyond \p a_size bytes into a new free block, if it is large enough.
+         */
+        void _trimBlock(Block* a_block, size_t a_size);
+
+        static void _mapSize(size_t a_size, int& a_fl, int& a_sl);
+
+    private:
+        enum
+        {
+            MEMORYPOOL_SL_LOG2 = 4,
+            MEMORYPOOL_SL_COUNT = 1 << MEMORYPOOL_SL_LOG2,
+            MEMORYPOOL_ALIGN_LOG2 = 4,
+            MEMORYPOOL_FL_SHIFT = MEMORYPOOL_SL_LOG2 + MEMORYPOOL_ALIGN_LOG2,
+            MEMORYPOOL_FL_MAX = 32,
+            MEMORYPOOL_FL_COUNT = MEMORYPOOL_FL_MAX - MEMORYPOOL_FL_SHIFT + 1
+        };
+
+        uint8_t* m_begin;
+        uint8_t* m_end;
+        Backing m_backing;
+        MemoryPool* m_parent;
+        uint32_t m_flBitmap;
+        uint32_t m_slBitmaps[MEMORYPOOL_FL_COUNT];
+        Block* m_freeLists[MEMORYPOOL_FL_COUNT][MEMORYPOOL_SL_COUNT];
+        size_t m_bytesUsed;
+        size_t m_peakBytesUsed;
+        int m_numAllocations;
+        int m_numFailedAllocations;
+        mutable std::atomic_flag m_lock;
+    };
+
+    /**
+     * \brief Standard allocator that draws from a MemoryPool (see MemoryPool::allocateFrom).
+     *
+     * A default constructed allocator binds to the pool of the current MemoryPool::Scope, and so do copies of
+     * containers, so that everything built within a scope ends up in its pool.
+     */
+    template <typename T>
+    class PoolAllocator
+    {
+    public:
+        typedef T value_type;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        PoolAllocator() : m_pool(MemoryPool::current()) {}
+
+        explicit PoolAllocator(MemoryPool* a_pool) : m_pool(a_pool) {}
+
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U>& a_other) : m_pool(a_other.pool()) {}
+
+        T* allocate(size_t a_count) {
+            // Cache line alignment keeps buffers of neighbouring units from sharing lines across threads
+            const size_t alignment = alignof(T) > SYN_CACHE_LINE_SIZE ? alignof(T) : SYN_CACHE_LINE_SIZE;
+            return static_cast<T*>(MemoryPool::allocateFrom(m_pool, a_count * sizeof(T), alignment));
+        }
+
+        void deallocate(T* a_ptr, size_t) { MemoryPool::release(m_pool, a_ptr); }
+
+        PoolAllocator select_on_container_copy_construction() const { return PoolAllocator(); }
+
+        MemoryPool* pool() const { return m_pool; }
+
     private:
-        void _joinFreeChunks(Chunk* a_chunk);
+        MemoryPool* m_pool;
     };
+
+    template <typename T, typename U>
+    bool operator==(const PoolAllocator<T>& a_lhs, const PoolAllocator<U>& a_rhs) { return a_lhs.pool() == a_rhs.pool(); }
+
+    template <typename T, typename U>
+    bool operator!=(const PoolAllocator<T>& a_lhs, const PoolAllocator<U>& a_rhs) { return a_lhs.pool() != a_rhs.pool(); }
+
+    template <typename T>
+    using PoolVector = std::vector<T, PoolAllocator<T>>;
 }
 #endif
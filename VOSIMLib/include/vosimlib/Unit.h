@@ -25,18 +25,21 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #include "vosimlib/UnitParameter.h"
 #include "vosimlib/UnitFactory.h"
 #include "vosimlib/Logging.h"
+#include "vosimlib/MemoryPool.h"
 
 #include <Eigen/Core>
+#include <memory>
 
 
 #define MAX_PARAMS 16
 #define MAX_INPUTS 8
 #define MAX_OUTPUTS 8
+/// Number of voices processed in lockstep by Unit::processLanes_ (one AVX register of doubles)
+#define SYN_LANES 4
 
 #define DERIVE_UNIT(TYPE) \
     Unit *_clone() const override {return new TYPE(*this);} \
 public: \
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW \
     const string& getClassName() const override {return TYPE::className();} \
     static const string& className() { static const std::string class_name = #TYPE; return class_name; } \
     static const syn::UnitTypeId& classIdentifier() { static const std::hash<string> hash_fn; static const syn::UnitTypeId id = static_cast<syn::UnitTypeId>(hash_fn(#TYPE)); return id; } \
@@ -44,24 +47,43 @@ public: \
 private:
 
 #define BEGIN_PROC_FUNC \
-    for(m_currentBufferOffset=0;m_currentBufferOffset<getBufferSize();m_currentBufferOffset++){
+    for(m_currentBufferOffset=0;m_currentBufferOffset<getNumSamples();m_currentBufferOffset++){
 #define END_PROC_FUNC }
 #define READ_OUTPUT(OUTPUT) \
     readOutput(OUTPUT, m_currentBufferOffset)
 #define READ_INPUT(INPUT) \
-    readInput(INPUT, m_currentBufferOffset)
+    readInput_(INPUT, m_currentBufferOffset)
 #define WRITE_OUTPUT(OUTPUT, VALUE) \
     writeOutput_(OUTPUT, m_currentBufferOffset, VALUE)
+#define READ_PARAM(PARAM) \
+    readParam_(PARAM)
+#define READ_PARAM_INT(PARAM) \
+    readParamInt_(PARAM)
+#define READ_PARAM_BOOL(PARAM) \
+    readParamBool_(PARAM)
+#define READ_PARAM_ENUM(PARAM) \
+    readParamEnum_(PARAM)
+#define READ_PARAM_RAMP(PARAM) \
+    readParamRamp_(PARAM, m_currentBufferOffset)
 
 namespace syn
 {
+    class Unit;
     class Circuit;
 
+    /**
+     * One sample for each of SYN_LANES voices. Fixed-size Eigen arrays are vectorized with whichever
+     * instruction set the project is compiled for (see VOSIMPROJECT_EIS). Lanes are always computed in double
+     * precision, whatever the sample type, since lane kernels carry filter state from one sample to the next.
+     */
+    typedef Eigen::Array<double, SYN_LANES, 1> LaneArray;
+
     struct VOSIMLIB_API AudioConfig
     {
         double fs;
         double tempo;
         int bufferSize;
+        int controlPeriod; ///< Number of samples between two control ticks
     };
 
     struct VOSIMLIB_API MidiData
@@ -71,11 +93,31 @@ namespace syn
         bool isNoteOn;
     };
 
+    /**
+     * \brief What is known about the contents of a buffer over the current block.
+     *
+     * Units tag the outputs that hold a single value over a whole block (see Unit::writeConstantOutput_), and
+     * downstream units may use the tags of their inputs to take scalar fast paths, or to skip processing
+     * altogether (see Unit::isSilent_). Tagged buffers are still filled, so consumers are free to ignore tags.
+     */
+    struct VOSIMLIB_API BufferTag {
+        BufferTag() : BufferTag(false, 0.0) {}
+
+        BufferTag(bool a_isConstant, double a_value) : isConstant(a_isConstant), value(a_value) {}
+
+        bool isSilent() const { return isConstant && value == 0.0; }
+
+        bool isConstant; ///< True if every sample of the block equals `value`
+        double value;
+    };
+
     template<typename T>
     class VOSIMLIB_API Buffer {
     public:
         virtual ~Buffer() = default;
         virtual const T* buf() const = 0;
+        /// \returns The tag describing the current block, or nullptr if the buffer is never tagged.
+        virtual const BufferTag* tag() const { return nullptr; }
     };
 
     template<typename T>
@@ -95,17 +137,32 @@ namespace syn
 
         OutputPort(T* a_targetBuf)
             : m_extBuf(a_targetBuf),
-              m_intBuf() {}
+              m_intBuf(),
+              m_lastValue(0.0),
+              m_isObserved(false),
+              m_isOverwritten(false) {}
 
         explicit OutputPort(int a_bufSize)
             : m_extBuf(nullptr),
-              m_intBuf(a_bufSize, 0.0) { }
+              m_intBuf(a_bufSize, 0.0),
+              m_lastValue(0.0),
+              m_isObserved(false),
+              m_isOverwritten(false) { }
 
         T* buf() { return hasExternalBuf() ? m_extBuf : m_intBuf.data(); }
         const T* buf() const override { return hasExternalBuf() ? m_extBuf : m_intBuf.data(); }
 
         T read(int a_offset) const { return buf()[a_offset]; }
 
+        /// \returns The last sample written to the port by the most recent block (see OutputPort::capture).
+        T lastValue() const { return m_lastValue; }
+
+        /// Remember the last sample of the current block, before the buffer is handed to another port.
+        void capture(int a_numSamples) { if (a_numSamples > 0) m_lastValue = buf()[a_numSamples - 1]; }
+
+        BufferTag* tag() { return &m_tag; }
+        const BufferTag* tag() const override { return &m_tag; }
+
         void setBuf(T* a_targetBuf) { m_extBuf = a_targetBuf == m_intBuf.data() ? nullptr : a_targetBuf; }
 
         void unsetBuf() { m_extBuf = nullptr; }
@@ -114,9 +171,22 @@ namespace syn
 
         void resize(int a_size) { m_intBuf.resize(a_size, 0.0); }
 
+        /// Observed outputs keep a buffer of their own within a circuit (see Circuit::setOutputObserved).
+        bool isObserved() const { return m_isObserved; }
+        void setObserved(bool a_isObserved) { m_isObserved = a_isObserved; }
+
+        /// \returns True if the buffer is reused by a later port of the same tick, and thus does not hold this
+        /// port's samples once the tick is over.
+        bool isOverwritten() const { return m_isOverwritten; }
+        void setOverwritten(bool a_isOverwritten) { m_isOverwritten = a_isOverwritten; }
+
     private:
         T* m_extBuf;
-        std::vector<T> m_intBuf;
+        PoolVector<T> m_intBuf;
+        BufferTag m_tag;
+        T m_lastValue;
+        bool m_isObserved;
+        bool m_isOverwritten;
     };
 
     template<typename T>
@@ -126,6 +196,7 @@ namespace syn
 
         explicit InputPort(T a_defVal)
             : defVal(a_defVal),
+              defTag(true, a_defVal),
               src(nullptr) {}
     
     private:
@@ -138,9 +209,78 @@ namespace syn
         bool isConnected() const { return src != nullptr; }
 
         T defVal;
+        BufferTag defTag; ///< tag of an unconnected input
         const Buffer<T>* src;
     };
 
+    /**
+     * \brief Typed copy of a unit's parameters, taken once at the start of every block.
+     *
+     * Parameters are read from it within Unit::process_ (see READ_PARAM and friends), so that they hold still
+     * for the whole block, and reading one never rounds, clamps, or looks anything up. Parameters flagged
+     * with UnitParameter::setSmoothed ramp linearly from their value at the end of the previous block to
+     * their current value (see Unit::readParamRamp_).
+     */
+    struct VOSIMLIB_API ParamSnapshot {
+        double values[MAX_PARAMS]; ///< Value at the end of the block, as UnitParameter::getDouble
+        double steps[MAX_PARAMS]; ///< Per sample increment of smoothed parameters, zero for the others
+        int ints[MAX_PARAMS]; ///< As UnitParameter::getInt
+        double enums[MAX_PARAMS]; ///< As UnitParameter::getEnum for enumerated parameters, else the value
+        unsigned dirty; ///< Bit `id` is set if parameter `id` changed since the previous block
+    };
+
+    /**
+     * \brief Flat, pre-resolved view of a unit's ports and parameters.
+     *
+     * Holds raw pointers to everything a unit touches from within Unit::process_, so that the processing
+     * macros (READ_INPUT, WRITE_OUTPUT, READ_PARAM) can skip the port containers, the null checks on
+     * unconnected inputs, and the virtual Buffer::buf calls. Standalone units resolve their own record in
+     * Unit::tick, while a Circuit compiles the records of its units into a contiguous execution plan.
+     *
+     * Unconnected inputs point to the port's default value with a zero index mask, so that reads are
+     * branchless: `inputs[id][offset & inputMasks[id]]`. For units that use block processing (see
+     * Unit::processBlock_), they instead point to a buffer filled with the default value, with a full mask.
+     * Every input and output also has a BufferTag, which is constant for unconnected inputs and never set
+     * for inputs fed from outside of a circuit.
+     */
+    struct VOSIMLIB_API ProcRecord {
+        Unit* unit;
+        const Sample* inputs[MAX_INPUTS];
+        int inputMasks[MAX_INPUTS];
+        const BufferTag* inputTags[MAX_INPUTS];
+        Sample* outputs[MAX_OUTPUTS];
+        BufferTag* outputTags[MAX_OUTPUTS];
+        const ParamSnapshot* params;
+    };
+
+    /**
+     * \brief Storage for the parameters of a unit, which copies of the unit can share (see Unit::shareParameters).
+     *
+     * Every voice of a VoiceManager shares the block of its prototype, so changing a parameter is a single write
+     * rather than one per voice, and the parameters (with their names and display texts) are only stored once.
+     * Each change of value increments `version`, against which units compare the last version they saw to
+     * catch up on Unit::onParamChange_ (see Unit::updateParameters). The block is aligned to a cache line, as
+     * it is read by every voice, possibly from several threads.
+     */
+    struct alignas(64) ParameterBlock
+    {
+        ParameterBlock() : version(0) {}
+
+        ParameterBlock(const ParameterBlock& a_other) :
+            params(a_other.params),
+            version(a_other.version) { rewire(); }
+
+        ParameterBlock& operator=(const ParameterBlock&) = delete;
+
+        /**
+         * Point the parameters at this block's version counter. Must be called after parameters are added.
+         */
+        void rewire() { for (auto& param : params) param.m_blockVersion = &version; }
+
+        StrMap<UnitParameter, MAX_PARAMS> params;
+        unsigned version;
+    };
+
     const vector<string> g_bpmStrs = {"4", "7/2", "3", "5/2", "2", "3/2", "1", "3/4", "1/2", "3/8", "1/4", "3/16", "1/8", "3/32", "1/16", "3/64", "1/32", "1/64"};
     const vector<double> g_bpmVals = {4.0, 7.0 / 2.0, 3.0, 5.0 / 2.0, 2.0, 3.0 / 2.0, 1.0, 3.0 / 4.0, 1.0 / 2.0, 3.0 / 8.0, 1.0 / 4.0, 3.0 / 16.0, 1.0 / 8.0, 3.0 / 32.0, 1.0 / 16.0, 3.0 / 64.0, 1.0 / 32.0, 1.0 / 64.0};
 
@@ -215,14 +355,28 @@ namespace syn
     class VOSIMLIB_API Unit
     {
     public:
-        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        /**
+         * Units are allocated from the pool of the current MemoryPool::Scope (or the heap), aligned to a cache
+         * line, which also satisfies the alignment of any fixed-size Eigen member.
+         */
+        static void* operator new(size_t a_size);
+        static void operator delete(void* a_ptr);
     public:
-        typedef double SampleType;
+        typedef Sample SampleType;
         typedef Eigen::Array<SampleType, -1, -1, Eigen::RowMajor> dynamic_buffer_t;
         typedef OutputPort<SampleType> OutputPort;
         typedef Buffer<SampleType> Buffer;
         typedef InputPort<SampleType> InputPort;
 
+        /**
+         * How the outputs of a control rate unit are brought back to audio rate (see Unit::enableControlRate_).
+         */
+        enum ControlInterpolation
+        {
+            HoldControl, ///< Hold each control value until the next control tick
+            LerpControl ///< Ramp linearly to each control value over one control period
+        };
+
         Unit();
 
         explicit Unit(const string& a_name);
@@ -237,7 +391,20 @@ namespace syn
         /**
          * Processes as many samples as required to fill the internal buffer (see Unit::getBufferSize and Unit::setBufferSize).
          */
-        void tick() { process_(); }
+        void tick() { tick(getBufferSize()); }
+
+        /**
+         * Processes only the first \p a_numSamples samples of the internal buffer, which must not exceed
+         * Unit::getBufferSize. This is used to split a buffer at event boundaries without resizing anything.
+         */
+        void tick(int a_numSamples) {
+            m_numSamples = a_numSamples;
+            _syncParameters();
+            _captureParameters();
+            _resolveProcRecord(m_localProcRecord);
+            m_procRecord = &m_localProcRecord;
+            _process();
+        }
 
         /**
          * Processes as many samples to fill the specified output buffer. 
@@ -284,13 +451,52 @@ namespace syn
         int getBufferSize() const;
 
         /**
-         * Notify the unit that one of its internal parameters changed.
-         * This is automatically called by the internal UnitParameter.
+         * Set the number of samples between two control ticks. Control rate units (see Unit::enableControlRate_)
+         * are only evaluated on control ticks, and other units may refresh costly per-sample computations on
+         * them (see Unit::pollControlTick_). A period of 1, the default, evaluates everything at audio rate.
+         */
+        void setControlPeriod(int a_controlPeriod);
+
+        int getControlPeriod() const { return m_audioConfig.controlPeriod; }
+
+        bool isControlRate() const { return m_useControlRate; }
+
+        /**
+         * \returns The number of samples processed by the current (or last) tick. This never exceeds
+         * Unit::getBufferSize.
+         */
+        int getNumSamples() const { return m_numSamples; }
+
+        /**
+         * \brief Call Unit::onParamChange_ for every parameter that changed since the last call.
+         *
+         * Parameters may be shared with other units, and changing one does not notify anybody directly. Units
+         * catch up before they are processed, and Unit::setParam catches up right away. Call this after
+         * changing a parameter of a unit that is not ticked (e.g. one in a prototype circuit) through
+         * Unit::param.
+         */
+        virtual void updateParameters();
+
+        /**
+         * \brief Use the parameters of \p a_other, which must be a unit of the same class.
+         *
+         * Both units then read and write the same values, so a change made through either one applies to
+         * both. This must not be called while either unit is being processed.
+         */
+        virtual void shareParameters(const Unit& a_other);
+
+        /**
+         * \brief Give this unit its own copy of its parameters if they are shared (copy-on-write).
+         *
+         * This is how a single voice overrides a parameter of the prototype: detach the voice's unit, then
+         * change its parameter.
          */
-        void notifyParameterChanged(int a_id);
+        void detachParameters();
+
+        bool hasSharedParameters() const { return m_parameters.use_count() > 1; }
 
         /**
-         * Return the unit's sampling frequency
+         * Return the unit's sampling frequency. For control rate units, this is the rate of the control ticks.
          */
         double fs() const;
 
@@ -307,7 +513,8 @@ namespace syn
          *
          * Default implementation returns true when a note is on and false
          * otherwise.  Override if the unit should be ticked before note on or
-         * after note off events (e.g. an envelope).
+         * after note off events (e.g. an envelope), and call Unit::updateActivity_
+         * whenever the result changes outside of a note event.
          */
         virtual bool isActive() const;
 
@@ -319,8 +526,8 @@ namespace syn
         /**
          * Determines whether or not the unit contains a specific parameter.
          */
-        bool hasParam(int a_id) const { return m_parameters.containsId(a_id); }
-        bool hasParam(const std::string& a_name) const { return m_parameters.containsName(a_name); }
+        bool hasParam(int a_id) const { return m_parameters->params.containsId(a_id); }
+        bool hasParam(const std::string& a_name) const { return m_parameters->params.containsName(a_name); }
 
         /**
          * Returns a reference to the requested parameter.
@@ -336,7 +543,7 @@ namespace syn
         const StrMap<UnitParameter, MAX_PARAMS>& parameters() const;
 
         /**
-         * Sets the value of an internal parameter
+         * Sets the value of an internal parameter, and calls Unit::onParamChange_ if it changed.
          * \see UnitParameter::set
          */
         template <typename ID, typename T>
@@ -356,8 +563,20 @@ namespace syn
 
         string outputName(int a_id) const;
 
+        /**
+         * Read the buffer of an output. Within a Circuit, outputs whose lifetimes do not overlap share a buffer,
+         * so outside of a tick this only holds for the circuit's own outputs and for outputs that are not
+         * OutputPort::isOverwritten. Use Unit::lastOutput to inspect the outputs of the units inside a circuit, or
+         * Circuit::setOutputObserved to keep a whole output buffer.
+         */
         double readOutput(int a_id, int a_offset) const;
 
+        /**
+         * \returns The last sample written to an output by the most recent tick, which remains valid after its
+         * buffer has been reused by other units.
+         */
+        double lastOutput(int a_id) const;
+
         const StrMap<OutputPort, MAX_OUTPUTS>& outputs() const;
 
         OutputPort& output(int a_id);
@@ -415,6 +634,8 @@ namespace syn
 
         virtual void onTempoChange_() {};
 
+        virtual void onControlPeriodChange_() {};
+
         virtual void onNoteOn_() {};
 
         virtual void onNoteOff_() {};
@@ -427,10 +648,147 @@ namespace syn
 
         virtual void onInputDisconnection_(int a_inputPort) {};
 
-        template <typename ID>
-        void writeOutput_(const ID& a_id, int a_offset, const double& a_val);
+        /**
+         * Use Unit::processBlock_ instead of Unit::process_. Must be called from the constructor.
+         */
+        void enableBlockProcessing_();
+
+        /**
+         * \brief Evaluate this unit at control rate. Must be called from the constructor.
+         *
+         * The unit is then processed once per control tick (see Unit::setControlPeriod): its inputs are sampled
+         * on each tick, Unit::process_ runs over the ticks alone, and each output is brought back to audio rate
+         * as specified by \p a_interpolation (or Unit::setControlInterpolation_). This suits modulation sources
+         * that need not change every sample. Linearly interpolated outputs lag by one control period.
+         */
+        void enableControlRate_(ControlInterpolation a_interpolation = LerpControl);
 
-        virtual void process_() = 0;
+        void setControlInterpolation_(int a_outputId, ControlInterpolation a_interpolation);
+
+        /**
+         * Call once per sample from a processing loop. \returns True on the first call, and then once every
+         * Unit::getControlPeriod calls, which is when costly per-sample computations (e.g. filter coefficients)
+         * should be refreshed. Always true when the control period is 1.
+         */
+        bool pollControlTick_()
+        {
+            if (--m_controlCountdown > 0)
+                return false;
+            m_controlCountdown = m_audioConfig.controlPeriod;
+            return true;
+        }
+
+        /**
+         * \brief Block processing interface, for units that call Unit::enableBlockProcessing_.
+         *
+         * Instead of overriding Unit::process_ and using the per-sample macros, such units override this to
+         * process the whole block at once. Both arrays are indexed by port id, and every span holds
+         * \p a_numSamples contiguous samples, including those of unconnected inputs (which are filled with
+         * the default value of the port). Loops over a block thus need no offsets, masks, or branches, and can
+         * be vectorized by the compiler. Parameters are read with READ_PARAM, as usual.
+         */
+        virtual void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) {}
+
+        /**
+         * Fast port and parameter accessors used by the processing macros. These go through the unit's
+         * ProcRecord, so they are only valid from within Unit::process_.
+         */
+        double readInput_(int a_id, int a_offset) const { return m_procRecord->inputs[a_id][a_offset & m_procRecord->inputMasks[a_id]]; }
+
+        void writeOutput_(int a_id, int a_offset, double a_val) { m_procRecord->outputs[a_id][a_offset] = static_cast<Sample>(a_val); }
+
+        double readParam_(int a_id) const { return m_procRecord->params->values[a_id]; }
+
+        int readParamInt_(int a_id) const { return m_procRecord->params->ints[a_id]; }
+
+        bool readParamBool_(int a_id) const { return m_procRecord->params->values[a_id] > 0.5; }
+
+        double readParamEnum_(int a_id) const { return m_procRecord->params->enums[a_id]; }
+
+        /**
+         * Value of a smoothed parameter at \p a_offset, which ramps up to Unit::readParam_ on the last sample
+         * of the block. Parameters that are not smoothed are constant.
+         */
+        double readParamRamp_(int a_id, int a_offset) const {
+            return m_procRecord->params->values[a_id] - m_procRecord->params->steps[a_id] * (m_numSamples - 1 - a_offset);
+        }
+
+        double readParamStep_(int a_id) const { return m_procRecord->params->steps[a_id]; }
+
+        /**
+         * \returns True if the parameter changed since the previous block, e.g. to refresh state derived from it.
+         */
+        bool isParamDirty_(int a_id) const { return (m_procRecord->params->dirty >> a_id) & 1u; }
+
+        /**
+         * Buffer tag accessors (see BufferTag), which are also only valid from within Unit::process_.
+         */
+        bool isInputConstant_(int a_id) const { return m_procRecord->inputTags[a_id]->isConstant; }
+
+        bool isInputSilent_(int a_id) const { return m_procRecord->inputTags[a_id]->isSilent(); }
+
+        double readConstantInput_(int a_id) const { return m_procRecord->inputTags[a_id]->value; }
+
+        /**
+         * Fill the output with \p a_value for the whole block, and tag it as constant.
+         */
+        void writeConstantOutput_(int a_id, double a_value);
+
+        /**
+         * \brief Report a change of Unit::isActive to the parent circuit, which counts its active units
+         * instead of polling them.
+         *
+         * Note events are reported automatically. Units whose activity also changes on its own (e.g. an
+         * envelope that reaches the end of its release) call this when it does. Nothing is reported if the
+         * activity did not change.
+         */
+        void updateActivity_();
+
+        /**
+         * \brief Called before each block. \returns True if every output would be silent for the whole block.
+         *
+         * Processing is then skipped, and the outputs are zeroed and tagged silent, so that a silent chain of
+         * such units costs next to nothing. Inputs are checked with Unit::isInputSilent_. Units with internal
+         * state should only return true once it has decayed, and flush it to zero.
+         */
+        virtual bool isSilent_() { return false; }
+
+        /**
+         * Process Unit::getNumSamples samples. The default implementation forwards to Unit::processBlock_.
+         */
+        virtual void process_();
+
+        /**
+         * Process several instances of this unit in lockstep, one per lane. All units in \p a_lanes are of the
+         * same class as this one, which is always `a_lanes[0]`, and `1 < a_numLanes <= SYN_LANES`.
+         *
+         * The default implementation processes the lanes one after the other. Units that are worth vectorizing
+         * across voices override this with a kernel built on the lane accessors below. Lanes beyond
+         * \p a_numLanes replicate the first lane and must not be written back.
+         */
+        virtual void processLanes_(Unit* const* a_lanes, int a_numLanes) {
+            for (int i = 0; i < a_numLanes; i++)
+                a_lanes[i]->process_();
+        }
+
+        static LaneArray readLaneInput_(Unit* const* a_lanes, int a_numLanes, int a_id, int a_offset) {
+            LaneArray vals;
+            for (int i = 0; i < SYN_LANES; i++)
+                vals[i] = a_lanes[i < a_numLanes ? i : 0]->readInput_(a_id, a_offset);
+            return vals;
+        }
+
+        static void writeLaneOutput_(Unit* const* a_lanes, int a_numLanes, int a_id, int a_offset, const LaneArray& a_vals) {
+            for (int i = 0; i < a_numLanes; i++)
+                a_lanes[i]->writeOutput_(a_id, a_offset, a_vals[i]);
+        }
+
+        static LaneArray readLaneParam_(Unit* const* a_lanes, int a_numLanes, int a_id) {
+            LaneArray vals;
+            for (int i = 0; i < SYN_LANES; i++)
+                vals[i] = a_lanes[i < a_numLanes ? i : 0]->readParam_(a_id);
+            return vals;
+        }
 
         int addInput_(const string& a_name, double a_default = 0.0);
         bool addInput_(int a_id, const string& a_name, double a_default = 0.0);
@@ -449,6 +807,68 @@ namespace syn
     private:
         void _setParent(Circuit* a_new_parent);
 
+        /**
+         * Call Unit::onParamChange_ for the parameters of this unit alone that changed since the last call.
+         */
+        void _syncParameters();
+
+        /**
+         * Call Unit::onParamChange_ for every parameter, whether it changed or not.
+         */
+        void _notifyAllParameters();
+
+        /**
+         * Copy the parameters into the snapshot read by Unit::process_. Called at the start of every block.
+         */
+        void _captureParameters();
+
+        /**
+         * Drop the previous snapshot, so that smoothed parameters jump to their value on the next block.
+         */
+        void _resetParameterSmoothing() { m_hasParamSnapshot = false; }
+
+        /**
+         * Fill the buffers that stand in for unconnected inputs of block processing units.
+         */
+        void _resizeDefaultInputs();
+
+        /**
+         * Resolve the current port buffers and parameter slots into \p a_record.
+         */
+        void _resolveProcRecord(ProcRecord& a_record);
+
+        /**
+         * Process Unit::getNumSamples samples, through Unit::_processControlRate for control rate units.
+         */
+        void _process();
+
+        /**
+         * Remember the last sample of each output (see Unit::lastOutput).
+         */
+        void _captureOutputs();
+
+        /**
+         * Clear the tags of the outputs, then zero the outputs and tag them silent if Unit::isSilent_.
+         * \returns True if the block needs no further processing.
+         */
+        bool _skipSilence();
+
+        /**
+         * Process only the control ticks that fall within Unit::getNumSamples samples, then interpolate the
+         * outputs back to audio rate.
+         */
+        void _processControlRate();
+
+        /**
+         * Size the decimated input and output spans used by Unit::_processControlRate.
+         */
+        void _resizeControlBuffers();
+
+        /**
+         * Start over from a control tick, without interpolating from previous control values.
+         */
+        void _resetControlRate();
+
         virtual Unit* _clone() const = 0;
 
     private:
@@ -460,36 +880,50 @@ namespace syn
 
     private:
         string m_name;
-        StrMap<UnitParameter, MAX_PARAMS> m_parameters;
+        std::shared_ptr<ParameterBlock> m_parameters;
+        unsigned m_parameterVersion; ///< version of `m_parameters` last seen by Unit::updateParameters
+        unsigned m_parameterVersions[MAX_PARAMS]; ///< version of each parameter last seen by Unit::updateParameters
         StrMap<OutputPort, MAX_OUTPUTS> m_outputPorts;
         StrMap<InputPort, MAX_INPUTS> m_inputPorts;
         Circuit* m_parent;
         AudioConfig m_audioConfig;
+        int m_numSamples;
+        bool m_useBlockProcessing;
+        PoolVector<Sample> m_defaultInputs; ///< One buffer per input, filled with its default (block processing only)
+        bool m_useControlRate;
+        ControlInterpolation m_controlInterpolations[MAX_OUTPUTS];
+        int m_controlPhase; ///< Samples left before the next control tick (control rate units only)
+        int m_controlCountdown; ///< See Unit::pollControlTick_
+        bool m_hasControlValues; ///< False until the first control tick after a reset
+        double m_prevControlValues[MAX_OUTPUTS]; ///< Control values interpolated from, per output
+        double m_controlValues[MAX_OUTPUTS]; ///< Control values interpolated to, per output
+        PoolVector<Sample> m_controlBuffers; ///< Decimated spans of each input, then each output, indexed by id
         MidiData m_midiData;
+        bool m_isActive; ///< Value of Unit::isActive last reported through Unit::updateActivity_
+        ParamSnapshot m_paramSnapshot;
+        bool m_hasParamSnapshot; ///< False until the first block after a reset (see Unit::_resetParameterSmoothing)
+        ProcRecord m_localProcRecord; ///< Record used when the unit is ticked on its own
+        ProcRecord* m_procRecord; ///< Record used by the processing macros (may point into a Circuit's plan)
     };
 
     template <typename ID>
     UnitParameter& Unit::param(const ID& a_id)
     {
-        return m_parameters[a_id];
+        return m_parameters->params[a_id];
     }
 
     template <typename ID>
     const UnitParameter& Unit::param(const ID& a_id) const
     {
-        return m_parameters[a_id];
-    }
-
-    template <typename ID>
-    void Unit::writeOutput_(const ID& a_id, int a_offset, const double& a_val)
-    {
-        m_outputPorts[a_id].buf()[a_offset] = a_val;
+        return m_parameters->params[a_id];
     }
 
     template <typename ID, typename T>
     bool Unit::setParam(const ID& a_id, const T& a_value)
     {
-        return m_parameters[a_id].set(a_value);
+        bool changed = m_parameters->params[a_id].set(a_value);
+        _syncParameters();
+        return changed;
     };
 }
 #endif
@@ -108,8 +108,6 @@ namespace syn
         const string& getName() const;
         int getId() const;
         UnitParameter&  setId(int a_id);
-        Unit* getParent() const;
-        UnitParameter&  setParent(Unit* a_newParent);
 
         EParamType getType() const;
 
@@ -120,6 +118,13 @@ namespace syn
         double getShape() const { return m_shape; }
         UnitParameter& setShape(double a_new_shape) { m_shape = a_new_shape; return *this; }
 
+        /**
+         * Smoothed parameters ramp linearly across a block when they change, rather than jumping at the start
+         * of the block (see Unit::readParamRamp_).
+         */
+        bool isSmoothed() const { return m_isSmoothed; }
+        UnitParameter& setSmoothed(bool a_smoothed) { m_isSmoothed = a_smoothed; return *this; }
+
         double getDefaultValue() const;
 
         int getPrecision() const;
@@ -168,17 +173,29 @@ namespace syn
         operator json() const;
 
     private:
+        /**
+         * Record a change of value, so that the units using this parameter catch up on it (see
+         * Unit::updateParameters).
+         */
+        void _markChanged();
+
+    private:
+        friend class Unit;
+        friend struct ParameterBlock;
+
         string m_name;
         int m_id;
         double m_value, m_defaultValue;
         double m_min, m_max;
         double m_shape;
         bool m_isVisible;
+        bool m_isSmoothed;
         EParamType m_type;
         EUnitsType m_unitsType;
         EControlType m_controlType;
         int m_displayPrecision;
-        Unit* m_parent;
+        unsigned m_version; ///< incremented whenever the value changes
+        unsigned* m_blockVersion; ///< version counter of the ParameterBlock holding this parameter
 
         vector<DisplayText> m_displayTexts;
     };
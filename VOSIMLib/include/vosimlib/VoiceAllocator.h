@@ -0,0 +1,170 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ *  \file VoiceAllocator.h
+ *  \brief Constant-time bookkeeping of which voice plays which note.
+ *  \details
+ *  \author Austen Satterlee
+ *  \date 10/2026
+ */
+
+#ifndef __VOICEALLOCATOR__
+#define __VOICEALLOCATOR__
+#include "vosimlib/common.h"
+#include <cstdint>
+#include <vector>
+
+#define VOICEALLOCATOR_NUM_NOTES 128
+
+namespace syn
+{
+    /**
+     * \class VoiceAllocator
+     *
+     * \brief Tracks the state of each voice of a VoiceManager, so that voices can be allocated, stolen and
+     * released without scanning them.
+     *
+     * Each voice is either idle, held (its note is on) or released (its note is off, but its tail is still
+     * playing). The voices of each state are kept in an intrusive list, ordered by the time they entered that
+     * state, so the oldest and newest voices of a state are found in constant time. Held and released voices
+     * are also bucketed by note, with a bitmap of non-empty buckets, so the voices playing a given note, or the
+     * lowest or highest note, are found with a couple of bit scans.
+     *
+     * Notes outside `[0, VOICEALLOCATOR_NUM_NOTES)` share the bucket of the nearest valid note.
+     *
+     * Only VoiceAllocator::reset allocates. Every other method runs in constant time, so the allocator can be
+     * driven from the real-time thread.
+     */
+    class VOSIMLIB_API VoiceAllocator
+    {
+    public:
+        enum VoiceState
+        {
+            Idle = 0,
+            Held,
+            Released,
+            NumVoiceStates
+        };
+
+        explicit VoiceAllocator(int a_numVoices = 0) { reset(a_numVoices); }
+
+        /**
+         * Track \p a_numVoices voices, all of them idle. Voices are handed out in index order at first.
+         */
+        void reset(int a_numVoices);
+
+        int getNumVoices() const { return static_cast<int>(m_states.size()); }
+
+        VoiceState getState(int a_voice) const { return static_cast<VoiceState>(m_states[a_voice]); }
+
+        /**
+         * \returns The note the voice was last given, or -1 if it never played one.
+         */
+        int getNote(int a_voice) const { return m_notes[a_voice]; }
+
+        /**
+         * \returns The number of voices in state \p a_state.
+         */
+        int count(VoiceState a_state) const { return m_counts[a_state]; }
+
+        /**
+         * \returns The voice that entered state \p a_state first, or -1 if there is none.
+         */
+        int oldest(VoiceState a_state) const { return m_heads[a_state]; }
+
+        /**
+         * \returns The voice that entered state \p a_state last, or -1 if there is none.
+         */
+        int newest(VoiceState a_state) const { return m_tails[a_state]; }
+
+        /**
+         * \returns The voice that entered the same state as \p a_voice right after it, or -1.
+         */
+        int next(int a_voice) const { return m_links[a_voice].next; }
+
+        /**
+         * \returns The oldest voice with the lowest note among the held or released voices, or -1.
+         */
+        int lowest(VoiceState a_state) const;
+
+        /**
+         * \returns The oldest voice with the highest note among the held or released voices, or -1.
+         */
+        int highest(VoiceState a_state) const;
+
+        /**
+         * \returns The oldest held or released voice playing \p a_note, or -1. Use
+         * VoiceAllocator::nextWithNote to find the others.
+         */
+        int firstWithNote(VoiceState a_state, int a_note) const;
+
+        /**
+         * \returns The voice that entered the same state as \p a_voice with the same note right after it, or -1.
+         */
+        int nextWithNote(int a_voice) const;
+
+        /**
+         * Mark \p a_voice as the newest held voice, playing \p a_note.
+         */
+        void hold(int a_voice, int a_note);
+
+        /**
+         * Mark the held voice \p a_voice as the newest released voice.
+         */
+        void release(int a_voice);
+
+        /**
+         * Mark \p a_voice as the newest idle voice, so that it is reused after every other idle voice.
+         */
+        void free(int a_voice);
+
+    private:
+        struct Link
+        {
+            int prev;
+            int next;
+        };
+
+        void _link(int a_voice, VoiceState a_state, int a_note);
+
+        void _unlink(int a_voice);
+
+        static int _bucket(int a_note);
+
+    private:
+        enum
+        {
+            VOICEALLOCATOR_NUM_WORDS = (VOICEALLOCATOR_NUM_NOTES + 63) / 64
+        };
+
+        std::vector<uint8_t> m_states;
+        std::vector<int> m_notes;
+        std::vector<Link> m_links; ///< position of each voice in the list of its state
+        std::vector<Link> m_noteLinks; ///< position of each held or released voice in the bucket of its note
+        int m_heads[NumVoiceStates];
+        int m_tails[NumVoiceStates];
+        int m_counts[NumVoiceStates];
+        /// Buckets of held voices, then of released voices
+        int m_noteHeads[2][VOICEALLOCATOR_NUM_NOTES];
+        int m_noteTails[2][VOICEALLOCATOR_NUM_NOTES];
+        uint64_t m_noteBitmaps[2][VOICEALLOCATOR_NUM_WORDS];
+    };
+}
+#endif
@@ -21,56 +21,111 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #define __VOICEMANAGER__
 #include "vosimlib/Circuit.h"
 #include "vosimlib/Unit.h"
-#include <boost/lockfree/spsc_queue.hpp>
-#include <boost/lockfree/policies.hpp>
+#include "vosimlib/VoiceAllocator.h"
+#include "vosimlib/WorkerPool.h"
+#include "vosimlib/CommandQueue.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 #define MAX_VOICEMANAGER_MSG_QUEUE_SIZE 1024
-#define MAX_VOICES 16
+#define DEFAULT_MAX_ACTIONS_PER_TICK 64
+#define DEFAULT_PARALLEL_VOICE_THRESHOLD 256
+#define DEFAULT_VOICE_MEMORY_BUDGET (1 << 20)
 
 using std::string;
-using boost::lockfree::spsc_queue;
-using boost::lockfree::capacity;
 
 namespace syn {
-    
-    class Command;
+
+    /**
+     * \brief A MIDI event scheduled at a sample offset within the buffer passed to VoiceManager::tick.
+     */
+    struct VOSIMLIB_API MidiEvent
+    {
+        enum Type
+        {
+            NoteOn = 0,
+            NoteOff,
+            ControlChange,
+            PitchWheel
+        };
+
+        int offset; ///< sample offset of the event relative to the start of the buffer
+        Type type;
+        int data; ///< note number or control change index
+        double value; ///< velocity, control change value or pitch wheel position
+    };
 
     class VOSIMLIB_API VoiceManager {
     public:
+        /**
+         * \brief Which voice is replaced when a note is played while every voice is busy.
+         *
+         * Voices whose note has been released are always stolen before held voices.
+         */
         enum VoiceStealPolicy {
-            Oldest = 0,
-            Newest,
-            Lowest,
-            Highest
+            Oldest = 0, ///< Steal the voice that was played first
+            Newest, ///< Steal the voice that was played last
+            Lowest, ///< Keep the lowest notes: steal the voice playing the highest note
+            Highest ///< Keep the highest notes: steal the voice playing the lowest note
         };
 
     public:
         VoiceManager()
             :
             m_queuedActions{MAX_VOICEMANAGER_MSG_QUEUE_SIZE},
-            m_lastVoiceIndex(0),
-            m_voiceTicks(0),
+            m_maxActionsPerTick(DEFAULT_MAX_ACTIONS_PER_TICK),
+            m_isAudioActive(false),
+            m_voiceSet(new VoiceSet(Circuit{"main"})),
+            m_globalCircuit(_makeDefaultGlobalCircuit()),
             m_bufferSize(1),
             m_internalBufferSize(1),
-            m_instrument{"main"},
+            m_controlPeriod(1),
+            m_voiceMemoryBudget(DEFAULT_VOICE_MEMORY_BUDGET),
+            m_voiceMemoryHugePages(false),
             m_voiceStealingPolicy(Oldest),
-            m_legato(false)
+            m_legato(false),
+            m_parallelVoiceThreshold(DEFAULT_PARALLEL_VOICE_THRESHOLD),
+            m_laneBatching(true)
         {
             setBufferSize(m_bufferSize);
             setInternalBufferSize(m_internalBufferSize);
         }
 
-        void tick(const double* a_left_input, const double* a_right_input, double* a_left_output, double* a_right_output) ;
+        void tick(const Sample* a_left_input, const Sample* a_right_input, Sample* a_left_output, Sample* a_right_output);
+
+        /**
+         * \brief Render one buffer while applying MIDI events at their exact sample offsets.
+         *
+         * Voices are rendered up to the offset of each event, then the event is applied, so events are not
+         * quantized to the start of the buffer (nor to the internal buffer size). \p a_events must be sorted by
+         * offset. Events beyond the end of the buffer are applied once the whole buffer has been rendered.
+         */
+        void tick(const Sample* a_left_input, const Sample* a_right_input, Sample* a_left_output, Sample* a_right_output,
+                  const MidiEvent* a_events, int a_numEvents);
 
         /**
          * Safely queue a function to be called on the real-time thread in between samples.
          * 
          * Note that this function should ONLY be called from the gui thread! This is a single-producer
          * single-consumer queue!
+         *
+         * The function is stored inline (see CommandQueue), so queuing it and running it never allocate on
+         * the real-time thread, and it is destroyed back on the gui thread.
          * 
          * \returns True if the message was pushed onto the queue, false if the queue was full.
          */
-        bool queueAction(Command* a_action);
+        template <typename F>
+        bool queueAction(F&& a_action) { return m_queuedActions.push(std::forward<F>(a_action)); }
+
+        /**
+         * \brief Set the maximum number of queued actions run at the start of each call to VoiceManager::tick.
+         *
+         * Remaining actions are deferred to the following ticks, so a burst of edits cannot push a single
+         * tick past its deadline.
+         */
+        void setMaxActionsPerTick(int a_maxActions) { m_maxActionsPerTick = a_maxActions > 0 ? a_maxActions : 1; }
+        int getMaxActionsPerTick() const { return m_maxActionsPerTick; }
 
         /**
          * \brief The number of samples read and produced by the tick() method of the VoiceManager.
@@ -85,23 +140,79 @@ namespace syn {
 
         void setFs(double a_newFs);
         void setTempo(double a_newTempo);
+
+        /**
+         * \brief Set the control period of every circuit (see Unit::setControlPeriod).
+         *
+         * Like VoiceManager::setFs, this must not be called while the voices are being ticked.
+         */
+        void setControlPeriod(int a_controlPeriod);
+        int getControlPeriod() const { return m_controlPeriod; }
+
+        /**
+         * \brief Play a note on an idle voice, or steal one according to the voice stealing policy.
+         *
+         * Voices are allocated and released in constant time, whatever the number of voices.
+         */
         void noteOn(int a_noteNumber, int a_velocity);
         void noteOff(int a_noteNumber);
         void sendControlChange(int a_cc, double a_value);
         void sendPitchWheelChange(double a_value);
 
+        /**
+         * \brief Replace the voices with \p a_newMax fresh copies of the prototype circuit.
+         *
+         * The new voices are built on the calling thread and handed over to the real-time thread through the
+         * action queue, in order with the other queued actions. The old voices are destroyed back on the calling
+         * thread. While audio is active, this blocks until the real-time thread has picked up the new voices, so it
+         * must NOT be called from the real-time thread (nor queued with VoiceManager::queueAction). Otherwise, the
+         * queued actions are run on the calling thread (see VoiceManager::setAudioActive). There is no upper limit
+         * on the number of voices, besides memory (see VoiceManager::setVoiceMemoryBudget).
+         */
         void setMaxVoices(int a_newMax);
 
         vector<int> getActiveVoiceIndices() const;
         vector<int> getReleasedVoiceIndices() const;
         vector<int> getIdleVoiceIndices() const;
 
+        /**
+         * \returns The number of voices that are playing, whether their note is held or released.
+         */
+        int getNumActiveVoices() const;
+
+        /**
+         * \brief Call \p a_func with the index of each voice that is playing, in increasing order.
+         *
+         * Unlike VoiceManager::getActiveVoiceIndices, this does not allocate, so it can be called on every
+         * frame by the gui.
+         */
+        template <typename F>
+        void forEachActiveVoice(F&& a_func) const;
+
         int getMaxVoices() const;
 
         int getNewestVoiceIndex() const;
 
+        /**
+         * \brief Run the queued actions on the calling thread, if the real-time thread is not active.
+         *
+         * While audio is active (see VoiceManager::setAudioActive), the real-time thread is the only one that runs
+         * queued actions, so this only destroys the actions it has already run.
+         */
         void onIdle();
 
+        /**
+         * \brief Tell the VoiceManager whether the real-time thread may be calling VoiceManager::tick.
+         *
+         * While audio is active, queued actions only run on the real-time thread, and calls that wait for them
+         * (e.g. VoiceManager::setMaxVoices) block until it picks them up. While it is inactive, which is the
+         * default, they run on the calling thread instead. The host must call this while no tick is in progress,
+         * e.g. when the plug-in is suspended or resumed. Activating waits for any actions being run on another
+         * thread to complete.
+         */
+        void setAudioActive(bool a_isActive);
+        bool isAudioActive() const { return m_isAudioActive.load(std::memory_order_acquire); }
+
         /**
          * Retrieves a unit from a specific voice circuit.
          * If \p a_voiceId is negative, the unit is retrieved from the prototype circuit.
@@ -112,38 +223,249 @@ namespace syn {
         Circuit& getPrototypeCircuit();
         const Circuit& getPrototypeCircuit() const;
 
+        /**
+         * \brief Add \p a_unit to the prototype circuit, and a copy of it to every voice.
+         *
+         * The copies share their parameters with \p a_unit, so changing a parameter of the prototype's unit
+         * applies to every voice at once. Like any other edit, this must be run through
+         * VoiceManager::queueAction once audio is running.
+         *
+         * \returns The id of the new unit.
+         */
+        int addUnit(Unit* a_unit);
+
         /**
          * Retrieve the specified voice circuit. Returns the prototype circuit if \p a_voiceId is negative.
          */
         Circuit& getVoiceCircuit(int a_voiceId);
         const Circuit& getVoiceCircuit(int a_voiceId) const;
 
+        /**
+         * \brief Replace the prototype circuit and rebuild every voice from it.
+         * \see VoiceManager::setMaxVoices for threading requirements.
+         */
         void setPrototypeCircuit(const Circuit& a_circ);
 
+        /**
+         * \brief Circuit processed once per buffer on the mix of all voices.
+         *
+         * Its inputs receive the summed voice output, and its outputs are written to the output buffers of
+         * VoiceManager::tick. Units placed here (e.g. delays and reverbs) are not duplicated per voice, and they
+         * keep running when no voice is active. By default, the mix is passed through unchanged. Like the
+         * prototype circuit, it must only be edited through VoiceManager::queueAction once audio is running.
+         */
+        Circuit& getGlobalCircuit() { return *m_globalCircuit; }
+        const Circuit& getGlobalCircuit() const { return *m_globalCircuit; }
+
+        /**
+         * \brief Replace the global circuit.
+         * \see VoiceManager::setMaxVoices for threading requirements.
+         */
+        void setGlobalCircuit(const Circuit& a_circ);
+
+        /**
+         * \brief Restore the default global circuit, which passes the voice mix through unchanged.
+         */
+        void resetGlobalCircuit();
+
         VoiceStealPolicy getVoiceStealPolicy() const { return m_voiceStealingPolicy; }
         void setVoiceStealPolicy(VoiceStealPolicy a_newPolicy) { m_voiceStealingPolicy = a_newPolicy; }
 
+        /**
+         * \brief Set the number of worker threads that render voices alongside the real-time thread.
+         *
+         * With no worker threads, voices are rendered serially. The output is bit-identical either way.
+         * This blocks until the old workers have exited, so it must not be called from the real-time thread,
+         * but it does not need to be queued: the real-time thread renders serially while the pool is
+         * reconfigured.
+         */
+        void setNumWorkerThreads(int a_numThreads) { m_workerPool.setNumThreads(a_numThreads); }
+        int getNumWorkerThreads() const { return m_workerPool.getNumThreads(); }
+
+        /**
+         * \brief Pin the worker threads to the given CPUs. See WorkerPool::setAffinity.
+         */
+        bool setWorkerThreadAffinity(const vector<int>& a_cpus) { return m_workerPool.setAffinity(a_cpus); }
+
+        /**
+         * \brief Minimum amount of work (active voices times samples per tick) for which voices are rendered in
+         * parallel. Smaller loads are rendered serially, as waking the workers would cost more than it saves.
+         */
+        void setParallelVoiceThreshold(int a_threshold) { m_parallelVoiceThreshold = a_threshold; }
+        int getParallelVoiceThreshold() const { return m_parallelVoiceThreshold; }
+
+        /**
+         * \brief Render up to SYN_LANES voices in lockstep (see Circuit::tickLanes).
+         *
+         * Voices are copies of the same prototype, so units with a vectorized kernel can advance several voices
+         * at once. Batches are formed among active voices whose circuits are lane-compatible. Enabled by default.
+         */
+        void setLaneBatching(bool a_enable) { m_laneBatching = a_enable; }
+        bool getLaneBatching() const { return m_laneBatching; }
+
+        /**
+         * \brief Number of bytes reserved per voice in the arena that voices are built in.
+         *
+         * Each voice is laid out in its own contiguous slice of a single arena (a MemoryPool carved from the
+         * arena's pool), which holds its units, port buffers, execution plan and delay lines, all aligned to
+         * cache lines. Resizing them on the real-time thread thus takes bounded time, and rendering a voice
+         * touches few pages. A voice that outgrows its slice draws from the spare room of the arena, then from
+         * the heap. This takes effect the next time voices are rebuilt (see VoiceManager::setMaxVoices).
+         */
+        void setVoiceMemoryBudget(size_t a_numBytes) { m_voiceMemoryBudget = a_numBytes; }
+        size_t getVoiceMemoryBudget() const { return m_voiceMemoryBudget; }
+
+        /**
+         * \brief Back the voice arena with huge pages, if the OS allows it (see MemoryPool::getBacking).
+         *
+         * Off by default. This takes effect the next time voices are rebuilt.
+         */
+        void setVoiceMemoryHugePages(bool a_enable) { m_voiceMemoryHugePages = a_enable; }
+        bool getVoiceMemoryHugePages() const { return m_voiceMemoryHugePages; }
+
+        /**
+         * \returns The usage statistics of the arena the current voices are built in. Not real-time safe.
+         */
+        MemoryPool::Stats getVoiceMemoryStats() const;
+
+        /**
+         * A region of the voice arena, as listed by VoiceManager::getVoiceMemoryMap.
+         */
+        struct VoiceMemoryRegion
+        {
+            int voice; ///< Index of the voice, or -1 for the whole arena
+            const void* begin;
+            size_t numBytes;
+            MemoryPool::Backing backing;
+            MemoryPool::Stats stats;
+            vector<MemoryPool::BlockInfo> blocks;
+        };
+
+        /**
+         * \returns The layout of the voice arena followed by the slice of each voice, for diagnostics. Not
+         * real-time safe.
+         */
+        vector<VoiceMemoryRegion> getVoiceMemoryMap() const;
+
     private:
         /**
-         * Processes all actions from the action queue
+         * \brief Everything that is rebuilt when the polyphony or the prototype circuit changes.
+         */
+        struct VoiceSet
+        {
+            explicit VoiceSet(const Circuit& a_instrument) :
+                instrument(a_instrument),
+                lastVoiceIndex(0) {}
+
+            // The arena and its slices are declared first, so that they outlive the voices built in them
+            std::unique_ptr<MemoryPool> memory; ///< arena holding every voice
+            vector<std::unique_ptr<MemoryPool>> voiceMemory; ///< slice of the arena holding each voice
+            Circuit instrument;
+            vector<Circuit> voices;
+            VoiceAllocator allocator; ///< idle, held and released voices, and the note played by each
+            int lastVoiceIndex;
+            vector<Sample> voiceScratch; ///< per-voice left and right output buffers, each `m_bufferSize` samples long
+            vector<int> activeVoices; ///< indices of the voices rendered by the current call to VoiceManager::tick
+            vector<int> batchStarts; ///< index into `activeVoices` at which each batch begins, followed by its size
+        };
+
+        /**
+         * Processes up to \p a_maxActions actions from the action queue
+         */
+        void _flushActionQueue(int a_maxActions);
+
+        /**
+         * Fill \p a_set with \p a_numVoices copies of its prototype circuit.
+         */
+        void _buildVoices(VoiceSet& a_set, int a_numVoices) const;
+
+        /**
+         * Queue an action that swaps \p a_value into \p a_current, and wait until it has run. The action takes
+         * ownership of the old value, which is destroyed when the queue returns the action to this thread.
+         */
+        template <typename T>
+        void _publish(std::unique_ptr<T>& a_current, std::unique_ptr<T> a_value);
+
+        static std::unique_ptr<Circuit> _makeDefaultGlobalCircuit();
+
+        /**
+         * Block until every queued action has run. If audio is not active, the actions are run on the calling
+         * thread instead, as in VoiceManager::onIdle.
+         */
+        void _waitForActions();
+
+        void _applyEvent(const MidiEvent& a_event);
+
+        /**
+         * \returns The voice in state \p a_state that the voice stealing policy would replace, or -1.
+         */
+        int _selectVoiceToSteal(const VoiceSet& a_set, VoiceAllocator::VoiceState a_state) const;
+
+        /**
+         * Free the voices that have gone silent, and list the others in `activeVoices`.
+         */
+        void _collectActiveVoices(VoiceSet& a_set);
+
+        /**
+         * Render samples `[a_start, a_end)` of the active voices and mix them into the output buffers.
+         */
+        void _renderSegment(int a_start, int a_end, const Sample* a_left_input, const Sample* a_right_input, Sample* a_left_output, Sample* a_right_output);
+
+        /**
+         * Render samples `[a_start, a_end)` of a batch of lane-compatible voices into their scratch buffers.
+         */
+        void _renderVoices(const int* a_voiceIndices, int a_numVoices, int a_start, int a_end, const Sample* a_left_input, const Sample* a_right_input);
+
+        /**
+         * Run the global circuit over the voice mix, in place.
          */
-        void _flushActionQueue();
+        void _renderGlobal(Sample* a_left_output, Sample* a_right_output);
+
+        void _resizeScratchBuffers();
 
     private:
-        spsc_queue<Command*> m_queuedActions;
+        CommandQueue m_queuedActions;
+        int m_maxActionsPerTick;
+        std::atomic<bool> m_isAudioActive; ///< set by the host, see VoiceManager::setAudioActive
+        std::mutex m_idleMutex; ///< held while actions run off the real-time thread, so audio cannot be activated meanwhile
 
-        vector<Circuit> m_voices;
-        vector<int> m_voiceBirths; ///< value of `m_voiceTicks` recorded upon voice activation
-        int m_lastVoiceIndex;
-        int m_voiceTicks; ///< counts the total number of voices activated since the beginning
+        std::unique_ptr<VoiceSet> m_voiceSet; ///< only replaced by actions run on the real-time thread
+        std::unique_ptr<Circuit> m_globalCircuit; ///< only replaced by actions run on the real-time thread
         int m_bufferSize; ///< size of the buffers that will be written to by VoiceManager::tick
         int m_internalBufferSize; ///< size of the voice buffers that will be read from by VoiceManager::tick
-
-        Circuit m_instrument;
+        int m_controlPeriod; ///< applied to every circuit, including those set later
+        size_t m_voiceMemoryBudget;
+        bool m_voiceMemoryHugePages;
 
         VoiceStealPolicy m_voiceStealingPolicy; ///< Determines which voices are replaced when all of them are active
 
         bool m_legato; ///< When true, voices get reset upon activation only if they are in the "note off" state.
+
+        WorkerPool m_workerPool;
+        int m_parallelVoiceThreshold;
+        bool m_laneBatching;
     };
+
+    template <typename F>
+    void VoiceManager::forEachActiveVoice(F&& a_func) const
+    {
+        const VoiceAllocator& allocator = m_voiceSet->allocator;
+        for (int i = 0; i < allocator.getNumVoices(); i++) {
+            if (allocator.getState(i) != VoiceAllocator::Idle)
+                a_func(i);
+        }
+    }
+
+    template <typename T>
+    void VoiceManager::_publish(std::unique_ptr<T>& a_current, std::unique_ptr<T> a_value)
+    {
+        // The real-time thread only swaps pointers. The action is left holding the old value, which is destroyed
+        // on this thread once the queue hands the action back.
+        std::unique_ptr<T>* current = &a_current;
+        auto swapValues = [current, value = std::move(a_value)]() mutable { std::swap(value, *current); };
+        while (!m_queuedActions.push(std::move(swapValues)))
+            _waitForActions();
+        _waitForActions();
+    }
 }
 #endif
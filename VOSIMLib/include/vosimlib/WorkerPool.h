@@ -0,0 +1,145 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ *  \file WorkerPool.h
+ *  \brief Persistent thread pool for fork-join parallelism on the real-time thread.
+ *  \details
+ *  \author Austen Satterlee
+ *  \date 10/2026
+ */
+
+#ifndef __WORKERPOOL__
+#define __WORKERPOOL__
+#include "vosimlib/common.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace syn
+{
+    /**
+     * \class WorkerPool
+     *
+     * \brief Persistent pool of worker threads used to split work from the real-time thread.
+     *
+     * Threads are spawned up front (WorkerPool::setNumThreads is not real-time safe), and work is handed off
+     * through a single atomic word, so WorkerPool::run never locks or allocates. The calling thread takes part
+     * in the work, so progress never depends on how quickly the workers wake up: idle workers spin for a
+     * short while, then yield, and finally sleep until new work is published.
+     *
+     * Only one call to WorkerPool::run may be in flight at a time. Nested or concurrent calls execute their
+     * tasks serially on the calling thread.
+     */
+    class VOSIMLIB_API WorkerPool
+    {
+    public:
+        typedef void (*TaskFunc)(void* a_context, int a_taskIndex);
+
+        explicit WorkerPool(int a_numThreads = 0);
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        ~WorkerPool();
+
+        /**
+         * Stop the current workers and spawn \p a_numThreads new ones.
+         *
+         * This blocks the calling thread, so it should not be called from the real-time thread. It is safe to
+         * call while another thread uses the pool: calls to WorkerPool::run made in the meantime are simply
+         * executed serially.
+         */
+        void setNumThreads(int a_numThreads);
+
+        /**
+         * \returns The number of worker threads, not counting the thread that calls WorkerPool::run. Safe to call
+         * from any thread, including while another thread calls WorkerPool::setNumThreads.
+         */
+        int getNumThreads() const;
+
+        /**
+         * Pin worker `i` to CPU `a_cpus[i % a_cpus.size()]`. The affinity is applied to the current workers and
+         * to any worker spawned later. An empty list leaves scheduling to the OS. Not real-time safe.
+         *
+         * \returns False if the affinity of any worker could not be set (e.g. unsupported platform).
+         */
+        bool setAffinity(const std::vector<int>& a_cpus);
+        const std::vector<int>& getAffinity() const { return m_affinity; }
+
+        /**
+         * Call `a_func(a_context, i)` for every `i` in `[0, a_numTasks)` and return once all calls completed.
+         */
+        void run(int a_numTasks, TaskFunc a_func, void* a_context);
+
+        /**
+         * Call `a_func(i)` for every `i` in `[0, a_numTasks)` and return once all calls completed.
+         */
+        template <typename F>
+        void parallelFor(int a_numTasks, F& a_func)
+        {
+            run(a_numTasks, [](void* a_context, int a_taskIndex) { (*static_cast<F*>(a_context))(a_taskIndex); }, &a_func);
+        }
+
+    private:
+        void _lock();
+
+        void _unlock();
+
+        void _startThreads(int a_numThreads);
+
+        bool _applyAffinity();
+
+        void _stopThreads();
+
+        void _workerLoop();
+
+        /**
+         * Claim and execute one task of the given generation.
+         * \returns False if the generation has no tasks left to claim.
+         */
+        bool _runTask(uint64_t a_generation);
+
+    private:
+        std::vector<std::thread> m_threads;
+        std::vector<int> m_affinity;
+        std::atomic<int> m_numThreads; ///< Size of m_threads, which is only accessed with the pool locked
+
+        /**
+         * \brief Work descriptor, packed as (generation, number of tasks, next task index).
+         *
+         * Tasks are claimed by incrementing the index with a compare-and-swap, which fails as soon as a newer
+         * generation has been published.
+         */
+        std::atomic<uint64_t> m_work;
+        std::atomic<int> m_numCompleted;
+        std::atomic<bool> m_isBusy;
+        std::atomic<bool> m_quit;
+        std::atomic<int> m_numSleeping;
+
+        TaskFunc m_func;
+        void* m_context;
+
+        std::mutex m_sleepMutex;
+        std::condition_variable m_wakeCondition;
+    };
+}
+#endif
@@ -56,4 +56,16 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 
 namespace syn{
     typedef uint64_t UnitTypeId;
+
+    /**
+     * Type of the samples that flow between units, and of the lookup tables. Builds configured with
+     * VOSIMLIB_SINGLE_PRECISION use floats, which doubles the SIMD width and halves the memory traffic of
+     * every buffer. Parameters, and the internal state of units that need the extra precision to stay stable
+     * (e.g. filter integrators), remain doubles either way.
+     */
+#if defined(VOSIMLIB_SINGLE_PRECISION)
+    typedef float Sample;
+#else
+    typedef double Sample;
+#endif
 }
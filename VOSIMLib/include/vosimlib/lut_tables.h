@@ -7,9 +7,9 @@
 
 namespace syn{
     /*::lut_decl::*/
+    class NormalTable;
     class AffineTable;
     class ResampledTable;
-    class NormalTable;
     class BlimpTable;
     BlimpTable& VOSIMLIB_API lut_blimp_table_offline();
     BlimpTable& VOSIMLIB_API lut_blimp_table_online();
@@ -29,25 +29,77 @@
 #define __TABLES__
 
 #define DO_LERP_FOR_SINC true
+#define DEFAULT_MIPMAP_LEVELS_PER_OCTAVE 4
+#define MIPMAP_OVERSAMPLING 16 ///< samples per period of the highest harmonic kept in a mipmap level
+#define MIPMAP_MIN_LEVEL_SIZE 32
+#define DEFAULT_SINC_FILTER_PHASES 128
+#define SINC_FILTER_BANDS_PER_OCTAVE 8
+#define SINC_FILTER_MAX_TAPS 256
+#define RESAMPLED_TABLE_CACHE_VERSION 1
 #include "vosimlib/common.h"
 #include "vosimlib/DSPMath.h"
 #include "vosimlib/lut_tables.h"
 #include <vector>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 
 namespace syn {
 
+    /**
+     * Samples of a generated table, in the format genTables.py stored them in. Compact formats trade accuracy
+     * for binary size: Float32 halves the size of double precision tables, and Int16 stores each sample as
+     * `offset + scale * value`.
+     */
+    struct VOSIMLIB_API TableStorage {
+        enum Format {
+            Native = 0, ///< syn::Sample
+            Float32,
+            Int16
+        };
+
+        Format format;
+        const void* data;
+        int size;
+        double scale;
+        double offset;
+    };
+
+    /**
+     * \returns The samples of \p a_storage converted to Sample, or null if they are already stored as Sample and
+     * can be read in place.
+     */
+    std::shared_ptr<const std::vector<Sample>> VOSIMLIB_API decodeTable(const TableStorage& a_storage);
+
+    /**
+     * Lookup table over samples of type Sample. Interpolation is always computed in double precision.
+     */
     template <class T>
     class VOSIMLIB_API LUT {
     protected:
-        const double* m_data;
+        std::shared_ptr<const std::vector<Sample>> m_decoded; ///< samples decoded from a compact TableStorage, shared by copies
+        const Sample* m_data;
     public:
         const int m_size;
 
-        LUT(const double* a_data, int a_size)
+        LUT(const Sample* a_data, int a_size)
             : m_data(a_data),
               m_size(a_size) {}
 
+        /**
+         * Read the samples of \p a_storage in place if it holds Sample values, or decode them once otherwise.
+         */
+        explicit LUT(const TableStorage& a_storage)
+            : m_decoded(decodeTable(a_storage)),
+              m_data(m_decoded ? m_decoded->data() : static_cast<const Sample*>(a_storage.data)),
+              m_size(a_storage.size) {}
+
         virtual ~LUT() = default;
 
         double lerp(double phase) const {
@@ -76,7 +128,7 @@ namespace syn {
             return phase;
         }
 
-        const double* data() const {
+        const Sample* data() const {
             return m_data;
         }
     };
@@ -84,12 +136,18 @@ namespace syn {
     class VOSIMLIB_API AffineTable : public LUT<AffineTable> {
         double m_min, m_max, m_scale;
     public:
-        AffineTable(const double* a_data, int a_size, double a_min = 0.0, double a_max = 1.0)
+        AffineTable(const Sample* a_data, int a_size, double a_min = 0.0, double a_max = 1.0)
             : LUT<AffineTable>(a_data, a_size),
               m_min(a_min),
               m_max(a_max),
               m_scale((a_size - 1) * 1.0 / (a_max - a_min)) {}
 
+        AffineTable(const TableStorage& a_storage, double a_min = 0.0, double a_max = 1.0)
+            : LUT<AffineTable>(a_storage),
+              m_min(a_min),
+              m_max(a_max),
+              m_scale((a_storage.size - 1) * 1.0 / (a_max - a_min)) {}
+
         double inputMin() const { return m_min; }
         double inputMax() const { return m_max; }
 
@@ -100,9 +158,12 @@ namespace syn {
 
     class VOSIMLIB_API NormalTable : public LUT<NormalTable> {
     public:
-        NormalTable(const double* a_data, int a_size)
+        NormalTable(const Sample* a_data, int a_size)
             : LUT<NormalTable>(a_data, a_size) {}
 
+        explicit NormalTable(const TableStorage& a_storage)
+            : LUT<NormalTable>(a_storage) {}
+
         double index(double phase) const {
             return phase * m_size;
         }
@@ -110,45 +171,233 @@ namespace syn {
 
     class VOSIMLIB_API BlimpTable : public LUT<BlimpTable> {
     public:
-        BlimpTable(const double* a_data, int a_size, int a_taps, int a_res)
+        BlimpTable(const Sample* a_data, int a_size, int a_taps, int a_res)
             : LUT<BlimpTable>(a_data, a_size),
               taps(a_taps),
               res(a_res) {}
 
+        BlimpTable(const TableStorage& a_storage, int a_taps, int a_res)
+            : LUT<BlimpTable>(a_storage),
+              taps(a_taps),
+              res(a_res) {}
+
         const int taps;
         const int res;
     };
 
+    /**
+     * Polyphase bank of windowed sinc filters, precomputed from a BlimpTable.
+     *
+     * Phase k of the bank holds the taps that interpolate a table at a fractional offset of k/num_phases past
+     * one of its samples. The taps are interpolated from the blimp table and normalized to unity gain once, at
+     * construction. A lookup blends the dot products of the two phases surrounding the offset.
+     */
+    class VOSIMLIB_API SincFilterBank {
+    public:
+        /**
+         * \param a_cutoff Cutoff frequency relative to the Nyquist frequency of the tables the bank is applied to.
+         * Use the ratio of the new period to the table size when downsampling.
+         * \param a_num_taps Number of taps of each phase, or 0 to cover the support of the blimp table. It is
+         * rounded up to a multiple of 4 and capped to SINC_FILTER_MAX_TAPS.
+         */
+        SincFilterBank(const BlimpTable& a_blimp_table, double a_cutoff = 1.0, int a_num_phases = DEFAULT_SINC_FILTER_PHASES,
+                       int a_num_taps = 0);
+
+        int numPhases() const { return m_num_phases; }
+        int numTaps() const { return m_num_taps; }
+        double cutoff() const { return m_cutoff; }
+
+        /// \returns The taps of phase \p a_phase, in the range [0, numPhases()].
+        const Sample* taps(int a_phase) const { return &m_taps[a_phase * m_num_taps]; }
+
+    private:
+        int m_num_phases;
+        int m_num_taps;
+        double m_cutoff;
+        std::vector<Sample> m_taps; ///< numPhases() + 1 phases, so that the last one can be blended with the next
+    };
+
     /**
      * Lookup table that can resample itself with sinc interpolation.
      * Upon construction, the table computes and caches downsampled versions
      * of itself. Each downsampled table is half the size of the previous,
      * so log2(N) tables are created, where N is the size of the initial
-     * table.
+     * table. The sinc filters are precomputed in a SincFilterBank per band of
+     * cutoff frequencies, and the widest band below the new Nyquist frequency
+     * is used.
+     *
+     * The downsampled tables are the expensive part of the construction. They
+     * are generated in parallel, can be generated in the background (see
+     * ResampledTable::setBackgroundGeneration) and can be cached on disk (see
+     * ResampledTable::setCacheDirectory).
+     *
+     * The table also builds a mipmap of band-limited copies of itself, which is much cheaper to read than the
+     * sinc resampler. Each mipmap level keeps the harmonics of the table up to a limit that falls by
+     * 1/levels_per_octave of an octave from one level to the next, and is synthesized from the spectrum of the
+     * table at a power of two size. ResampledTable::getMipmapped crossfades between the two levels surrounding
+     * the requested period, so that no harmonic above the Nyquist frequency is ever read.
      */
     class VOSIMLIB_API ResampledTable : public NormalTable {
     public:
-        ResampledTable(const double* a_table, int a_size, const BlimpTable& a_blimp_table_online,
-                       const BlimpTable& a_blimp_table_offline);
+        ResampledTable(const Sample* a_table, int a_size, const BlimpTable& a_blimp_table_online,
+                       const BlimpTable& a_blimp_table_offline, int a_mip_levels_per_octave = DEFAULT_MIPMAP_LEVELS_PER_OCTAVE);
+
+        ResampledTable(const TableStorage& a_storage, const BlimpTable& a_blimp_table_online,
+                       const BlimpTable& a_blimp_table_offline, int a_mip_levels_per_octave = DEFAULT_MIPMAP_LEVELS_PER_OCTAVE);
+
+        /**
+         * Copies share the immutable tables derived from the samples of \p a_o, so copying neither computes
+         * nor allocates anything.
+         */
+        ResampledTable(const ResampledTable& a_o) = default;
+
+        /**
+         * Generate the downsampled tables of the tables constructed from now on in a background thread, so that
+         * construction returns immediately. Until they are ready, ResampledTable::getResampled reads the mipmap
+         * instead.
+         */
+        static void setBackgroundGeneration(bool a_background);
+
+        static bool backgroundGeneration();
+
+        /**
+         * Save the downsampled tables of the tables constructed from now on in \p a_directory, and load them
+         * from there instead of generating them when they were already saved. Cache files are keyed by
+         * ResampledTable::cacheKey. An empty string, the default, disables the cache.
+         */
+        static void setCacheDirectory(const std::string& a_directory);
+
+        static std::string cacheDirectory();
 
-        ResampledTable(const ResampledTable& a_o)
-            : ResampledTable(a_o.m_data, a_o.m_size, a_o.m_blimp_table_online, a_o.m_blimp_table_offline) {}
+        /**
+         * \returns A hash of the table, of the offline blimp table and of RESAMPLED_TABLE_CACHE_VERSION.
+         */
+        uint64_t cacheKey() const;
 
+        /// \returns True once the downsampled tables have been generated or loaded.
+        bool isReady() const { return m_payload->ready.load(std::memory_order_acquire); }
+
+        /// Block until the downsampled tables have been generated or loaded.
+        void waitUntilReady() const;
 
         /// Retrieve a single sample from the table at the specified phase, as if the table were resampled to have the given period.
         double getResampled(double a_phase, double a_period) const;
 
-        const std::vector<std::vector<double>>& resampledTables() const { return m_resampled_tables; }
+        /**
+         * Pair of adjacent mipmap levels to crossfade for a given period, see ResampledTable::mipPosition.
+         */
+        struct MipPosition {
+            int level;
+            double blend; ///< weight of the level after MipPosition::level
+        };
+
+        /**
+         * Select the mipmap levels to read for the given period (in fractional number of samples). The result
+         * only changes with the period, so callers that play a table at a steady period may compute it once and
+         * reuse it.
+         */
+        MipPosition mipPosition(double a_period) const {
+            const int num_levels = static_cast<int>(m_payload->mip_sizes.size());
+            // Fractional level at which the highest harmonic kept lands exactly on the Nyquist frequency
+            const double level = CLAMP<double>(m_payload->mip_levels_per_octave * std::log2(m_payload->mip_top_period / a_period), -1.0, num_levels);
+            const int first = CLAMP<int>(static_cast<int>(std::ceil(level)), 0, num_levels - 1);
+            const double blend = first == num_levels - 1 ? 0.0 : MAX<double>(0.0, level - first + 1.0);
+            return { first, blend };
+        }
+
+        /**
+         * Retrieve a single sample from the mipmap at the specified phase, band-limited for the given period (in
+         * fractional number of samples). This is an approximation of ResampledTable::getResampled that costs
+         * two linear interpolations.
+         *
+         * \param a_phase Phase to sample at, in the range [0,1).
+         */
+        double getMipmapped(double a_phase, double a_period) const {
+            return getMipmapped(a_phase, mipPosition(a_period));
+        }
+
+        double getMipmapped(double a_phase, const MipPosition& a_position) const {
+            const double first_sample = _mip_lerp(a_position.level, a_phase);
+            if (a_position.blend == 0.0)
+                return first_sample;
+            return LERP<double>(first_sample, _mip_lerp(a_position.level + 1, a_phase), a_position.blend);
+        }
+
+        const std::vector<std::vector<Sample>>& resampledTables() const {
+            waitUntilReady();
+            return m_payload->resampled_tables;
+        }
+
+        int numMipLevels() const { return static_cast<int>(m_payload->mip_sizes.size()); }
+
+        const Sample* mipLevel(int a_level) const { return &m_payload->mip_data[m_payload->mip_offsets[a_level]]; }
+
+        int mipLevelSize(int a_level) const { return m_payload->mip_sizes[a_level]; }
+
+        /// \returns The highest harmonic of the table kept in the given mipmap level.
+        int mipLevelHarmonics(int a_level) const { return m_payload->mip_harmonics[a_level]; }
 
     private:
-        void _resample_tables();
+        /**
+         * Everything a ResampledTable derives from its samples. Apart from the downsampled tables, which may be
+         * filled by a background thread until Payload::ready is set, it never changes after construction.
+         */
+        struct Payload {
+            Payload(const Sample* a_data, int a_size, const BlimpTable& a_blimp_table_online,
+                    const BlimpTable& a_blimp_table_offline, int a_mip_levels_per_octave);
+
+            Payload(const Payload&) = delete;
+            Payload& operator=(const Payload&) = delete;
+
+            ~Payload();
+
+            uint64_t cacheKey() const;
+
+            /// Fill the downsampled tables from the cache or by resampling the table, then mark them as ready.
+            void generateTables();
+
+            bool loadCache(const std::string& a_path);
+
+            void saveCache(const std::string& a_path) const;
+
+            void buildMipmaps();
+
+            const Sample* data;
+            int size;
+            const BlimpTable& blimp_table_online;
+            const BlimpTable& blimp_table_offline;
+
+            std::vector<SincFilterBank> sinc_banks; ///< one bank per band, with cutoffs spaced by SINC_FILTER_BANDS_PER_OCTAVE
+            int num_resampled_tables;
+            std::vector<int> resampled_sizes;
+            std::vector<std::vector<Sample>> resampled_tables;
+
+            int mip_levels_per_octave;
+            double mip_top_period; ///< shortest period that level 0 can be played at without aliasing
+            std::vector<int> mip_offsets;
+            std::vector<int> mip_sizes;
+            std::vector<int> mip_harmonics;
+            std::vector<Sample> mip_data; ///< all mipmap levels, back to back
+
+            std::string cache_directory;
+            std::atomic<bool> ready;
+            mutable std::mutex ready_mutex;
+            mutable std::condition_variable ready_cond;
+            std::thread generator;
+        };
+
+        void _build_payload(const BlimpTable& a_blimp_table_online, const BlimpTable& a_blimp_table_offline, int a_mip_levels_per_octave);
+
+        double _mip_lerp(int a_level, double a_phase) const {
+            const Sample* table = &m_payload->mip_data[m_payload->mip_offsets[a_level]];
+            const int mask = m_payload->mip_sizes[a_level] - 1;
+            const double index = a_phase * (mask + 1);
+            const int k = static_cast<int>(index);
+            return LERP<double>(table[k & mask], table[(k + 1) & mask], index - k);
+        }
 
     private:
-        int m_num_resampled_tables;
-        std::vector<int> m_resampled_sizes;
-        std::vector<std::vector<double>> m_resampled_tables;
-        const BlimpTable& m_blimp_table_online;
-        const BlimpTable& m_blimp_table_offline;
+        std::shared_ptr<const Payload> m_payload;
     };
 
     /**
@@ -159,8 +408,17 @@ namespace syn {
      * \param phase Phase to sample at, in the range [0,1).
      * \param newSize Desired period of resampled table (in fractional number of samples)
      */
-    double VOSIMLIB_API getresampled_single(const double* table, int size, double phase, double new_period,
+    double VOSIMLIB_API getresampled_single(const Sample* table, int size, double phase, double new_period,
                                             const BlimpTable& blimp_table);
+
+    /**
+     * Retrieve a single sample from table with the precomputed filters of \p bank. This is equivalent to the
+     * variant above for a period whose ratio to \p size is the cutoff of the bank (or greater than 1, for a
+     * bank with a cutoff of 1), at the cost of two dot products.
+     *
+     * \param phase Phase to sample at, in the range [0,1).
+     */
+    double VOSIMLIB_API getresampled_single(const Sample* table, int size, double phase, const SincFilterBank& bank);
     /**
      * Resample an entire table to have the specified period and store the
      * result in resampled_table (which should already be allocated), using
@@ -171,12 +429,12 @@ namespace syn {
      * \param a_newSize Desired period of resampled table (in fractional number of samples). The allocated size of the output table should be ceil(period).
      * \param a_preserve_amplitude Scales min and max of output table to match input table.
      */
-    void VOSIMLIB_API resample_table(const double* a_table, int a_size, double* a_new_table, double a_new_period,
+    void VOSIMLIB_API resample_table(const Sample* a_table, int a_size, Sample* a_new_table, double a_new_period,
                                      const BlimpTable& a_blimp_table, bool a_preserve_amplitude = true);
 
     /**
      * \todo
      */
-    void fft_resample_table(const double* table, int size, double* resampled_table, double period);
+    void fft_resample_table(const Sample* table, int size, Sample* resampled_table, double period);
 }
 #endif
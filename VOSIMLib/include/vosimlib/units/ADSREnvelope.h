@@ -75,6 +75,7 @@ namespace syn {
         double m_atkTime, m_atkBias, m_atkFb;
         double m_decTime, m_decBias, m_decFb;
         double m_relTime, m_relBias, m_relFb;
+        double m_retrigBias, m_retrigFb; ///< fast fade out per control tick, before retriggering
         double m_targetRatioUp, m_targetRatioDown;
         bool m_legato;
 
@@ -57,7 +57,8 @@ namespace syn {
         void reset() override;
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
+        bool isSilent_() override;
         void onNoteOn_() override;
 
     private:
@@ -79,7 +80,7 @@ namespace syn {
         void reset() override {};
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
 
     private:
         int m_pRectType;
@@ -98,7 +99,7 @@ namespace syn {
         void reset() override {};
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
     private:
         int m_pBias;
     };
@@ -116,7 +117,7 @@ namespace syn {
         void reset() override {};
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
     private:
         int m_pGain;
     };
@@ -134,7 +135,7 @@ namespace syn {
         void reset() override {};
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
     };
 
     /**
@@ -150,7 +151,7 @@ namespace syn {
         void reset() override {};
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
 
     protected:
         int m_pBalance1, m_pBalance2;
@@ -169,7 +170,7 @@ namespace syn {
         void reset() override {};
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
 
     private:
         int m_pMinInput, m_pMaxInput;
@@ -187,6 +188,7 @@ namespace syn {
             : Unit(a_name) {
             addInput_("in");
             addOutput_("out");
+            enableBlockProcessing_();
         }
 
         PitchToFreqUnit(const PitchToFreqUnit& a_rhs)
@@ -196,10 +198,11 @@ namespace syn {
         void reset() override {};
 
     protected:
-        void process_() override {
-            BEGIN_PROC_FUNC
-            WRITE_OUTPUT(0, pitchToFreq(READ_INPUT(0)));
-            END_PROC_FUNC
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override {
+            const Sample* in = a_inputs[0];
+            Sample* out = a_outputs[0];
+            for (int i = 0; i < a_numSamples; i++)
+                out[i] = pitchToFreq(in[i]);
         }
     };
 
@@ -213,6 +216,7 @@ namespace syn {
             : Unit(a_name) {
             addInput_("in");
             addOutput_("out");
+            enableBlockProcessing_();
         }
 
         FreqToPitchUnit(const FreqToPitchUnit& a_rhs)
@@ -222,10 +226,12 @@ namespace syn {
         void reset() override {};
 
     protected:
-        void process_() override {
-            BEGIN_PROC_FUNC
-            WRITE_OUTPUT(0, samplesToPitch(freqToSamples(READ_INPUT(0), fs()), fs()));
-            END_PROC_FUNC
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override {
+            const Sample* in = a_inputs[0];
+            Sample* out = a_outputs[0];
+            const double sampleRate = fs();
+            for (int i = 0; i < a_numSamples; i++)
+                out[i] = samplesToPitch(freqToSamples(in[i], sampleRate), sampleRate);
         }
     };
 
@@ -244,6 +250,7 @@ namespace syn {
             addInput_("cmp");
             addOutput_(">");
             addOutput_("<=");
+            enableBlockProcessing_();
         }
 
         SwitchUnit(const SwitchUnit& a_rhs)
@@ -253,13 +260,15 @@ namespace syn {
         void reset() override {};
 
     protected:
-        void process_() override {
-            BEGIN_PROC_FUNC
-            double in = READ_INPUT(0);
-            double comp = READ_INPUT(1);
-            WRITE_OUTPUT(0, in > comp ? 1 : 0);
-            WRITE_OUTPUT(1, in <= comp ? 1 : 0);
-            END_PROC_FUNC
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override {
+            const Sample* in = a_inputs[0];
+            const Sample* comp = a_inputs[1];
+            Sample* greater = a_outputs[0];
+            Sample* lessEqual = a_outputs[1];
+            for (int i = 0; i < a_numSamples; i++) {
+                greater[i] = in[i] > comp[i] ? 1 : 0;
+                lessEqual[i] = in[i] <= comp[i] ? 1 : 0;
+            }
         }
     };
 
@@ -293,7 +302,7 @@ namespace syn {
         void reset() override {};
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
     };
 
     /**
@@ -311,6 +320,6 @@ namespace syn {
 
         void reset() override {};
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
     };
 }
\ No newline at end of file
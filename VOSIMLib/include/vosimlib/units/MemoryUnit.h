@@ -54,7 +54,7 @@ namespace syn {
         void reset();
         int size() const;
     private:
-        vector<double> m_buffer;
+        PoolVector<double> m_buffer;
         int m_arraySize;
         double m_delaySamples;
         int m_curWritePhase;
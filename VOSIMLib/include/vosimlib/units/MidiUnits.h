@@ -21,6 +21,8 @@ namespace syn {
             addOutput_(oPitch, "pitch");
             addOutput_(oFreq, "freq");
             addOutput_(oPitchWheel, "bend");
+            enableControlRate_(HoldControl);
+            setControlInterpolation_(oPitchWheel, LerpControl);
         }
 
         MidiNoteUnit(const MidiNoteUnit& a_rhs) :
@@ -45,6 +47,7 @@ namespace syn {
         explicit VelocityUnit(const string& a_name) :
             Unit(a_name) {
             addOutput_("out");
+            enableControlRate_(HoldControl);
         }
 
         VelocityUnit(const VelocityUnit& a_rhs) :
@@ -110,6 +113,7 @@ namespace syn {
             m_pLearn(addParameter_(UnitParameter("learn", false))),
             m_value(0) {
             addOutput_("out");
+            enableControlRate_();
         }
 
         MidiCCUnit(const MidiCCUnit& a_rhs)
@@ -140,6 +144,7 @@ namespace syn {
         explicit VoiceIndexUnit(const string& a_name) :
             Unit(a_name) {
             addOutput_("out");
+            enableControlRate_(HoldControl);
         }
 
         void reset() override {};
@@ -32,6 +32,13 @@ namespace syn
         };
 
         const vector<string> wave_shape_names{ "Saw", "Sine", "Tri", "Square" };
+
+        enum WaveQuality {
+            MIPMAP_QUALITY = 0,
+            SINC_QUALITY ///< reference quality, much slower
+        };
+
+        const vector<string> wave_quality_names{ "Mipmap", "Sinc" };
     }
 
     class VOSIMLIB_API OscillatorUnit : public Unit
@@ -65,8 +72,12 @@ namespace syn
         void reset() override;
 
     protected:
-        void process_() override;
-        virtual void tickPhase_(double a_phaseOffset) ;
+        /**
+         * Advance the oscillator by one sample, reading the inputs shared by all oscillators at \p a_offset of
+         * the spans given to Unit::processBlock_, and writing the phase output.
+         */
+        virtual void tickOscillator_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_offset);
+        virtual void tickPhase_(double a_phaseOffset, double a_sync) ;
         virtual void updatePhaseStep_() ;
 
     protected:
@@ -101,7 +112,7 @@ namespace syn
         explicit TunedOscillatorUnit(const TunedOscillatorUnit& a_rhs);
 
     protected:
-        void process_() override ;
+        void tickOscillator_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_offset) override;
         void updatePhaseStep_() override ;
         void onNoteOn_() override;
     protected:
@@ -115,6 +126,7 @@ namespace syn
         enum Param
         {
             pWaveform = TunedOscillatorUnit::NUM_PARAMS,
+            pQuality,
             NUM_PARAMS
         };
         explicit BasicOscillatorUnit(const string& a_name);
@@ -122,7 +134,7 @@ namespace syn
         explicit BasicOscillatorUnit(const BasicOscillatorUnit& a_rhs);
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
     };
 
     class VOSIMLIB_API LFOOscillatorUnit : public OscillatorUnit
@@ -157,7 +169,7 @@ namespace syn
         explicit LFOOscillatorUnit(const LFOOscillatorUnit& a_rhs) : LFOOscillatorUnit(a_rhs.name()) {}
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
         void onParamChange_(int a_paramId) override;
     };
 }
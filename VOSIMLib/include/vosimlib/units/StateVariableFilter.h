@@ -67,7 +67,9 @@ namespace syn
 
     protected:
 
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
+        void processLanes_(Unit* const* a_lanes, int a_numLanes) override;
+        bool isSilent_() override;
         void onNoteOn_() override;
 
         double m_prevBPOut, m_prevLPOut;
@@ -88,7 +90,9 @@ namespace syn
 
         void reset() override;
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
+        void processLanes_(Unit* const* a_lanes, int a_numLanes) override;
+        bool isSilent_() override;
 
     protected:
         double m_prevInput;
@@ -154,7 +158,8 @@ namespace syn
         void reset() override;;
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
+        bool isSilent_() override;
         void onFsChange_() override;
     private:
         OnePoleLP implem;
@@ -196,12 +201,14 @@ namespace syn
         LadderFilterA(const LadderFilterA& a_rhs) : LadderFilterA(a_rhs.name()) {};
         void reset() override;
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
+        bool isSilent_() override;
     protected:
         const double VT = 0.312;
         std::array<double, 4> m_V;
         std::array<double, 4> m_dV;
         std::array<double, 4> m_tV;
+        double m_g; ///< stage gain, refreshed on control ticks
     };
 
     class VOSIMLIB_API LadderFilterB : public LadderFilterBase
@@ -212,7 +219,8 @@ namespace syn
         LadderFilterB(const LadderFilterB& a_rhs) : LadderFilterB(a_rhs.name()) {};
         void reset() override;
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
+        bool isSilent_() override;
         void onFsChange_() override;
     protected:
         OnePoleLP m_LP[4];
@@ -48,7 +48,7 @@ namespace syn
         VosimOscillator(const VosimOscillator& a_rhs);
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
         void updatePhaseStep_() override;
 
     private:
@@ -82,7 +82,7 @@ namespace syn
         FormantOscillator(const FormantOscillator& a_rhs);
 
     protected:
-        void process_() override;
+        void processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) override;
     };
 }
 #endif
@@ -126,9 +126,10 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
         .def("tick", [](syn::Unit& self, const MatrixXdR& a_inputs) {
                 if (a_inputs.rows() > self.numInputs())
                     throw std::runtime_error("Input buffer should have at most " + std::to_string(self.numOutputs()) + " rows.");
-                ArrayXXdR outputs(self.numOutputs(), a_inputs.cols());
-                self.tick(a_inputs, outputs);
-                return outputs;
+                syn::Unit::dynamic_buffer_t inputs = a_inputs.cast<syn::Sample>();
+                syn::Unit::dynamic_buffer_t outputs(self.numOutputs(), a_inputs.cols());
+                self.tick(inputs, outputs);
+                return ArrayXXdR(outputs.cast<double>());
             },
             py::return_value_policy::copy)
         .def("reset", &syn::Unit::reset)
@@ -137,6 +138,7 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
         .def_property("fs", &syn::Unit::fs, &syn::Unit::setFs)
         .def_property("tempo", &syn::Unit::tempo, &syn::Unit::setTempo)
         .def_property("bufSize", &syn::Unit::getBufferSize, &syn::Unit::setBufferSize)
+        .def_property("controlPeriod", &syn::Unit::getControlPeriod, &syn::Unit::setControlPeriod)
 
         .def_property_readonly("note", &syn::Unit::note)
         .def_property_readonly("isNoteOn", &syn::Unit::isNoteOn)
@@ -181,6 +183,9 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
                 Eigen::Matrix<double, -1, -1, Eigen::RowMajor> outputs(self.numOutputs(), self.getBufferSize());
                 for (int i = 0; i < self.numOutputs(); i++) {
                     int item_id = nc_outputs.ids()[i];
+                    // Within a circuit, a later unit may have reused the buffer
+                    if (nc_outputs[item_id].isOverwritten())
+                        throw std::runtime_error("Output " + std::to_string(item_id) + " of " + self.name() + " shares its buffer with later units. Call Circuit.observe on it first.");
                     for (int j = 0; j < self.getBufferSize(); j++) {
                         outputs(i, j) = self.readOutput(item_id, j);
                     }
@@ -205,7 +210,10 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
             .def("disconnect", (bool (syn::Circuit::*)(int, int, int, int))&syn::Circuit::disconnectInternal)
             .def("disconnect", (bool (syn::Circuit::*)(int, int, int, int))&syn::Circuit::disconnectInternal)
 
-            .def("conns", &syn::Circuit::getConnectionsToInternalInput, "Get all connections to an internal input.");
+            .def("conns", &syn::Circuit::getConnectionsToInternalInput, "Get all connections to an internal input.")
+
+            .def("observe", &syn::Circuit::setOutputObserved, "Keep the output buffer of an internal unit readable after each tick.",
+                 py::arg("unit_id"), py::arg("output_id"), py::arg("observe") = true);
 
     py::class_<syn::StateVariableFilter, PyUnit<syn::StateVariableFilter>> svf(m, "SVF", unit);
     svf.def(py::init<const std::string&>(), "State variable filter");
@@ -320,6 +328,13 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
                     };
                     return py::vectorize(closure)(a_phase, a_period);
                })
+           .def("get_mipmapped", [](syn::ResampledTable& a_self, py::array_t<double> a_phase, py::array_t<double> a_period) {
+                    auto closure = [&a_self](double phase, double period)
+                    {
+                        return a_self.getMipmapped(phase, period);
+                    };
+                    return py::vectorize(closure)(a_phase, a_period);
+               })
            .def_property_readonly("size", [](const syn::ResampledTable& a_self) { return a_self.m_size; })
            .def_property_readonly("resampled_tables", [](const syn::ResampledTable& a_self) { return a_self.resampledTables(); });
 
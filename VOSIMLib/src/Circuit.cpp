@@ -26,13 +26,21 @@ namespace syn
 {
     Circuit::Circuit(const string& a_name) :
         Unit(a_name),
-        m_voiceIndex(0.0)
+        m_voiceIndex(0.0),
+        m_editDepth(0),
+        m_graphDirty(false),
+        m_workerPool(nullptr),
+        m_parallelWorkThreshold(DEFAULT_PARALLEL_WORK_THRESHOLD),
+        m_memoryPool(MemoryPool::current()),
+        m_numActiveUnits(0)
     {        
         m_execOrder.fill(nullptr);
         InputUnit* inputUnit = new InputUnit("inputs");
         OutputUnit* outputUnit = new OutputUnit("outputs");
         m_units.add(inputUnit);
         m_units.add(outputUnit);
+        inputUnit->_setParent(this);
+        outputUnit->_setParent(this);
         m_inputUnit = inputUnit;
         m_outputUnit = outputUnit;
         addExternalInput_("left in");
@@ -44,6 +52,10 @@ namespace syn
     Circuit::Circuit(const Circuit& a_other) :
         Circuit(a_other.name())
     {
+        beginEdit();
+        setWorkerPool(a_other.m_workerPool);
+        setParallelWorkThreshold(a_other.m_parallelWorkThreshold);
+        MemoryPool::Scope scope(m_memoryPool);
         const int* unitIndices = a_other.m_units.ids();
         for (int i = 0; i < a_other.m_units.size(); i++)
         {
@@ -56,12 +68,16 @@ namespace syn
             connectInternal(rec.from_id, rec.from_port, rec.to_id, rec.to_port);
         }
         copyFrom_(a_other);
+        endEdit();
     }
 
     Circuit& Circuit::operator=(const Circuit& a_other)
     {
         if (this != &a_other)
         {
+            beginEdit();
+            setWorkerPool(a_other.m_workerPool);
+            setParallelWorkThreshold(a_other.m_parallelWorkThreshold);
             // delete old units
             const int* unitIndices = m_units.ids();
             for (int i = 0; i < m_units.size();)
@@ -73,6 +89,7 @@ namespace syn
                     i++;
             }
             // copy new units
+            MemoryPool::Scope scope(m_memoryPool);
             const int* otherUnitIndices = a_other.m_units.ids();
             for (int i = 0; i < a_other.m_units.size(); i++)
             {
@@ -85,6 +102,7 @@ namespace syn
                 connectInternal(rec.from_id, rec.from_port, rec.to_id, rec.to_port);
             }
             copyFrom_(a_other);
+            endEdit();
         }
         return *this;
     }
@@ -104,6 +122,7 @@ namespace syn
             if (m_connectionRecords[i] == record) {
                 result = true;
                 m_connectionRecords.erase(m_connectionRecords.begin() + i);
+                m_procGraph.disconnect(fromUnit, toUnit);
                 _recomputeGraph();
                 break;
             }
@@ -138,6 +157,7 @@ namespace syn
         Unit* outputUnit = m_outputUnit;
         int inputUnitIndex = m_units.getIdFromItem(inputUnit);
         int outputUnitIndex = m_units.getIdFromItem(outputUnit);
+        beginEdit();
         /* Load units */
         for (json::iterator it = units.begin(); it != units.end(); ++it)
         {
@@ -147,11 +167,15 @@ namespace syn
             const json unitJson = j["units"][it.key()];
             Unit* unit = Unit::fromJSON(unitJson);
             // Abort load if unable to create unit.
-            if (!unit)
+            if (!unit) {
+                endEdit();
                 return nullptr;
+            }
             bool success = addUnit(unit, id);
-            if (!success)
+            if (!success) {
+                endEdit();
                 return nullptr;
+            }
         }
 
         /* Load connection records */
@@ -167,9 +191,12 @@ namespace syn
             cr.to_id = cr_j["to"][0];
             bool success = connectInternal(cr.from_id, cr.from_port, cr.to_id, cr.to_port);
             // Abort load if not able to create connection.
-            if (!success)
+            if (!success) {
+                endEdit();
                 return nullptr;
+            }
         }
+        endEdit();
         return this;
     }
 
@@ -177,23 +204,134 @@ namespace syn
     {
         const int* unitIndices = m_units.ids();
         for (int i = 0; i < m_units.size(); i++) { m_units[unitIndices[i]]->reset(); }
+        updateActivity_();
     }
 
     void Circuit::process_()
     {
+        _beginProcess();
+
         // tick units in processing graph
-        for (Unit** unit = m_execOrder.data(); *unit != nullptr; unit++)
+        if (m_workerPool)
         {
-            (*unit)->tick();
+            const int numSteps = int(m_stepStarts.size()) - 1;
+            for (int step = 0; step < numSteps; step++)
+            {
+                ProcRecord* records = m_procPlan.data() + m_stepStarts[step];
+                const int numUnits = m_stepStarts[step + 1] - m_stepStarts[step];
+                if (numUnits > 1 && numUnits * getNumSamples() >= m_parallelWorkThreshold)
+                {
+                    auto processUnit = [records](int i) { records[i].unit->_process(); };
+                    m_workerPool->parallelFor(numUnits, processUnit);
+                }
+                else
+                {
+                    for (int i = 0; i < numUnits; i++)
+                        records[i].unit->_process();
+                }
+            }
+        }
+        else
+        {
+            for (ProcRecord& record : m_procPlan)
+            {
+                record.unit->_process();
+            }
         }
 
+        _pushOutputs();
+        // Let the parent circuit (if any) know that the last active unit went quiet
+        updateActivity_();
+    }
+
+    void Circuit::_beginProcess()
+    {
+        // The circuit's own inputs may be rebound between ticks, so the input unit is always re-resolved
+        m_inputUnit->_resolveProcRecord(*m_inputUnit->m_procRecord);
+
+        const int numSamples = getNumSamples();
+        for (ProcRecord& record : m_procPlan) {
+            record.unit->m_numSamples = numSamples;
+            record.unit->_syncParameters();
+            record.unit->_captureParameters();
+        }
+    }
+
+    void Circuit::_pushOutputs()
+    {
         /* Push internally connected output signals to circuit output ports */
+        const int numSamples = getNumSamples();
         for (int i = 0; i < m_outputPorts.size(); i++)
         {
-            for (int j = 0; j < getBufferSize(); j++)
+            int id = m_outputPorts.ids()[i];
+            const OutputPort& port = m_outputUnit->m_outputPorts[id];
+            std::copy(port.buf(), port.buf() + numSamples, m_procRecord->outputs[id]);
+            *m_procRecord->outputTags[id] = *port.tag();
+        }
+    }
+
+    bool Circuit::isLaneCompatible(const Circuit& a_other) const
+    {
+        if (m_procPlan.size() != a_other.m_procPlan.size() || getBufferSize() != a_other.getBufferSize())
+            return false;
+        for (int i = 0; i < m_procPlan.size(); i++)
+        {
+            const string& className = m_procPlan[i].unit->getClassName();
+            const string& otherClassName = a_other.m_procPlan[i].unit->getClassName();
+            if (&className != &otherClassName && className != otherClassName)
+                return false;
+        }
+        return true;
+    }
+
+    void Circuit::tickLanes(Circuit* const* a_circuits, int a_numCircuits, int a_numSamples)
+    {
+        if (a_numCircuits == 1)
+        {
+            a_circuits[0]->tick(a_numSamples);
+            return;
+        }
+
+        for (int i = 0; i < a_numCircuits; i++)
+        {
+            Circuit* circuit = a_circuits[i];
+            circuit->m_numSamples = a_numSamples;
+            circuit->_resolveProcRecord(circuit->m_localProcRecord);
+            circuit->m_procRecord = &circuit->m_localProcRecord;
+            circuit->_beginProcess();
+        }
+
+        Unit* lanes[SYN_LANES];
+        const int planSize = int(a_circuits[0]->m_procPlan.size());
+        for (int step = 0; step < planSize; step++)
+        {
+            if (a_circuits[0]->m_procPlan[step].unit->m_useControlRate)
+            {
+                // Control rate units are cheap enough as is, and keep their own control tick timing
+                for (int i = 0; i < a_numCircuits; i++)
+                    a_circuits[i]->m_procPlan[step].unit->_process();
+                continue;
+            }
+            // Silent lanes are skipped, and the others are processed together
+            int numLanes = 0;
+            for (int i = 0; i < a_numCircuits; i++)
             {
-                writeOutput_(i, j, m_outputUnit->readOutput(i, j));
+                Unit* unit = a_circuits[i]->m_procPlan[step].unit;
+                if (!unit->_skipSilence())
+                    lanes[numLanes++] = unit;
             }
+            if (numLanes == 1)
+                lanes[0]->process_();
+            else if (numLanes > 1)
+                lanes[0]->processLanes_(lanes, numLanes);
+            for (int i = 0; i < a_numCircuits; i++)
+                a_circuits[i]->m_procPlan[step].unit->_captureOutputs();
+        }
+
+        for (int i = 0; i < a_numCircuits; i++)
+        {
+            a_circuits[i]->_pushOutputs();
+            a_circuits[i]->updateActivity_();
         }
     }
 
@@ -213,10 +351,10 @@ namespace syn
         a_unit->setFs(fs());
         a_unit->setTempo(tempo());
         a_unit->setBufferSize(getBufferSize());
+        a_unit->setControlPeriod(getControlPeriod());
         a_unit->m_midiData = m_midiData;
-        for (const auto& param : a_unit->m_parameters)
-            a_unit->notifyParameterChanged(param.getId());
-        _recomputeGraph();
+        a_unit->_notifyAllParameters();
+        // The unit is not scheduled until it is connected, so the execution order is unaffected
         return true;
     }
 
@@ -233,6 +371,7 @@ namespace syn
         // Don't allow deletion of input or output unit
         if (unit == m_inputUnit || unit == m_outputUnit)
             return false;
+        beginEdit();
         // Erase connections
         vector<ConnectionRecord> garbageList;
         for (const auto& rec : m_connectionRecords) {
@@ -243,7 +382,7 @@ namespace syn
         }
         m_units.removeById(a_id);
         delete unit;
-        _recomputeGraph();
+        endEdit();
         return true;
     }
 
@@ -264,6 +403,7 @@ namespace syn
             for (int i = 0; i < nRecords; i++) {
                 const ConnectionRecord& rec = m_connectionRecords[i];
                 if (rec.to_id == a_toId && rec.to_port == a_toInputPort) {
+                    m_procGraph.disconnect(m_units[rec.from_id], toUnit);
                     m_connectionRecords.erase(m_connectionRecords.begin() + i);
                     break;
                 }
@@ -275,6 +415,7 @@ namespace syn
 
         // record the connection upon success
         m_connectionRecords.emplace_back(a_fromId, a_fromOutputPort, a_toId, a_toInputPort);
+        m_procGraph.connect(fromUnit, toUnit);
         _recomputeGraph();
         return true;
     }
@@ -290,32 +431,221 @@ namespace syn
     bool Circuit::disconnectInternal(const Unit& a_fromUnit, int a_fromOutputPort, const Unit& a_toUnit, int a_toInputPort) {
         const Unit* toUnitPtr = &a_toUnit;
         const Unit* fromUnitPtr = &a_fromUnit;
-        int fromId = m_units.getIdFromItem(toUnitPtr);
-        int toId = m_units.getIdFromItem(fromUnitPtr);
+        int fromId = m_units.getIdFromItem(fromUnitPtr);
+        int toId = m_units.getIdFromItem(toUnitPtr);
         return disconnectInternal(fromId, a_fromOutputPort, toId, a_toInputPort);
     }
 
     const vector<ConnectionRecord>& Circuit::getConnections() const { return m_connectionRecords; }
 
+    void Circuit::updateParameters()
+    {
+        Unit::updateParameters();
+        for (int i = 0; i < m_units.size(); i++)
+            m_units.getByIndex(i)->updateParameters();
+    }
+
+    void Circuit::shareParameters(const Unit& a_other)
+    {
+        Unit::shareParameters(a_other);
+        const Circuit* other = dynamic_cast<const Circuit*>(&a_other);
+        if (!other)
+            return;
+        for (int i = 0; i < m_units.size(); i++)
+        {
+            int id = m_units.ids()[i];
+            Unit* unit = m_units[id];
+            if (unit == m_inputUnit || unit == m_outputUnit || !other->m_units.containsId(id))
+                continue;
+            const Unit& otherUnit = *other->m_units[id];
+            if (otherUnit.getClassName() == unit->getClassName())
+                unit->shareParameters(otherUnit);
+        }
+    }
+
+    void Circuit::beginEdit() { m_editDepth++; }
+
+    void Circuit::endEdit()
+    {
+        if (m_editDepth == 0)
+            return;
+        m_editDepth--;
+        if (m_editDepth == 0 && m_graphDirty)
+            _recomputeGraph();
+    }
+
     void Circuit::_recomputeGraph()
     {
-        m_procGraph.reset();
-        m_execOrder.fill(nullptr);
-        for(const auto& cr : m_connectionRecords) {
-            m_procGraph.connect(m_units[cr.from_id], m_units[cr.to_id]);
+        if (m_editDepth > 0) {
+            m_graphDirty = true;
+            return;
         }
+        m_graphDirty = false;
+        m_execOrder.fill(nullptr);
         auto execOrder = m_procGraph.linearize();
+        if (m_workerPool)
+        {
+            // Layers only depend on layers further from the outputs, so process those first
+            std::stable_sort(execOrder.begin(), execOrder.end(), [](auto&& a, auto&& b) { return a.second.layer > b.second.layer; });
+        }
         std::transform(execOrder.begin(), execOrder.end(), m_execOrder.begin(), [](auto&& p) { return p.first; });
+
+        // Each unit is its own step when processing serially, otherwise each layer is a step
+        m_stepStarts.clear();
+        for (int i = 0; i < execOrder.size(); i++)
+        {
+            if (!m_workerPool || i == 0 || execOrder[i].second.layer != execOrder[i - 1].second.layer)
+                m_stepStarts.push_back(i);
+        }
+        m_stepStarts.push_back(int(execOrder.size()));
+        _compileProcPlan();
+    }
+
+    void Circuit::setWorkerPool(WorkerPool* a_pool)
+    {
+        if (a_pool == m_workerPool)
+            return;
+        m_workerPool = a_pool;
+        _recomputeGraph();
+    }
+
+    void Circuit::_compileProcPlan()
+    {
+        // Unscheduled units fall back to resolving their own record when ticked
+        for (int i = 0; i < m_units.size(); i++)
+        {
+            Unit* unit = m_units.getByIndex(i);
+            unit->m_procRecord = &unit->m_localProcRecord;
+        }
+
+        _assignInternalBuffers();
+
+        int numScheduled = 0;
+        while (m_execOrder[numScheduled])
+            numScheduled++;
+
+        m_procPlan.resize(numScheduled);
+        for (int i = 0; i < numScheduled; i++)
+        {
+            Unit* unit = m_execOrder[i];
+            unit->_resolveProcRecord(m_procPlan[i]);
+            unit->m_procRecord = &m_procPlan[i];
+        }
+        _countActiveUnits();
+    }
+
+    void Circuit::_countActiveUnits()
+    {
+        int numActiveUnits = 0;
+        for (ProcRecord& record : m_procPlan)
+        {
+            record.unit->m_isActive = record.unit->isActive();
+            numActiveUnits += record.unit->m_isActive;
+        }
+        m_numActiveUnits.store(numActiveUnits, std::memory_order_relaxed);
+        updateActivity_();
     }
 
-    bool Circuit::isActive() const {
-        for (Unit* const* unit = m_execOrder.data(); *unit != nullptr; unit++) {
-            if ((*unit)->isActive())
-                return true;
+    void Circuit::_assignInternalBuffers()
+    {
+        struct Lifetime
+        {
+            OutputPort* port;
+            int start;
+            int end;
+            bool pinned;
+        };
+
+        for (int i = 0; i < m_units.size(); i++)
+        {
+            for (auto& output : m_units.getByIndex(i)->m_outputPorts)
+            {
+                output.unsetBuf();
+                output.setOverwritten(false);
+            }
+        }
+
+        std::unordered_map<const Unit*, int> steps;
+        const int numSteps = int(m_stepStarts.size()) - 1;
+        for (int step = 0; step < numSteps; step++)
+        {
+            for (int pos = m_stepStarts[step]; pos < m_stepStarts[step + 1]; pos++)
+                steps[m_execOrder[pos]] = step;
+        }
+
+        // Every output of a scheduled unit lives at least for the duration of its own step
+        std::unordered_map<const OutputPort*, int> lifetimeIndices;
+        vector<Lifetime> lifetimes;
+        for (int pos = 0; m_execOrder[pos]; pos++)
+        {
+            Unit* unit = m_execOrder[pos];
+            int step = steps[unit];
+            bool isOutputUnit = unit == m_outputUnit;
+            for (auto& output : unit->m_outputPorts)
+            {
+                lifetimeIndices[&output] = int(lifetimes.size());
+                // The output unit's buffers are read after all units have been ticked
+                lifetimes.push_back({&output, step, isOutputUnit ? numSteps : step, output.isObserved()});
+            }
+        }
+
+        // Extend each lifetime to its last reader. Connections between units that do not reach the outputs
+        // (and are thus not scheduled) are never processed.
+        for (const auto& rec : m_connectionRecords)
+        {
+            Unit* fromUnit = m_units[rec.from_id];
+            Unit* toUnit = m_units[rec.to_id];
+            auto lifetimeIndex = lifetimeIndices.find(&fromUnit->m_outputPorts[rec.from_port]);
+            auto readStepIt = steps.find(toUnit);
+            if (lifetimeIndex == lifetimeIndices.end() || readStepIt == steps.end())
+                continue;
+            Lifetime& lifetime = lifetimes[lifetimeIndex->second];
+            int readStep = readStepIt->second;
+            if (readStep <= lifetime.start)
+                lifetime.pinned = true;
+            else
+                lifetime.end = MAX(lifetime.end, readStep);
+        }
+
+        // Greedily assign lifetimes (sorted by start step) to the first free buffer
+        vector<int> busyUntil;
+        vector<OutputPort*> lastPorts;
+        for (const Lifetime& lifetime : lifetimes)
+        {
+            if (lifetime.pinned)
+                continue;
+            int slab = 0;
+            while (slab < busyUntil.size() && busyUntil[slab] >= lifetime.start)
+                slab++;
+            if (slab == busyUntil.size())
+            {
+                busyUntil.push_back(lifetime.end);
+                lastPorts.push_back(lifetime.port);
+            }
+            else
+            {
+                busyUntil[slab] = lifetime.end;
+                lastPorts[slab]->setOverwritten(true);
+                lastPorts[slab] = lifetime.port;
+            }
+            if (slab >= m_internalBuffers.size())
+                m_internalBuffers.emplace_back(getBufferSize(), 0.0, PoolAllocator<Sample>(m_memoryPool));
+            lifetime.port->setBuf(m_internalBuffers[slab].data());
         }
-        return false;
+        m_internalBuffers.resize(busyUntil.size());
+    }
+
+    bool Circuit::setOutputObserved(int a_unitId, int a_outputId, bool a_isObserved)
+    {
+        if (!m_units.containsId(a_unitId) || !m_units[a_unitId]->hasOutput(a_outputId))
+            return false;
+        m_units[a_unitId]->m_outputPorts[a_outputId].setObserved(a_isObserved);
+        _recomputeGraph();
+        return true;
     }
 
+    bool Circuit::isActive() const { return m_numActiveUnits.load(std::memory_order_relaxed) > 0; }
+
     void Circuit::setVoiceIndex(double a_newVoiceIndex) { m_voiceIndex = a_newVoiceIndex; }
 
     double Circuit::getVoiceIndex() const { return m_voiceIndex; }
@@ -332,6 +662,12 @@ namespace syn
         for (int i = 0; i < m_units.size(); i++) { m_units[unitIndices[i]]->setTempo(tempo()); }
     }
 
+    void Circuit::onControlPeriodChange_()
+    {
+        const int* unitIndices = m_units.ids();
+        for (int i = 0; i < m_units.size(); i++) { m_units[unitIndices[i]]->setControlPeriod(getControlPeriod()); }
+    }
+
     void Circuit::onNoteOn_()
     {
         const int* unitIndices = m_units.ids();
@@ -403,6 +739,10 @@ namespace syn
         {
             m_units[unitIndices[i]]->setBufferSize(a_bufferSize);
         }
+        if (m_editDepth > 0)
+            m_graphDirty = true;
+        else
+            _compileProcPlan();
     }
 
     vector<std::pair<int, int>> Circuit::getConnectionsToInternalInput(int a_unitId, int a_inputId) const
@@ -0,0 +1,71 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "vosimlib/CommandQueue.h"
+
+namespace syn
+{
+    CommandQueue::CommandQueue(int a_capacity) :
+        m_slots(a_capacity),
+        m_pending(a_capacity),
+        m_completed(a_capacity)
+    {
+        m_freeSlots.reserve(a_capacity);
+        for (int i = a_capacity - 1; i >= 0; i--)
+            m_freeSlots.push_back(i);
+    }
+
+    CommandQueue::~CommandQueue()
+    {
+        int slotIndex;
+        while (m_pending.pop(slotIndex))
+            m_slots[slotIndex].destroy(&m_slots[slotIndex].storage);
+        while (m_completed.pop(slotIndex))
+            m_slots[slotIndex].destroy(&m_slots[slotIndex].storage);
+    }
+
+    int CommandQueue::process(int a_maxCommands)
+    {
+        int numProcessed = 0;
+        int slotIndex;
+        while (numProcessed < a_maxCommands && m_pending.pop(slotIndex))
+        {
+            Slot& slot = m_slots[slotIndex];
+            slot.invoke(&slot.storage);
+            m_completed.push(slotIndex);
+            numProcessed++;
+        }
+        return numProcessed;
+    }
+
+    void CommandQueue::collect()
+    {
+        int slotIndex;
+        while (m_completed.pop(slotIndex))
+        {
+            m_slots[slotIndex].destroy(&m_slots[slotIndex].storage);
+            m_freeSlots.push_back(slotIndex);
+        }
+    }
+
+    bool CommandQueue::isDrained()
+    {
+        collect();
+        return m_freeSlots.size() == m_slots.size();
+    }
+}
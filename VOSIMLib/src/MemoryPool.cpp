@@ -1,105 +1,435 @@
 #include "vosimlib/MemoryPool.h"
+#include <boost/align/aligned_alloc.hpp>
+#include <new>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
-syn::MemoryPool::Chunk::~Chunk() {
-    if (next)
-        next->prev = prev;
-    if (prev)
-        prev->next = next;
-}
+namespace
+{
+    int findFirstSet(uint32_t a_word)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        return _BitScanForward(&index, a_word) ? static_cast<int>(index) : -1;
+#else
+        return a_word ? __builtin_ctz(a_word) : -1;
+#endif
+    }
 
-bool syn::MemoryPool::ChunkSortBySize::operator()(const Chunk& a_lhs, const Chunk& a_rhs) const {
-    return a_lhs.size < a_rhs.size;
-}
+    int findLastSet(size_t a_word)
+    {
+#if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        return _BitScanReverse64(&index, a_word) ? static_cast<int>(index) : -1;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        return _BitScanReverse(&index, a_word) ? static_cast<int>(index) : -1;
+#else
+        return a_word ? static_cast<int>(sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(a_word)) : -1;
+#endif
+    }
+
+    size_t alignUp(size_t a_value, size_t a_alignment) { return (a_value + a_alignment - 1) & ~(a_alignment - 1); }
+
+    const size_t c_hugePageSize = size_t(2) << 20;
+
+    thread_local syn::MemoryPool* t_currentPool = nullptr;
 
-bool syn::MemoryPool::ChunkSortByAddr::operator()(const Chunk& a_lhs, const Chunk& a_rhs) const {
-    return a_lhs.addr < a_rhs.addr;
+    /**
+     * Map \p a_numBytes bytes of fresh pages, rounded up to whole (huge) pages.
+     * \returns nullptr if the pages could not be mapped.
+     */
+    void* mapPages(size_t& a_numBytes, bool a_useHugePages, syn::MemoryPool::Backing& a_backing)
+    {
+#if defined(_WIN32)
+        if (a_useHugePages) {
+            const size_t largePageSize = GetLargePageMinimum();
+            if (largePageSize) {
+                const size_t numBytes = alignUp(a_numBytes, largePageSize);
+                // Fails unless the user holds the "lock pages in memory" privilege
+                void* ptr = VirtualAlloc(nullptr, numBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+                if (ptr) {
+                    a_numBytes = numBytes;
+                    a_backing = syn::MemoryPool::HugePageBacking;
+                    return ptr;
+                }
+            }
+        }
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        a_numBytes = alignUp(a_numBytes, info.dwPageSize);
+        a_backing = syn::MemoryPool::PageBacking;
+        return VirtualAlloc(nullptr, a_numBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#if defined(MAP_HUGETLB)
+        if (a_useHugePages) {
+            const size_t numBytes = alignUp(a_numBytes, c_hugePageSize);
+            void* ptr = mmap(nullptr, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (ptr != MAP_FAILED) {
+                a_numBytes = numBytes;
+                a_backing = syn::MemoryPool::HugePageBacking;
+                return ptr;
+            }
+        }
+#endif
+        // Without reserved huge pages, ask for transparent ones
+        a_numBytes = alignUp(a_numBytes, a_useHugePages ? c_hugePageSize : static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+        void* ptr = mmap(nullptr, a_numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            return nullptr;
+#if defined(MADV_HUGEPAGE)
+        if (a_useHugePages)
+            madvise(ptr, a_numBytes, MADV_HUGEPAGE);
+#endif
+        a_backing = syn::MemoryPool::PageBacking;
+        return ptr;
+#endif
+    }
+
+    void unmapPages(void* a_ptr, size_t a_numBytes)
+    {
+#if defined(_WIN32)
+        VirtualFree(a_ptr, 0, MEM_RELEASE);
+#else
+        munmap(a_ptr, a_numBytes);
+#endif
+    }
 }
 
-syn::MemoryPool::MemoryPool(size_t a_numBytes):
-    m_head{0, nullptr, false, nullptr, nullptr},
-    m_bytesUsed(0)
+namespace syn
 {
-    m_bytes.resize(a_numBytes);
-    Chunk* freechunk = new Chunk{a_numBytes, &m_bytes[0], true, nullptr, &m_head};
-    m_head.next = freechunk;
-    m_freeChunks.push_back(freechunk);
-}
+    /**
+     * Every block starts with this header, and its payload follows right after. The free list links are only
+     * valid while the block is free, and overlap the payload.
+     */
+    struct MemoryPool::Block
+    {
+        Block* prevPhys; ///< Physically preceding block, or nullptr for the first block
+        size_t sizeAndFlags; ///< Payload size in bytes, with the free flag in the lowest bit
+        Block* nextFree;
+        Block* prevFree;
+
+        static const size_t c_headerSize = 2 * sizeof(void*) > 16 ? 2 * sizeof(void*) : 16;
+        static const size_t c_minSize = 2 * sizeof(void*) > 16 ? 2 * sizeof(void*) : 16;
+
+        size_t size() const { return sizeAndFlags & ~size_t(1); }
+        bool isFree() const { return sizeAndFlags & 1; }
+        void setSize(size_t a_size) { sizeAndFlags = a_size | (sizeAndFlags & 1); }
+        void setFree(bool a_free) { sizeAndFlags = a_free ? sizeAndFlags | 1 : sizeAndFlags & ~size_t(1); }
 
-syn::MemoryPool::~MemoryPool() {
-    Chunk* tmp = m_head.next;
-    while (tmp) {
-        delete tmp;
-        tmp = m_head.next;
+        uint8_t* payload() { return reinterpret_cast<uint8_t*>(this) + c_headerSize; }
+        Block* next() { return reinterpret_cast<Block*>(payload() + size()); }
+
+        static Block* fromPayload(void* a_ptr) { return reinterpret_cast<Block*>(static_cast<uint8_t*>(a_ptr) - c_headerSize); }
+    };
+
+    const size_t MemoryPool::Block::c_headerSize;
+    const size_t MemoryPool::Block::c_minSize;
+
+    MemoryPool::Scope::Scope(MemoryPool* a_pool) :
+        m_previous(t_currentPool)
+    {
+        t_currentPool = a_pool;
     }
-}
 
-void* syn::MemoryPool::allocate(size_t a_numBytes) {
-    // Find best free chunk
-    int minSizeDiff = -1;
-    Chunk* bestChunk = nullptr;
-    for (Chunk* chunk : m_freeChunks) {
-        int size_dist = static_cast<int>(chunk->size) - static_cast<int>(a_numBytes);
-        if (size_dist < 0)
-            continue;
-        if (minSizeDiff == -1 || size_dist < minSizeDiff) {
-            minSizeDiff = size_dist;
-            bestChunk = chunk;
+    MemoryPool::Scope::~Scope() { t_currentPool = m_previous; }
+
+    MemoryPool::MemoryPool(size_t a_numBytes, bool a_useHugePages) :
+        m_parent(nullptr),
+        m_flBitmap(0),
+        m_slBitmaps{},
+        m_freeLists{},
+        m_bytesUsed(0),
+        m_peakBytesUsed(0),
+        m_numAllocations(0),
+        m_numFailedAllocations(0)
+    {
+        m_lock.clear();
+        // Room for one free block, plus the zero-sized sentinel block that ends the region
+        const size_t maxSize = (size_t(1) << MEMORYPOOL_FL_MAX) - c_hugePageSize;
+        size_t numBytes = alignUp(a_numBytes, Block::c_headerSize) + 2 * Block::c_headerSize + Block::c_minSize;
+        if (numBytes > maxSize)
+            numBytes = maxSize;
+        m_begin = static_cast<uint8_t*>(mapPages(numBytes, a_useHugePages, m_backing));
+        if (!m_begin) {
+            m_begin = static_cast<uint8_t*>(boost::alignment::aligned_alloc(SYN_CACHE_LINE_SIZE, numBytes));
+            m_backing = HeapBacking;
         }
+        if (!m_begin)
+            throw std::bad_alloc();
+        m_end = m_begin + numBytes;
+        _initRegion();
+    }
+
+    MemoryPool::MemoryPool(MemoryPool& a_parent, size_t a_numBytes) :
+        m_parent(&a_parent),
+        m_flBitmap(0),
+        m_slBitmaps{},
+        m_freeLists{},
+        m_bytesUsed(0),
+        m_peakBytesUsed(0),
+        m_numAllocations(0),
+        m_numFailedAllocations(0)
+    {
+        m_lock.clear();
+        const size_t numBytes = alignUp(a_numBytes, Block::c_headerSize) + 2 * Block::c_headerSize + Block::c_minSize;
+        m_begin = static_cast<uint8_t*>(allocateFrom(m_parent, numBytes, SYN_CACHE_LINE_SIZE));
+        m_backing = m_parent->owns(m_begin) ? ParentBacking : HeapBacking;
+        m_end = m_begin + numBytes;
+        _initRegion();
     }
-    if (!bestChunk)
-        throw std::runtime_error("Insufficient memory in pool");
-
-    m_bytesUsed += a_numBytes;
-    // Create new used chunk
-    Chunk* usedChunk = new Chunk;
-    usedChunk->size = a_numBytes;
-    usedChunk->addr = bestChunk->addr;
-    usedChunk->isFree = false;
-    usedChunk->next = bestChunk;
-    usedChunk->prev = bestChunk->prev;
-    bestChunk->prev->next = usedChunk;
-    bestChunk->prev = usedChunk;
-    m_usedChunks.push_back(usedChunk);
-
-    // Update free chunk
-    if (minSizeDiff > 0) {
-        bestChunk->addr = bestChunk->addr + a_numBytes;
-        bestChunk->size = bestChunk->size - a_numBytes;
-    } else {
-        m_freeChunks.erase(find(m_freeChunks.begin(), m_freeChunks.end(), bestChunk));
-        delete bestChunk;
-    }
-
-    return usedChunk->addr;
-}
 
-void syn::MemoryPool::free(void* a_ptr) {
-    size_t numUsedChunks = m_usedChunks.size();
-    for (int i = 0; i < numUsedChunks; i++) {
-        Chunk* chunk = m_usedChunks[i];
-        if (chunk->addr == a_ptr) {
-            m_usedChunks.erase(m_usedChunks.begin() + i);
-            chunk->isFree = true;
-            m_freeChunks.push_back(chunk);
-            m_bytesUsed -= chunk->size;
-            _joinFreeChunks(chunk);
-            break;
+    void MemoryPool::_initRegion()
+    {
+        Block* block = reinterpret_cast<Block*>(m_begin);
+        block->prevPhys = nullptr;
+        block->sizeAndFlags = capacity() - 2 * Block::c_headerSize;
+        Block* sentinel = block->next();
+        sentinel->prevPhys = block;
+        sentinel->sizeAndFlags = 0;
+        _insertFreeBlock(block);
+    }
+
+    MemoryPool::~MemoryPool()
+    {
+        switch (m_backing) {
+            case PageBacking:
+            case HugePageBacking:
+                unmapPages(m_begin, capacity());
+                break;
+            case ParentBacking:
+                m_parent->free(m_begin);
+                break;
+            case HeapBacking:
+            default:
+                boost::alignment::aligned_free(m_begin);
+                break;
         }
     }
-}
 
-void syn::MemoryPool::_joinFreeChunks(Chunk* a_chunk) {
-    if (!a_chunk->isFree)
-        return;
-    while (a_chunk->prev && a_chunk->prev->isFree) {
-        a_chunk->prev->size += a_chunk->size;
-        a_chunk = a_chunk->prev;
-        m_freeChunks.erase(find(m_freeChunks.begin(), m_freeChunks.end(), a_chunk->next));
-        delete a_chunk->next;
+    void MemoryPool::_lock() const
+    {
+        while (m_lock.test_and_set(std::memory_order_acquire)) {}
+    }
+
+    void MemoryPool::_unlock() const { m_lock.clear(std::memory_order_release); }
+
+    void MemoryPool::_mapSize(size_t a_size, int& a_fl, int& a_sl)
+    {
+        if (a_size < (size_t(1) << MEMORYPOOL_FL_SHIFT)) {
+            a_fl = 0;
+            a_sl = static_cast<int>(a_size >> MEMORYPOOL_ALIGN_LOG2);
+        } else {
+            const int fl = findLastSet(a_size);
+            a_sl = static_cast<int>(a_size >> (fl - MEMORYPOOL_SL_LOG2)) ^ MEMORYPOOL_SL_COUNT;
+            a_fl = fl - MEMORYPOOL_FL_SHIFT + 1;
+        }
+    }
+
+    void MemoryPool::_insertFreeBlock(Block* a_block)
+    {
+        int fl, sl;
+        _mapSize(a_block->size(), fl, sl);
+        Block* head = m_freeLists[fl][sl];
+        a_block->setFree(true);
+        a_block->nextFree = head;
+        a_block->prevFree = nullptr;
+        if (head)
+            head->prevFree = a_block;
+        m_freeLists[fl][sl] = a_block;
+        m_flBitmap |= 1u << fl;
+        m_slBitmaps[fl] |= 1u << sl;
+    }
+
+    void MemoryPool::_removeFreeBlock(Block* a_block)
+    {
+        int fl, sl;
+        _mapSize(a_block->size(), fl, sl);
+        if (a_block->prevFree)
+            a_block->prevFree->nextFree = a_block->nextFree;
+        else
+            m_freeLists[fl][sl] = a_block->nextFree;
+        if (a_block->nextFree)
+            a_block->nextFree->prevFree = a_block->prevFree;
+        if (!m_freeLists[fl][sl]) {
+            m_slBitmaps[fl] &= ~(1u << sl);
+            if (!m_slBitmaps[fl])
+                m_flBitmap &= ~(1u << fl);
+        }
+        a_block->setFree(false);
+    }
+
+    MemoryPool::Block* MemoryPool::_takeFreeBlock(size_t a_size)
+    {
+        // Round up to the next size class, so that any block of the class found is large enough
+        if (a_size >= (size_t(1) << MEMORYPOOL_FL_SHIFT))
+            a_size += (size_t(1) << (findLastSet(a_size) - MEMORYPOOL_SL_LOG2)) - 1;
+        int fl, sl;
+        _mapSize(a_size, fl, sl);
+        if (fl >= MEMORYPOOL_FL_COUNT)
+            return nullptr;
+
+        uint32_t slMap = m_slBitmaps[fl] & (~0u << sl);
+        if (!slMap) {
+            const uint32_t flMap = fl + 1 < 32 ? m_flBitmap & (~0u << (fl + 1)) : 0;
+            if (!flMap)
+                return nullptr;
+            fl = findFirstSet(flMap);
+            slMap = m_slBitmaps[fl];
+        }
+        sl = findFirstSet(slMap);
+        Block* block = m_freeLists[fl][sl];
+        _removeFreeBlock(block);
+        return block;
+    }
+
+    void MemoryPool::_trimBlock(Block* a_block, size_t a_size)
+    {
+        if (a_block->size() < a_size + Block::c_headerSize + Block::c_minSize)
+            return;
+        Block* rest = reinterpret_cast<Block*>(a_block->payload() + a_size);
+        rest->prevPhys = a_block;
+        rest->sizeAndFlags = a_block->size() - a_size - Block::c_headerSize;
+        rest->next()->prevPhys = rest;
+        a_block->setSize(a_size);
+        _insertFreeBlock(rest);
+    }
+
+    void* MemoryPool::allocate(size_t a_numBytes, size_t a_alignment)
+    {
+        if (a_numBytes > capacity()) {
+            _lock();
+            m_numFailedAllocations++;
+            _unlock();
+            return nullptr;
+        }
+        size_t size = alignUp(a_numBytes > Block::c_minSize ? a_numBytes : Block::c_minSize, Block::c_headerSize);
+        // Over-aligned requests need room to split off a free block in front of the aligned payload
+        const bool isOverAligned = a_alignment > Block::c_headerSize;
+        const size_t searchSize = isOverAligned ? size + a_alignment + Block::c_headerSize + Block::c_minSize : size;
+
+        _lock();
+        Block* block = _takeFreeBlock(searchSize);
+        if (!block) {
+            m_numFailedAllocations++;
+            _unlock();
+            return nullptr;
+        }
+        if (isOverAligned) {
+            uintptr_t payload = reinterpret_cast<uintptr_t>(block->payload());
+            uintptr_t aligned = alignUp(payload, a_alignment);
+            if (aligned != payload && aligned - payload < Block::c_headerSize + Block::c_minSize)
+                aligned = alignUp(payload + Block::c_headerSize + Block::c_minSize, a_alignment);
+            const size_t gap = aligned - payload;
+            if (gap) {
+                Block* alignedBlock = reinterpret_cast<Block*>(reinterpret_cast<uint8_t*>(block) + gap);
+                alignedBlock->prevPhys = block;
+                alignedBlock->sizeAndFlags = block->size() - gap;
+                alignedBlock->next()->prevPhys = alignedBlock;
+                block->setSize(gap - Block::c_headerSize);
+                _insertFreeBlock(block);
+                block = alignedBlock;
+            }
+        }
+        _trimBlock(block, size);
+
+        m_bytesUsed += block->size() + Block::c_headerSize;
+        if (m_bytesUsed > m_peakBytesUsed)
+            m_peakBytesUsed = m_bytesUsed;
+        m_numAllocations++;
+        _unlock();
+        return block->payload();
+    }
+
+    void MemoryPool::free(void* a_ptr)
+    {
+        if (!a_ptr)
+            return;
+        Block* block = Block::fromPayload(a_ptr);
+        _lock();
+        m_bytesUsed -= block->size() + Block::c_headerSize;
+        m_numAllocations--;
+        // Merge with free neighbours, so that free blocks are never adjacent
+        Block* prev = block->prevPhys;
+        if (prev && prev->isFree()) {
+            _removeFreeBlock(prev);
+            prev->setSize(prev->size() + Block::c_headerSize + block->size());
+            prev->next()->prevPhys = prev;
+            block = prev;
+        }
+        Block* next = block->next();
+        if (next->isFree()) {
+            _removeFreeBlock(next);
+            block->setSize(block->size() + Block::c_headerSize + next->size());
+            block->next()->prevPhys = block;
+        }
+        _insertFreeBlock(block);
+        _unlock();
+    }
+
+    MemoryPool::Stats MemoryPool::getStats() const
+    {
+        _lock();
+        Stats stats;
+        stats.capacity = capacity();
+        stats.bytesUsed = m_bytesUsed;
+        stats.peakBytesUsed = m_peakBytesUsed;
+        stats.numAllocations = m_numAllocations;
+        stats.numFailedAllocations = m_numFailedAllocations;
+        stats.largestFreeBlock = 0;
+        if (m_flBitmap) {
+            const int fl = findLastSet(m_flBitmap);
+            const int sl = findLastSet(m_slBitmaps[fl]);
+            for (const Block* block = m_freeLists[fl][sl]; block; block = block->nextFree)
+                if (block->size() > stats.largestFreeBlock)
+                    stats.largestFreeBlock = block->size();
+        }
+        _unlock();
+        return stats;
+    }
+
+    std::vector<MemoryPool::BlockInfo> MemoryPool::getMemoryMap() const
+    {
+        std::vector<BlockInfo> blocks;
+        _lock();
+        for (Block* block = reinterpret_cast<Block*>(m_begin); block->size() > 0; block = block->next())
+            blocks.push_back({ block->payload(), block->size(), block->isFree() });
+        _unlock();
+        return blocks;
+    }
+
+    void* MemoryPool::allocateFrom(MemoryPool* a_pool, size_t a_numBytes, size_t a_alignment)
+    {
+        for (MemoryPool* pool = a_pool; pool; pool = pool->m_parent) {
+            void* ptr = pool->allocate(a_numBytes, a_alignment);
+            if (ptr)
+                return ptr;
+        }
+        void* ptr = boost::alignment::aligned_alloc(a_alignment, a_numBytes ? a_numBytes : 1);
+        if (!ptr)
+            throw std::bad_alloc();
+        return ptr;
     }
-    while (a_chunk->next && a_chunk->next->isFree) {
-        a_chunk->size += a_chunk->next->size;
-        m_freeChunks.erase(find(m_freeChunks.begin(), m_freeChunks.end(), a_chunk->next));
-        delete a_chunk->next;
+
+    void MemoryPool::release(MemoryPool* a_pool, void* a_ptr)
+    {
+        for (MemoryPool* pool = a_pool; pool; pool = pool->m_parent) {
+            if (pool->owns(a_ptr)) {
+                pool->free(a_ptr);
+                return;
+            }
+        }
+        boost::alignment::aligned_free(a_ptr);
     }
+
+    MemoryPool* MemoryPool::current() { return t_currentPool; }
 }
@@ -19,19 +19,69 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #include "vosimlib/Unit.h"
 #include "vosimlib/DSPMath.h"
 #include "vosimlib/Circuit.h"
+#include <boost/align/aligned_allocator.hpp>
 
 using std::hash;
 
+namespace
+{
+    std::shared_ptr<syn::ParameterBlock> newParameterBlock(const syn::ParameterBlock* a_source = nullptr)
+    {
+        boost::alignment::aligned_allocator<syn::ParameterBlock> allocator;
+        if (a_source)
+            return std::allocate_shared<syn::ParameterBlock>(allocator, *a_source);
+        return std::allocate_shared<syn::ParameterBlock>(allocator);
+    }
+
+    const syn::BufferTag c_untaggedBuffer; ///< Tag of inputs fed by buffers that are never tagged
+
+    /// Units are preceded by the pool they were allocated from, padded to keep them aligned to a cache line
+    const size_t c_unitHeaderSize = SYN_CACHE_LINE_SIZE;
+}
+
 namespace syn
 {
+    void* Unit::operator new(size_t a_size)
+    {
+        MemoryPool* pool = MemoryPool::current();
+        uint8_t* block = static_cast<uint8_t*>(MemoryPool::allocateFrom(pool, a_size + c_unitHeaderSize, c_unitHeaderSize));
+        *reinterpret_cast<MemoryPool**>(block) = pool;
+        return block + c_unitHeaderSize;
+    }
+
+    void Unit::operator delete(void* a_ptr)
+    {
+        if (!a_ptr)
+            return;
+        uint8_t* block = static_cast<uint8_t*>(a_ptr) - c_unitHeaderSize;
+        MemoryPool::release(*reinterpret_cast<MemoryPool**>(block), block);
+    }
+
     Unit::Unit() : Unit("") {}
 
     Unit::Unit(const std::string& a_name) :
         m_currentBufferOffset(0),
         m_name{ a_name },
+        m_parameters{ newParameterBlock() },
+        m_parameterVersion(0),
+        m_parameterVersions{},
         m_parent{ nullptr },
-        m_audioConfig{ 44.1e3, 120, 1 },
-        m_midiData{} {}
+        m_audioConfig{ 44.1e3, 120, 1, 1 },
+        m_numSamples(1),
+        m_useBlockProcessing(false),
+        m_useControlRate(false),
+        m_controlInterpolations{},
+        m_controlPhase(0),
+        m_controlCountdown(0),
+        m_hasControlValues(false),
+        m_prevControlValues{},
+        m_controlValues{},
+        m_midiData{},
+        m_isActive(false),
+        m_paramSnapshot{},
+        m_hasParamSnapshot(false),
+        m_localProcRecord{},
+        m_procRecord{ &m_localProcRecord } {}
 
     void Unit::setName(const string& a_name) { m_name = a_name; }
 
@@ -44,10 +94,25 @@ namespace syn
     void Unit::setFs(double a_newFs)
     {
         m_audioConfig.fs = a_newFs;
+        _resetControlRate();
+        _resetParameterSmoothing();
         reset();
         onFsChange_();
     }
 
+    void Unit::setControlPeriod(int a_controlPeriod)
+    {
+        m_audioConfig.controlPeriod = MAX(1, a_controlPeriod);
+        _resizeControlBuffers();
+        _resetControlRate();
+        // The rate of a control rate unit has changed, as far as the unit can tell
+        if (m_useControlRate) {
+            reset();
+            onFsChange_();
+        }
+        onControlPeriodChange_();
+    }
+
     void Unit::setTempo(double a_newTempo)
     {
         m_audioConfig.tempo = a_newTempo;
@@ -59,28 +124,295 @@ namespace syn
         m_midiData.note = a_note;
         m_midiData.velocity = a_velocity;
         m_midiData.isNoteOn = true;
+        // Note events split blocks, so control rate units respond to them right away
+        m_controlPhase = 0;
+        // Parameters may have moved while the voice was idle, and a new note should not slide from there
+        _resetParameterSmoothing();
         onNoteOn_();
+        updateActivity_();
     }
 
     void Unit::noteOff()
     {
         m_midiData.isNoteOn = false;
+        m_controlPhase = 0;
         onNoteOff_();
+        updateActivity_();
+    }
+
+    void Unit::updateActivity_()
+    {
+        const bool isActive = this->isActive();
+        if (isActive == m_isActive)
+            return;
+        m_isActive = isActive;
+        // Only units in the execution plan of their circuit count towards its activity
+        if (m_parent && m_procRecord != &m_localProcRecord)
+            m_parent->_onUnitActivityChange(isActive);
     }
 
     void Unit::setBufferSize(int a_bufferSize)
     {
         m_audioConfig.bufferSize = a_bufferSize;
+        m_numSamples = a_bufferSize;
         for (auto& output : m_outputPorts) {
             output.resize(a_bufferSize);
         }
+        _resizeDefaultInputs();
+        _resizeControlBuffers();
+    }
+
+    void Unit::enableBlockProcessing_()
+    {
+        m_useBlockProcessing = true;
+        _resizeDefaultInputs();
+    }
+
+    void Unit::_resizeDefaultInputs()
+    {
+        if (!m_useBlockProcessing)
+            return;
+        const int bufferSize = m_audioConfig.bufferSize;
+        m_defaultInputs.resize(m_inputPorts.size() * bufferSize);
+        for (int i = 0; i < m_inputPorts.size(); i++)
+        {
+            Sample* first = m_defaultInputs.data() + i * bufferSize;
+            std::fill(first, first + bufferSize, m_inputPorts.getByIndex(i).defVal);
+        }
+    }
+
+    void Unit::enableControlRate_(ControlInterpolation a_interpolation)
+    {
+        m_useControlRate = true;
+        std::fill(std::begin(m_controlInterpolations), std::end(m_controlInterpolations), a_interpolation);
+        _resizeControlBuffers();
+    }
+
+    void Unit::setControlInterpolation_(int a_outputId, ControlInterpolation a_interpolation)
+    {
+        m_controlInterpolations[a_outputId] = a_interpolation;
+    }
+
+    void Unit::_resizeControlBuffers()
+    {
+        if (!m_useControlRate)
+            return;
+        const int period = m_audioConfig.controlPeriod;
+        const int maxTicks = (m_audioConfig.bufferSize + period - 1) / period;
+        m_controlBuffers.resize((MAX_INPUTS + MAX_OUTPUTS) * maxTicks);
+    }
+
+    void Unit::_resetControlRate()
+    {
+        m_controlPhase = 0;
+        m_controlCountdown = 0;
+        m_hasControlValues = false;
+    }
+
+    void Unit::process_()
+    {
+        processBlock_(m_procRecord->inputs, m_procRecord->outputs, m_numSamples);
+    }
+
+    void Unit::writeConstantOutput_(int a_id, double a_value)
+    {
+        Sample* out = m_procRecord->outputs[a_id];
+        std::fill(out, out + m_numSamples, static_cast<Sample>(a_value));
+        *m_procRecord->outputTags[a_id] = BufferTag(true, static_cast<Sample>(a_value));
+    }
+
+    bool Unit::_skipSilence()
+    {
+        for (int i = 0; i < m_outputPorts.size(); i++)
+            m_procRecord->outputTags[m_outputPorts.ids()[i]]->isConstant = false;
+        if (!isSilent_())
+            return false;
+        for (int i = 0; i < m_outputPorts.size(); i++)
+            writeConstantOutput_(m_outputPorts.ids()[i], 0.0);
+        return true;
+    }
+
+    void Unit::_process()
+    {
+        if (!_skipSilence())
+        {
+            if (m_useControlRate && m_audioConfig.controlPeriod > 1)
+                _processControlRate();
+            else
+                process_();
+        }
+        _captureOutputs();
+    }
+
+    void Unit::_captureOutputs()
+    {
+        for (int i = 0; i < m_outputPorts.size(); i++)
+            m_outputPorts.getByIndex(i).capture(m_numSamples);
+    }
+
+    void Unit::_processControlRate()
+    {
+        const int period = m_audioConfig.controlPeriod;
+        const int maxTicks = (m_audioConfig.bufferSize + period - 1) / period;
+        const int numSamples = m_numSamples;
+        const int phase = m_controlPhase;
+        const int numTicks = phase < numSamples ? (numSamples - phase + period - 1) / period : 0;
+        ProcRecord* audioRecord = m_procRecord;
+
+        if (numTicks > 0)
+        {
+            // Sample the inputs on each control tick, and run the unit over the ticks alone
+            ProcRecord controlRecord = *audioRecord;
+            for (int i = 0; i < m_inputPorts.size(); i++)
+            {
+                const int id = m_inputPorts.ids()[i];
+                const Sample* src = audioRecord->inputs[id];
+                const int mask = audioRecord->inputMasks[id];
+                Sample* dst = m_controlBuffers.data() + id * maxTicks;
+                for (int j = 0; j < numTicks; j++)
+                    dst[j] = src[(phase + j * period) & mask];
+                controlRecord.inputs[id] = dst;
+                controlRecord.inputMasks[id] = ~0;
+            }
+            for (int i = 0; i < m_outputPorts.size(); i++)
+            {
+                const int id = m_outputPorts.ids()[i];
+                controlRecord.outputs[id] = m_controlBuffers.data() + (MAX_INPUTS + id) * maxTicks;
+            }
+            m_procRecord = &controlRecord;
+            m_numSamples = numTicks;
+            process_();
+            m_procRecord = audioRecord;
+            m_numSamples = numSamples;
+        }
+
+        // Bring each output back to audio rate. Samples before the first tick finish the previous ramp.
+        const double invPeriod = 1.0 / period;
+        for (int i = 0; i < m_outputPorts.size(); i++)
+        {
+            const int id = m_outputPorts.ids()[i];
+            const Sample* ticks = m_controlBuffers.data() + (MAX_INPUTS + id) * maxTicks;
+            Sample* out = audioRecord->outputs[id];
+            const bool hold = m_controlInterpolations[id] == HoldControl;
+            double prevValue = m_prevControlValues[id];
+            double value = m_controlValues[id];
+            int rampPos = period - phase;
+            int j = 0;
+            // The output is constant if every segment is flat, at the same value
+            bool isConstant = true;
+            for (int k = -1; k < numTicks; k++)
+            {
+                if (k >= 0)
+                {
+                    prevValue = m_hasControlValues || k > 0 ? value : ticks[k];
+                    value = ticks[k];
+                    rampPos = 0;
+                }
+                const int segmentEnd = k + 1 < numTicks ? phase + (k + 1) * period : numSamples;
+                if (segmentEnd > j)
+                    isConstant = isConstant && (hold || prevValue == value) && (j == 0 || static_cast<Sample>(value) == out[0]);
+                if (hold || prevValue == value)
+                {
+                    std::fill(out + j, out + segmentEnd, static_cast<Sample>(value));
+                    rampPos += segmentEnd - j;
+                    j = segmentEnd;
+                }
+                else
+                {
+                    const double step = (value - prevValue) * invPeriod;
+                    for (; j < segmentEnd; j++)
+                        out[j] = static_cast<Sample>(prevValue + step * ++rampPos);
+                }
+            }
+            m_prevControlValues[id] = prevValue;
+            m_controlValues[id] = value;
+            *audioRecord->outputTags[id] = BufferTag(isConstant && numSamples > 0, numSamples > 0 ? out[0] : 0.0);
+        }
+        if (numTicks > 0)
+            m_hasControlValues = true;
+        m_controlPhase = phase + numTicks * period - numSamples;
     }
 
     int Unit::getBufferSize() const { return m_audioConfig.bufferSize; }
 
-    void Unit::notifyParameterChanged(int a_id) { onParamChange_(a_id); }
+    void Unit::updateParameters() { _syncParameters(); }
 
-    double Unit::fs() const { return m_audioConfig.fs; }
+    void Unit::_syncParameters()
+    {
+        // onParamChange_ may change parameters itself, so keep going until the block settles
+        while (m_parameterVersion != m_parameters->version)
+        {
+            m_parameterVersion = m_parameters->version;
+            const StrMap<UnitParameter, MAX_PARAMS>& params = m_parameters->params;
+            for (int i = 0; i < params.size(); i++)
+            {
+                int id = params.ids()[i];
+                if (params[id].m_version != m_parameterVersions[id])
+                {
+                    m_parameterVersions[id] = params[id].m_version;
+                    onParamChange_(id);
+                }
+            }
+        }
+    }
+
+    void Unit::_notifyAllParameters()
+    {
+        const StrMap<UnitParameter, MAX_PARAMS>& params = m_parameters->params;
+        for (int i = 0; i < params.size(); i++)
+        {
+            int id = params.ids()[i];
+            m_parameterVersions[id] = params[id].m_version - 1;
+        }
+        m_parameterVersion = m_parameters->version - 1;
+        _syncParameters();
+    }
+
+    void Unit::shareParameters(const Unit& a_other)
+    {
+        if (m_parameters == a_other.m_parameters)
+            return;
+        m_parameters = a_other.m_parameters;
+        _resetParameterSmoothing();
+        // Derived state must be rebuilt from the new values
+        _notifyAllParameters();
+    }
+
+    void Unit::detachParameters()
+    {
+        if (!hasSharedParameters())
+            return;
+        m_parameters = newParameterBlock(m_parameters.get());
+    }
+
+    void Unit::_captureParameters()
+    {
+        const StrMap<UnitParameter, MAX_PARAMS>& params = m_parameters->params;
+        ParamSnapshot& snapshot = m_paramSnapshot;
+        // Control rate units see fewer samples than the block holds, and their outputs are interpolated anyway
+        const int rampLength = m_useControlRate ? 0 : m_numSamples;
+        snapshot.dirty = 0;
+        for (int i = 0; i < params.size(); i++)
+        {
+            const int id = params.ids()[i];
+            const UnitParameter& param = params[id];
+            const double value = param.getDouble();
+            if (!m_hasParamSnapshot || value != snapshot.values[id])
+            {
+                snapshot.dirty |= 1u << id;
+                snapshot.ints[id] = param.getInt();
+                snapshot.enums[id] = param.getType() == UnitParameter::Enum ? param.getEnum() : value;
+            }
+            if (m_hasParamSnapshot && param.isSmoothed() && rampLength > 0)
+                snapshot.steps[id] = (value - snapshot.values[id]) / rampLength;
+            else
+                snapshot.steps[id] = 0.0;
+            snapshot.values[id] = value;
+        }
+        m_hasParamSnapshot = true;
+    }
+
+    double Unit::fs() const { return m_useControlRate ? m_audioConfig.fs / m_audioConfig.controlPeriod : m_audioConfig.fs; }
 
     double Unit::tempo() const { return m_audioConfig.tempo; }
 
@@ -90,7 +422,7 @@ namespace syn
 
     int Unit::velocity() const { return m_midiData.velocity; }
 
-    int Unit::numParams() const { return static_cast<int>(m_parameters.size()); }
+    int Unit::numParams() const { return static_cast<int>(m_parameters->params.size()); }
 
     int Unit::numInputs() const { return static_cast<int>(m_inputPorts.size()); }
 
@@ -100,18 +432,18 @@ namespace syn
 
     Circuit* Unit::parent() const { return m_parent; }
 
-    const string& Unit::paramName(int a_id) const { return m_parameters.getNameFromId(a_id); }
+    const string& Unit::paramName(int a_id) const { return m_parameters->params.getNameFromId(a_id); }
 
-    const StrMap<UnitParameter, MAX_PARAMS>& Unit::parameters() const { return m_parameters; }
+    const StrMap<UnitParameter, MAX_PARAMS>& Unit::parameters() const { return m_parameters->params; }
 
-    void Unit::tick(const Eigen::Array<double, -1, -1, Eigen::RowMajor>& a_inputs, Eigen::Array<double, -1, -1, Eigen::RowMajor>& a_outputs)
+    void Unit::tick(const dynamic_buffer_t& a_inputs, dynamic_buffer_t& a_outputs)
     {
         int nSamples = a_inputs.cols();
         int nInputs = MIN<int>(a_inputs.rows(), m_inputPorts.size());
         int nOutputs = MIN<int>(a_outputs.rows(), m_outputPorts.size());
         const Buffer* oldInputSources[MAX_INPUTS];
         std::vector<ReadOnlyBuffer<SampleType>> newInputSources(nInputs);
-        double* oldOutputTargets[MAX_OUTPUTS];
+        SampleType* oldOutputTargets[MAX_OUTPUTS];
         // set new buffer size
         int oldBufferSize = m_audioConfig.bufferSize;
         setBufferSize(nSamples);
@@ -136,22 +468,43 @@ namespace syn
         for (int i = 0; i < nOutputs; i++) { m_outputPorts.getByIndex(i).setBuf(oldOutputTargets[i]); }
     }
 
-    int Unit::addInput_(const string& a_name, double a_default) { return m_inputPorts.add(a_name, InputPort{ a_default }); }
+    int Unit::addInput_(const string& a_name, double a_default)
+    {
+        int id = m_inputPorts.add(a_name, InputPort{ static_cast<Sample>(a_default) });
+        _resizeDefaultInputs();
+        return id;
+    }
+
+    bool Unit::addInput_(int a_id, const string& a_name, double a_default)
+    {
+        bool retval = m_inputPorts.add(a_name, a_id, InputPort{ static_cast<Sample>(a_default) });
+        _resizeDefaultInputs();
+        return retval;
+    }
 
-    bool Unit::addInput_(int a_id, const string& a_name, double a_default) { return m_inputPorts.add(a_name, a_id, InputPort{ a_default }); }
+    bool Unit::removeInput_(const string& a_name)
+    {
+        bool retval = m_inputPorts.removeByName(a_name);
+        _resizeDefaultInputs();
+        return retval;
+    }
 
-    bool Unit::removeInput_(const string& a_name) { return m_inputPorts.removeByName(a_name); }
-    bool Unit::removeInput_(int a_id) { return m_inputPorts.removeById(a_id); }
+    bool Unit::removeInput_(int a_id)
+    {
+        bool retval = m_inputPorts.removeById(a_id);
+        _resizeDefaultInputs();
+        return retval;
+    }
 
     bool Unit::addOutput_(int a_id, const string& a_name) { return m_outputPorts.add(a_name, a_id, OutputPort(getBufferSize())); }
 
     bool Unit::addParameter_(int a_id, const UnitParameter& a_param)
     {
-        bool retval = m_parameters.add(a_param.getName(), a_id, a_param);
+        bool retval = m_parameters->params.add(a_param.getName(), a_id, a_param);
         if (retval)
         {
-            m_parameters[a_id].setParent(this);
-            m_parameters[a_id].setId(a_id);
+            m_parameters->params[a_id].setId(a_id);
+            m_parameters->rewire();
         }
         return retval;
     }
@@ -160,17 +513,47 @@ namespace syn
 
     int Unit::addParameter_(const UnitParameter& a_param)
     {
-        int id = m_parameters.add(a_param.getName(), a_param);
+        int id = m_parameters->params.add(a_param.getName(), a_param);
         if (id >= 0)
         {
-            m_parameters[id].setParent(this);
-            m_parameters[id].setId(id);
+            m_parameters->params[id].setId(id);
+            m_parameters->rewire();
         }
         return id;
     }
 
     void Unit::_setParent(Circuit* a_new_parent) { m_parent = a_new_parent; }
 
+    void Unit::_resolveProcRecord(ProcRecord& a_record)
+    {
+        a_record.unit = this;
+        for (int i = 0; i < m_inputPorts.size(); i++)
+        {
+            int id = m_inputPorts.ids()[i];
+            InputPort& port = m_inputPorts[id];
+            if (port.src) {
+                a_record.inputs[id] = port.src->buf();
+                a_record.inputMasks[id] = ~0;
+                a_record.inputTags[id] = port.src->tag() ? port.src->tag() : &c_untaggedBuffer;
+            } else if (m_useBlockProcessing) {
+                a_record.inputs[id] = m_defaultInputs.data() + i * getBufferSize();
+                a_record.inputMasks[id] = ~0;
+                a_record.inputTags[id] = &port.defTag;
+            } else {
+                a_record.inputs[id] = &port.defVal;
+                a_record.inputMasks[id] = 0;
+                a_record.inputTags[id] = &port.defTag;
+            }
+        }
+        for (int i = 0; i < m_outputPorts.size(); i++)
+        {
+            int id = m_outputPorts.ids()[i];
+            a_record.outputs[id] = m_outputPorts[id].buf();
+            a_record.outputTags[id] = m_outputPorts[id].tag();
+        }
+        a_record.params = &m_paramSnapshot;
+    }
+
     void Unit::connectInput(int a_inputPort, const Buffer& a_output)
     {
         m_inputPorts[a_inputPort].connect(&a_output);
@@ -206,19 +589,25 @@ namespace syn
         setFs(a_other.m_audioConfig.fs);
         setTempo(a_other.m_audioConfig.tempo);
         setBufferSize(a_other.m_audioConfig.bufferSize);
+        setControlPeriod(a_other.m_audioConfig.controlPeriod);
         // Copy parameter values
-        const string* paramNames = m_parameters.names();
-        for (int i = 0; i < m_parameters.size(); i++)
+        StrMap<UnitParameter, MAX_PARAMS>& params = m_parameters->params;
+        const string* paramNames = params.names();
+        for (int i = 0; i < params.size(); i++)
         {
             const string& paramName = paramNames[i];
             if (a_other.hasParam(paramName))
-                m_parameters[paramName].setFromString(a_other.m_parameters[paramName].getValueString());
+                params[paramName].setFromString(a_other.m_parameters->params[paramName].getValueString());
         }
+        _syncParameters();
     }
 
     Unit* Unit::clone() const
     {
         Unit* unit = _clone();
+        // Clones never share parameters, even if the derived class copied the block along with the base class
+        unit->m_procRecord = &unit->m_localProcRecord;
+        unit->detachParameters();
         unit->copyFrom_(*this);
         return unit;
     }
@@ -229,10 +618,10 @@ namespace syn
         j["name"] = m_name;
         /* Serialize parameters */
         j["parameters"] = json();
-        for (int i = 0; i < m_parameters.size(); i++)
+        for (int i = 0; i < m_parameters->params.size(); i++)
         {
-            int index = m_parameters.ids()[i];
-            j["parameters"][std::to_string(index)] = m_parameters[index];
+            int index = m_parameters->params.ids()[i];
+            j["parameters"][std::to_string(index)] = m_parameters->params[index];
         }
         j["class_id"] = getClassIdentifier();
         return j;
@@ -252,8 +641,9 @@ namespace syn
         for (json::iterator it = params.begin(); it != params.end(); ++it)
         {
             int index = stoi(it.key());
-            unit->m_parameters[index].load(j["parameters"][it.key()]);
+            unit->m_parameters->params[index].load(j["parameters"][it.key()]);
         }
+        unit->_syncParameters();
 
         unit->load(j);
         return unit;
@@ -276,6 +666,8 @@ namespace syn
 
     double Unit::readOutput(int a_id, int a_offset) const { return m_outputPorts[a_id].read(a_offset); }
 
+    double Unit::lastOutput(int a_id) const { return m_outputPorts[a_id].lastValue(); }
+
     const StrMap<Unit::OutputPort, MAX_OUTPUTS>& Unit::outputs() const { return m_outputPorts; }
 
     Unit::OutputPort& Unit::output(int a_id) { return m_outputPorts[a_id]; }
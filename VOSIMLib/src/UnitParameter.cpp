@@ -19,7 +19,6 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #include "vosimlib/UnitParameter.h"
 #include <vosimlib/DSPMath.h>
 #include <string>
-#include <vosimlib/Unit.h>
 
 namespace syn {
     UnitParameter::UnitParameter()
@@ -32,11 +31,13 @@ namespace syn {
         m_max(1),
         m_shape(0.0),
         m_isVisible(true),
+        m_isSmoothed(false),
         m_type(Null),
         m_unitsType(None),
         m_controlType(Bounded),
         m_displayPrecision(0),
-        m_parent(nullptr) { }
+        m_version(0),
+        m_blockVersion(nullptr) { }
 
     UnitParameter::UnitParameter(const string& a_name, bool a_defaultValue)
         :
@@ -53,10 +54,12 @@ namespace syn {
         m_max(a_max),
         m_shape(0.0),
         m_isVisible(true),
+        m_isSmoothed(false),
         m_type(Int),
         m_controlType(Bounded),
         m_displayPrecision(0),
-        m_parent(nullptr) {
+        m_version(0),
+        m_blockVersion(nullptr) {
         setUnitsType(a_unitsType);
     }
 
@@ -71,10 +74,12 @@ namespace syn {
         m_max(a_optionNames.size() - 1),
         m_shape(0.0),
         m_isVisible(true),
+        m_isSmoothed(false),
         m_type(Enum),
         m_controlType(Bounded),
         m_displayPrecision(0),
-        m_parent(nullptr) {
+        m_version(0),
+        m_blockVersion(nullptr) {
         m_defaultValue = a_defaultOption;
         m_value = m_defaultValue;
         setUnitsType(a_unitsType);
@@ -96,10 +101,12 @@ namespace syn {
         m_max(a_max),
         m_shape(0.0),
         m_isVisible(true),
+        m_isSmoothed(false),
         m_type(Double),
         m_controlType(Bounded),
         m_displayPrecision(a_displayPrecision),
-        m_parent(nullptr) {
+        m_version(0),
+        m_blockVersion(nullptr) {
         setUnitsType(a_unitsType);
     }
 
@@ -114,13 +121,6 @@ namespace syn {
         return *this;
     }
 
-    Unit* UnitParameter::getParent() const { return m_parent; }
-
-    UnitParameter& UnitParameter::setParent(Unit* a_newParent) {
-        m_parent = a_newParent;
-        return *this;
-    }
-
     UnitParameter::EParamType UnitParameter::getType() const { return m_type; }
 
     double UnitParameter::getMin() const { return m_min; }
@@ -214,7 +214,7 @@ namespace syn {
         a_value = CLAMP<double>(a_value, m_min, m_max);
         if (m_value != a_value) {
             m_value = a_value;
-            if (m_parent) { m_parent->notifyParameterChanged(m_id); }
+            _markChanged();
             return true;
         }
         return false;
@@ -333,9 +333,15 @@ namespace syn {
         for (const json& k : j["display_texts"]) { m_displayTexts.emplace_back(k); }
         m_min = j["min"];
         m_max = j["max"];
+        _markChanged();
         return *this;
     }
 
+    void UnitParameter::_markChanged() {
+        m_version++;
+        if (m_blockVersion) { (*m_blockVersion)++; }
+    }
+
     UnitParameter::operator json() const {
         json j;
         j["value"] = getValueString();
@@ -0,0 +1,203 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "vosimlib/VoiceAllocator.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    int findFirstSet(uint64_t a_word)
+    {
+#if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        return _BitScanForward64(&index, a_word) ? static_cast<int>(index) : -1;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanForward(&index, static_cast<unsigned long>(a_word)))
+            return static_cast<int>(index);
+        return _BitScanForward(&index, static_cast<unsigned long>(a_word >> 32)) ? static_cast<int>(index) + 32 : -1;
+#else
+        return a_word ? __builtin_ctzll(a_word) : -1;
+#endif
+    }
+
+    int findLastSet(uint64_t a_word)
+    {
+#if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        return _BitScanReverse64(&index, a_word) ? static_cast<int>(index) : -1;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanReverse(&index, static_cast<unsigned long>(a_word >> 32)))
+            return static_cast<int>(index) + 32;
+        return _BitScanReverse(&index, static_cast<unsigned long>(a_word)) ? static_cast<int>(index) : -1;
+#else
+        return a_word ? 63 - __builtin_clzll(a_word) : -1;
+#endif
+    }
+}
+
+namespace syn
+{
+    void VoiceAllocator::reset(int a_numVoices) {
+        a_numVoices = a_numVoices > 0 ? a_numVoices : 0;
+        m_states.assign(a_numVoices, Idle);
+        m_notes.assign(a_numVoices, -1);
+        m_links.resize(a_numVoices);
+        m_noteLinks.assign(a_numVoices, Link{-1, -1});
+        for (int i = 0; i < NumVoiceStates; i++) {
+            m_heads[i] = m_tails[i] = -1;
+            m_counts[i] = 0;
+        }
+        for (int i = 0; i < 2; i++) {
+            for (int note = 0; note < VOICEALLOCATOR_NUM_NOTES; note++)
+                m_noteHeads[i][note] = m_noteTails[i][note] = -1;
+            for (int word = 0; word < VOICEALLOCATOR_NUM_WORDS; word++)
+                m_noteBitmaps[i][word] = 0;
+        }
+        for (int i = 0; i < a_numVoices; i++)
+            _link(i, Idle, -1);
+    }
+
+    int VoiceAllocator::lowest(VoiceState a_state) const {
+        if (a_state == Idle)
+            return -1;
+        const uint64_t* bitmap = m_noteBitmaps[a_state - Held];
+        for (int word = 0; word < VOICEALLOCATOR_NUM_WORDS; word++) {
+            if (bitmap[word])
+                return m_noteHeads[a_state - Held][word * 64 + findFirstSet(bitmap[word])];
+        }
+        return -1;
+    }
+
+    int VoiceAllocator::highest(VoiceState a_state) const {
+        if (a_state == Idle)
+            return -1;
+        const uint64_t* bitmap = m_noteBitmaps[a_state - Held];
+        for (int word = VOICEALLOCATOR_NUM_WORDS - 1; word >= 0; word--) {
+            if (bitmap[word])
+                return m_noteHeads[a_state - Held][word * 64 + findLastSet(bitmap[word])];
+        }
+        return -1;
+    }
+
+    int VoiceAllocator::firstWithNote(VoiceState a_state, int a_note) const {
+        if (a_state == Idle)
+            return -1;
+        // Neighbouring out of range notes share a bucket, so skip the voices that play another one
+        int voice = m_noteHeads[a_state - Held][_bucket(a_note)];
+        while (voice >= 0 && m_notes[voice] != a_note)
+            voice = m_noteLinks[voice].next;
+        return voice;
+    }
+
+    int VoiceAllocator::nextWithNote(int a_voice) const {
+        int voice = m_noteLinks[a_voice].next;
+        while (voice >= 0 && m_notes[voice] != m_notes[a_voice])
+            voice = m_noteLinks[voice].next;
+        return voice;
+    }
+
+    void VoiceAllocator::hold(int a_voice, int a_note) {
+        _unlink(a_voice);
+        _link(a_voice, Held, a_note);
+    }
+
+    void VoiceAllocator::release(int a_voice) {
+        if (m_states[a_voice] != Held)
+            return;
+        const int note = m_notes[a_voice];
+        _unlink(a_voice);
+        _link(a_voice, Released, note);
+    }
+
+    void VoiceAllocator::free(int a_voice) {
+        const int note = m_notes[a_voice];
+        _unlink(a_voice);
+        _link(a_voice, Idle, note);
+    }
+
+    void VoiceAllocator::_link(int a_voice, VoiceState a_state, int a_note) {
+        m_states[a_voice] = static_cast<uint8_t>(a_state);
+        m_notes[a_voice] = a_note;
+
+        Link& link = m_links[a_voice];
+        link.prev = m_tails[a_state];
+        link.next = -1;
+        if (link.prev >= 0)
+            m_links[link.prev].next = a_voice;
+        else
+            m_heads[a_state] = a_voice;
+        m_tails[a_state] = a_voice;
+        m_counts[a_state]++;
+
+        if (a_state == Idle)
+            return;
+        const int bucket = _bucket(a_note);
+        int* heads = m_noteHeads[a_state - Held];
+        int* tails = m_noteTails[a_state - Held];
+        Link& noteLink = m_noteLinks[a_voice];
+        noteLink.prev = tails[bucket];
+        noteLink.next = -1;
+        if (noteLink.prev >= 0)
+            m_noteLinks[noteLink.prev].next = a_voice;
+        else
+            heads[bucket] = a_voice;
+        tails[bucket] = a_voice;
+        m_noteBitmaps[a_state - Held][bucket / 64] |= uint64_t(1) << (bucket % 64);
+    }
+
+    void VoiceAllocator::_unlink(int a_voice) {
+        const VoiceState state = getState(a_voice);
+
+        Link& link = m_links[a_voice];
+        if (link.prev >= 0)
+            m_links[link.prev].next = link.next;
+        else
+            m_heads[state] = link.next;
+        if (link.next >= 0)
+            m_links[link.next].prev = link.prev;
+        else
+            m_tails[state] = link.prev;
+        m_counts[state]--;
+
+        if (state == Idle)
+            return;
+        const int bucket = _bucket(m_notes[a_voice]);
+        int* heads = m_noteHeads[state - Held];
+        int* tails = m_noteTails[state - Held];
+        Link& noteLink = m_noteLinks[a_voice];
+        if (noteLink.prev >= 0)
+            m_noteLinks[noteLink.prev].next = noteLink.next;
+        else
+            heads[bucket] = noteLink.next;
+        if (noteLink.next >= 0)
+            m_noteLinks[noteLink.next].prev = noteLink.prev;
+        else
+            tails[bucket] = noteLink.prev;
+        noteLink.prev = noteLink.next = -1;
+        if (heads[bucket] < 0)
+            m_noteBitmaps[state - Held][bucket / 64] &= ~(uint64_t(1) << (bucket % 64));
+    }
+
+    int VoiceAllocator::_bucket(int a_note) {
+        return a_note < 0 ? 0 : a_note >= VOICEALLOCATOR_NUM_NOTES ? VOICEALLOCATOR_NUM_NOTES - 1 : a_note;
+    }
+}
@@ -17,240 +17,455 @@ You should have received a copy of the GNU General Public License
 along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 */
 #include "vosimlib/VoiceManager.h"
-#include "vosimlib/Command.h"
+#include "vosimlib/DSPMath.h"
+#include <thread>
 
 namespace syn
 {
     void VoiceManager::setFs(double a_newFs) {
         // Apply new sampling frequency to all voices
-        for (int i = 0; i < m_voices.size(); i++) {
-            m_voices[i].setFs(a_newFs);
+        VoiceSet& set = *m_voiceSet;
+        for (int i = 0; i < set.voices.size(); i++) {
+            set.voices[i].setFs(a_newFs);
         }
-        m_instrument.setFs(a_newFs);
+        set.instrument.setFs(a_newFs);
+        m_globalCircuit->setFs(a_newFs);
     }
 
     void VoiceManager::setTempo(double a_newTempo) {
         // Apply new tempo to all voices
-        for (int i = 0; i < m_voices.size(); i++) {
-            m_voices[i].setTempo(a_newTempo);
+        VoiceSet& set = *m_voiceSet;
+        for (int i = 0; i < set.voices.size(); i++) {
+            set.voices[i].setTempo(a_newTempo);
         }
-        m_instrument.setTempo(a_newTempo);
+        set.instrument.setTempo(a_newTempo);
+        m_globalCircuit->setTempo(a_newTempo);
     }
 
-    void VoiceManager::noteOn(int a_noteNumber, int a_velocity) {
-        int currVoiceIndex = m_lastVoiceIndex;
-        int bestVoiceIndex = -1;
-        int bestVoiceScore = 0;
-        do {
-            auto& voice = m_voices[currVoiceIndex];
-            if (!voice.isActive()) {
-                voice.noteOn(a_noteNumber, a_velocity);
-                m_lastVoiceIndex = currVoiceIndex;
-                m_voiceBirths[currVoiceIndex] = m_voiceTicks;
-                m_voiceTicks++;
-                return;
-            }
-
-            int voiceAge = m_voiceTicks - m_voiceBirths[currVoiceIndex];
-            int currVoiceScore = 0;
-            switch(m_voiceStealingPolicy) {
-            case Highest:
-                currVoiceScore -= voice.note();
-                break;
-            case Lowest:
-                currVoiceScore += voice.note();
-                break;
-            case Newest:
-                currVoiceScore -= voiceAge;
-                break;
-            case Oldest:
-            default:
-                currVoiceScore += voiceAge;
-                break;
-            }
-            currVoiceScore += voice.isNoteOn() ? 0 : 1;
-
-            if(currVoiceScore>bestVoiceScore || bestVoiceIndex==-1) {
-                bestVoiceIndex = currVoiceIndex;
-                bestVoiceScore = currVoiceScore;
-            }
-
-            currVoiceIndex++;
-            if (currVoiceIndex == m_voices.size())
-                currVoiceIndex = 0;
-        } while (currVoiceIndex != m_lastVoiceIndex);
+    void VoiceManager::setControlPeriod(int a_controlPeriod) {
+        m_controlPeriod = MAX(1, a_controlPeriod);
+        // Apply new control period to all voices
+        VoiceSet& set = *m_voiceSet;
+        for (int i = 0; i < set.voices.size(); i++) {
+            set.voices[i].setControlPeriod(m_controlPeriod);
+        }
+        set.instrument.setControlPeriod(m_controlPeriod);
+        m_globalCircuit->setControlPeriod(m_controlPeriod);
+    }
 
-        m_voices[bestVoiceIndex].noteOn(a_noteNumber, a_velocity);
-        m_lastVoiceIndex = bestVoiceIndex;
-        m_voiceBirths[bestVoiceIndex] = m_voiceTicks;
-        m_voiceTicks++;
+    void VoiceManager::noteOn(int a_noteNumber, int a_velocity) {
+        VoiceSet& set = *m_voiceSet;
+        int voiceIndex = set.allocator.oldest(VoiceAllocator::Idle);
+        if (voiceIndex < 0)
+            voiceIndex = _selectVoiceToSteal(set, VoiceAllocator::Released);
+        if (voiceIndex < 0)
+            voiceIndex = _selectVoiceToSteal(set, VoiceAllocator::Held);
+        if (voiceIndex < 0)
+            return;
+
+        set.voices[voiceIndex].noteOn(a_noteNumber, a_velocity);
+        set.allocator.hold(voiceIndex, a_noteNumber);
+        set.lastVoiceIndex = voiceIndex;
     }
 
     void VoiceManager::noteOff(int a_noteNumber) {
-        for(auto& voice : m_voices) {
-            if(voice.note() == a_noteNumber)
-                voice.noteOff();
+        VoiceSet& set = *m_voiceSet;
+        int voiceIndex;
+        while ((voiceIndex = set.allocator.firstWithNote(VoiceAllocator::Held, a_noteNumber)) >= 0) {
+            set.voices[voiceIndex].noteOff();
+            set.allocator.release(voiceIndex);
+        }
+    }
+
+    int VoiceManager::_selectVoiceToSteal(const VoiceSet& a_set, VoiceAllocator::VoiceState a_state) const {
+        switch (m_voiceStealingPolicy) {
+        case Highest:
+            return a_set.allocator.lowest(a_state);
+        case Lowest:
+            return a_set.allocator.highest(a_state);
+        case Newest:
+            return a_set.allocator.newest(a_state);
+        case Oldest:
+        default:
+            return a_set.allocator.oldest(a_state);
         }
     }
 
     void VoiceManager::sendControlChange(int a_cc, double a_value) {
         // Send control change to all voices
-        for (int i = 0; i < m_voices.size(); i++) {
-            m_voices[i].notifyMidiControlChange(a_cc, a_value);
+        VoiceSet& set = *m_voiceSet;
+        for (int i = 0; i < set.voices.size(); i++) {
+            set.voices[i].notifyMidiControlChange(a_cc, a_value);
         }
-        m_instrument.notifyMidiControlChange(a_cc, a_value);
+        set.instrument.notifyMidiControlChange(a_cc, a_value);
+        m_globalCircuit->notifyMidiControlChange(a_cc, a_value);
     }
 
     void VoiceManager::sendPitchWheelChange(double a_value) {
         // Send pitch wheel change to all voices
-        for (int i = 0; i < m_voices.size(); i++) {
-            m_voices[i].notifyPitchWheelChange(a_value);
+        VoiceSet& set = *m_voiceSet;
+        for (int i = 0; i < set.voices.size(); i++) {
+            set.voices[i].notifyPitchWheelChange(a_value);
         }
-        m_instrument.notifyPitchWheelChange(a_value);
+        set.instrument.notifyPitchWheelChange(a_value);
+        m_globalCircuit->notifyPitchWheelChange(a_value);
     }
 
     void VoiceManager::setMaxVoices(int a_newMax) {
         if (a_newMax < 1)
             a_newMax = 1;
-        if (a_newMax > MAX_VOICES)
-            a_newMax = MAX_VOICES;
 
-        m_voices.clear();
-        m_voiceBirths.clear();
-        m_lastVoiceIndex = 0;
-        m_voiceTicks = 0;
-
-        // Construct new voices
-        m_voices.resize(a_newMax);
-        m_voiceBirths.resize(a_newMax, -1);
+        // Let queued edits reach the prototype before copying it
+        _waitForActions();
+        std::unique_ptr<VoiceSet> set(new VoiceSet(m_voiceSet->instrument));
+        _buildVoices(*set, a_newMax);
+        _publish(m_voiceSet, std::move(set));
+    }
 
-        for(int i=0;i<a_newMax;i++)
+    void VoiceManager::_buildVoices(VoiceSet& a_set, int a_numVoices) const {
+        // One spare budget is shared by the voices that outgrow their own slice
+        const size_t sliceSize = m_voiceMemoryBudget + 4 * SYN_CACHE_LINE_SIZE;
+        a_set.voices.clear();
+        a_set.voiceMemory.clear();
+        a_set.memory.reset(new MemoryPool((a_numVoices + 1) * sliceSize, m_voiceMemoryHugePages));
+        a_set.voices.reserve(a_numVoices);
+        a_set.allocator.reset(a_numVoices);
+        a_set.activeVoices.reserve(a_numVoices);
+        a_set.batchStarts.reserve(a_numVoices + 1);
+
+        for(int i=0;i<a_numVoices;i++)
         {
-            m_voices[i] = m_instrument;
-            m_voices[i].setVoiceIndex(a_newMax>1 ? (i+1) * 1.0 / a_newMax : 1.0);
+            a_set.voiceMemory.emplace_back(new MemoryPool(*a_set.memory, m_voiceMemoryBudget));
+            MemoryPool::Scope scope(a_set.voiceMemory[i].get());
+            a_set.voices.emplace_back();
+            a_set.voices[i] = a_set.instrument;
+            a_set.voices[i].shareParameters(a_set.instrument);
+            a_set.voices[i].setVoiceIndex(a_numVoices>1 ? (i+1) * 1.0 / a_numVoices : 1.0);
+        }
+        a_set.voiceScratch.resize(2 * a_numVoices * m_bufferSize);
+    }
+
+    MemoryPool::Stats VoiceManager::getVoiceMemoryStats() const {
+        const MemoryPool* memory = m_voiceSet->memory.get();
+        return memory ? memory->getStats() : MemoryPool::Stats{};
+    }
+
+    vector<VoiceManager::VoiceMemoryRegion> VoiceManager::getVoiceMemoryMap() const {
+        const VoiceSet& set = *m_voiceSet;
+        vector<VoiceMemoryRegion> regions;
+        if (!set.memory)
+            return regions;
+        const MemoryPool* arena = set.memory.get();
+        regions.push_back({ -1, arena->begin(), arena->capacity(), arena->getBacking(), arena->getStats(), arena->getMemoryMap() });
+        for (int i = 0; i < set.voiceMemory.size(); i++) {
+            const MemoryPool* slice = set.voiceMemory[i].get();
+            regions.push_back({ i, slice->begin(), slice->capacity(), slice->getBacking(), slice->getStats(), slice->getMemoryMap() });
         }
+        return regions;
+    }
+
+    void VoiceManager::_waitForActions() {
+        while (!m_queuedActions.isDrained()) {
+            if (isAudioActive())
+                std::this_thread::yield();
+            else
+                onIdle();
+        }
+    }
+
+    void VoiceManager::setAudioActive(bool a_isActive) {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        m_isAudioActive.store(a_isActive, std::memory_order_release);
     }
 
     vector<int> VoiceManager::getActiveVoiceIndices() const
     {
         vector<int> voiceIndices;
-        for (int i = 0; i < m_voices.size(); i++) {
-            if (m_voices[i].isActive())
-                voiceIndices.push_back(i);
-        }
+        voiceIndices.reserve(getNumActiveVoices());
+        forEachActiveVoice([&voiceIndices](int a_voiceIndex) { voiceIndices.push_back(a_voiceIndex); });
         return voiceIndices;
     }
 
+    int VoiceManager::getNumActiveVoices() const {
+        const VoiceAllocator& allocator = m_voiceSet->allocator;
+        return allocator.count(VoiceAllocator::Held) + allocator.count(VoiceAllocator::Released);
+    }
+
     vector<int> VoiceManager::getReleasedVoiceIndices() const {
+        const VoiceAllocator& allocator = m_voiceSet->allocator;
         vector<int> voiceIndices;
-        for (int i = 0; i < m_voices.size(); i++) {
-            if (m_voices[i].isActive() && !m_voices[i].isNoteOn())
+        for (int i = 0; i < allocator.getNumVoices(); i++) {
+            if (allocator.getState(i) == VoiceAllocator::Released)
                 voiceIndices.push_back(i);
         }
         return voiceIndices;
     }
 
     vector<int> VoiceManager::getIdleVoiceIndices() const {
+        const VoiceAllocator& allocator = m_voiceSet->allocator;
         vector<int> voiceIndices;
-        for (int i = 0; i < m_voices.size(); i++) {
-            if (!m_voices[i].isActive())
+        for (int i = 0; i < allocator.getNumVoices(); i++) {
+            if (allocator.getState(i) == VoiceAllocator::Idle)
                 voiceIndices.push_back(i);
         }
         return voiceIndices;
     }
 
-    void VoiceManager::tick(const double* a_left_input, const double* a_right_input, double* a_left_output, double* a_right_output) {
-        _flushActionQueue();
+    void VoiceManager::tick(const Sample* a_left_input, const Sample* a_right_input, Sample* a_left_output, Sample* a_right_output) {
+        tick(a_left_input, a_right_input, a_left_output, a_right_output, nullptr, 0);
+    }
+
+    void VoiceManager::tick(const Sample* a_left_input, const Sample* a_right_input, Sample* a_left_output, Sample* a_right_output,
+                            const MidiEvent* a_events, int a_numEvents) {
+        _flushActionQueue(m_maxActionsPerTick);
 
         for (int j = 0; j < m_bufferSize; j++) {
             a_left_output[j] = 0;
             a_right_output[j] = 0;
         }
 
-        for (auto& voice : m_voices) {
-            if (voice.isActive()) {
-                for (int sample = 0; sample < m_bufferSize; sample += m_internalBufferSize) {
-                    ReadOnlyBuffer<double> left{a_left_input}, right{a_right_input};
-                    voice.connectInput(0, left);
-                    voice.connectInput(1, right);
-                    voice.tick();
-                    for (int j = 0; j < m_internalBufferSize; j++) {
-                        a_left_output[sample + j] += voice.readOutput(0, j);
-                        a_right_output[sample + j] += voice.readOutput(1, j);
-                    }
+        // Render up to each event, then apply it
+        int eventIndex = 0;
+        int start = 0;
+        while (start < m_bufferSize) {
+            while (eventIndex < a_numEvents && a_events[eventIndex].offset <= start)
+                _applyEvent(a_events[eventIndex++]);
+            int end = eventIndex < a_numEvents ? MIN(a_events[eventIndex].offset, m_bufferSize) : m_bufferSize;
+            _renderSegment(start, end, a_left_input, a_right_input, a_left_output, a_right_output);
+            start = end;
+        }
+        // Events past the end of the buffer are applied late rather than dropped
+        while (eventIndex < a_numEvents)
+            _applyEvent(a_events[eventIndex++]);
+
+        _renderGlobal(a_left_output, a_right_output);
+    }
+
+    void VoiceManager::_applyEvent(const MidiEvent& a_event) {
+        switch (a_event.type) {
+        case MidiEvent::NoteOn:
+            noteOn(a_event.data, static_cast<int>(a_event.value));
+            break;
+        case MidiEvent::NoteOff:
+            noteOff(a_event.data);
+            break;
+        case MidiEvent::ControlChange:
+            sendControlChange(a_event.data, a_event.value);
+            break;
+        case MidiEvent::PitchWheel:
+            sendPitchWheelChange(a_event.value);
+            break;
+        }
+    }
+
+    void VoiceManager::_renderSegment(int a_start, int a_end, const Sample* a_left_input, const Sample* a_right_input, Sample* a_left_output, Sample* a_right_output) {
+        VoiceSet& set = *m_voiceSet;
+        _collectActiveVoices(set);
+        vector<int>& activeVoices = set.activeVoices;
+        vector<int>& batchStarts = set.batchStarts;
+        int numActiveVoices = static_cast<int>(activeVoices.size());
+
+        // Voices share their parameters, and Unit::onParamChange_ may write to them, so voices catch up on
+        // parameter changes here rather than from the worker threads.
+        for (int voiceIndex : activeVoices)
+            set.voices[voiceIndex].updateParameters();
+
+        // Group voices that can be ticked in lockstep
+        batchStarts.clear();
+        for (int i = 0; i < numActiveVoices; i++) {
+            int batchStart = batchStarts.empty() ? -1 : batchStarts.back();
+            if (!m_laneBatching || batchStart < 0 || i - batchStart == SYN_LANES
+                || !set.voices[activeVoices[batchStart]].isLaneCompatible(set.voices[activeVoices[i]]))
+                batchStarts.push_back(i);
+        }
+        int numBatches = static_cast<int>(batchStarts.size());
+        batchStarts.push_back(numActiveVoices);
+
+        // Batches are independent, so they can be rendered in any order and on any thread.
+        auto renderBatch = [this, &activeVoices, &batchStarts, a_start, a_end, a_left_input, a_right_input](int a_batchIndex) {
+            int batchStart = batchStarts[a_batchIndex];
+            _renderVoices(&activeVoices[batchStart], batchStarts[a_batchIndex + 1] - batchStart, a_start, a_end, a_left_input, a_right_input);
+        };
+        if (m_workerPool.getNumThreads() > 0 && numBatches > 1 && numActiveVoices * (a_end - a_start) >= m_parallelVoiceThreshold)
+            m_workerPool.parallelFor(numBatches, renderBatch);
+        else
+            for (int i = 0; i < numBatches; i++)
+                renderBatch(i);
+
+        // Mix in a fixed order, so the result does not depend on which thread rendered which voice.
+        for (int voiceIndex : activeVoices) {
+            const Sample* left = &set.voiceScratch[2 * voiceIndex * m_bufferSize];
+            const Sample* right = left + m_bufferSize;
+            for (int j = a_start; j < a_end; j++) {
+                a_left_output[j] += left[j];
+                a_right_output[j] += right[j];
+            }
+        }
+    }
+
+    void VoiceManager::_collectActiveVoices(VoiceSet& a_set) {
+        // Only the voices that are playing are checked, and each check is O(1) (see Circuit::isActive)
+        a_set.activeVoices.clear();
+        for (VoiceAllocator::VoiceState state : { VoiceAllocator::Held, VoiceAllocator::Released }) {
+            int voiceIndex = a_set.allocator.oldest(state);
+            while (voiceIndex >= 0) {
+                const int nextVoiceIndex = a_set.allocator.next(voiceIndex);
+                if (a_set.voices[voiceIndex].isActive())
+                    a_set.activeVoices.push_back(voiceIndex);
+                else
+                    a_set.allocator.free(voiceIndex);
+                voiceIndex = nextVoiceIndex;
+            }
+        }
+    }
+
+    void VoiceManager::_renderVoices(const int* a_voiceIndices, int a_numVoices, int a_start, int a_end, const Sample* a_left_input, const Sample* a_right_input) {
+        VoiceSet& set = *m_voiceSet;
+        Circuit* voices[SYN_LANES];
+        for (int i = 0; i < a_numVoices; i++)
+            voices[i] = &set.voices[a_voiceIndices[i]];
+        for (int sample = a_start; sample < a_end; sample += m_internalBufferSize) {
+            const int numSamples = MIN(m_internalBufferSize, a_end - sample);
+            ReadOnlyBuffer<Sample> leftInput{a_left_input + sample}, rightInput{a_right_input + sample};
+            for (int i = 0; i < a_numVoices; i++) {
+                voices[i]->connectInput(0, leftInput);
+                voices[i]->connectInput(1, rightInput);
+            }
+            Circuit::tickLanes(voices, a_numVoices, numSamples);
+            for (int i = 0; i < a_numVoices; i++) {
+                Sample* left = &set.voiceScratch[2 * a_voiceIndices[i] * m_bufferSize];
+                Sample* right = left + m_bufferSize;
+                for (int j = 0; j < numSamples; j++) {
+                    left[sample + j] = voices[i]->readOutput(0, j);
+                    right[sample + j] = voices[i]->readOutput(1, j);
                 }
             }
         }
     }
 
+    void VoiceManager::_renderGlobal(Sample* a_left_output, Sample* a_right_output) {
+        Circuit& global = *m_globalCircuit;
+        for (int sample = 0; sample < m_bufferSize; sample += m_internalBufferSize) {
+            const int numSamples = MIN(m_internalBufferSize, m_bufferSize - sample);
+            // The inputs are fully read before the outputs are copied back, so the mix can be processed in place
+            ReadOnlyBuffer<Sample> leftInput{a_left_output + sample}, rightInput{a_right_output + sample};
+            global.connectInput(0, leftInput);
+            global.connectInput(1, rightInput);
+            global.tick(numSamples);
+            for (int j = 0; j < numSamples; j++) {
+                a_left_output[sample + j] = global.readOutput(0, j);
+                a_right_output[sample + j] = global.readOutput(1, j);
+            }
+        }
+    }
+
+    void VoiceManager::_resizeScratchBuffers() {
+        m_voiceSet->voiceScratch.resize(2 * m_voiceSet->voices.size() * m_bufferSize);
+    }
+
     int VoiceManager::getNewestVoiceIndex() const {
-        return m_lastVoiceIndex;
+        return m_voiceSet->lastVoiceIndex;
     }
 
     int VoiceManager::getMaxVoices() const {
-        return int(m_voices.size());
+        return int(m_voiceSet->voices.size());
     }
 
     void VoiceManager::onIdle() {
-        _flushActionQueue();
-    }
-
-    bool VoiceManager::queueAction(Command* a_msg) {
-        if(!m_queuedActions.write_available()){
-            return false;
+        {
+            // The queue has a single consumer, which is the real-time thread whenever audio is active
+            std::lock_guard<std::mutex> lock(m_idleMutex);
+            if (!isAudioActive())
+                _flushActionQueue(m_queuedActions.capacity());
         }
-        m_queuedActions.push(a_msg);
-        return true;
+        m_queuedActions.collect();
     }
 
-    void VoiceManager::_flushActionQueue() {
-        Command* msg;
-        while (m_queuedActions.pop(msg)) {
-            (*msg)();
-            delete msg;
-        }
+    void VoiceManager::_flushActionQueue(int a_maxActions) {
+        m_queuedActions.process(a_maxActions);
     }
 
     Circuit& VoiceManager::getPrototypeCircuit() {
-        return m_instrument;
+        return m_voiceSet->instrument;
     }
 
     const Circuit& VoiceManager::getPrototypeCircuit() const {
-        return m_instrument;
+        return m_voiceSet->instrument;
+    }
+
+    int VoiceManager::addUnit(Unit* a_unit) {
+        VoiceSet& set = *m_voiceSet;
+        int unitId = set.instrument.addUnit(a_unit);
+        for (Circuit& voice : set.voices) {
+            MemoryPool::Scope scope(voice.getMemoryPool());
+            voice.addUnit(a_unit->clone(), unitId);
+            voice.getUnit(unitId).shareParameters(*a_unit);
+        }
+        return unitId;
     }
 
     Circuit& VoiceManager::getVoiceCircuit(int a_voiceId)
     {
-        return a_voiceId<0 ? m_instrument : m_voices[a_voiceId];
+        return a_voiceId<0 ? m_voiceSet->instrument : m_voiceSet->voices[a_voiceId];
     }
 
     const Circuit& VoiceManager::getVoiceCircuit(int a_voiceId) const
     {
-        return a_voiceId<0 ? m_instrument : m_voices[a_voiceId];
+        return a_voiceId<0 ? m_voiceSet->instrument : m_voiceSet->voices[a_voiceId];
     }
 
     void VoiceManager::setPrototypeCircuit(const Circuit& a_circ) {
-        m_instrument = Circuit{ a_circ };
-        setMaxVoices(int(m_voices.size()));
+        _waitForActions();
+        std::unique_ptr<VoiceSet> set(new VoiceSet(a_circ));
+        set->instrument.setBufferSize(m_internalBufferSize);
+        set->instrument.setControlPeriod(m_controlPeriod);
+        _buildVoices(*set, getMaxVoices());
+        _publish(m_voiceSet, std::move(set));
+    }
+
+    void VoiceManager::setGlobalCircuit(const Circuit& a_circ) {
+        std::unique_ptr<Circuit> global(new Circuit(a_circ));
+        global->setBufferSize(m_internalBufferSize);
+        global->setControlPeriod(m_controlPeriod);
+        _publish(m_globalCircuit, std::move(global));
+    }
+
+    void VoiceManager::resetGlobalCircuit() {
+        std::unique_ptr<Circuit> global = _makeDefaultGlobalCircuit();
+        global->setFs(m_globalCircuit->fs());
+        global->setTempo(m_globalCircuit->tempo());
+        global->setBufferSize(m_internalBufferSize);
+        global->setControlPeriod(m_controlPeriod);
+        _publish(m_globalCircuit, std::move(global));
+    }
+
+    std::unique_ptr<Circuit> VoiceManager::_makeDefaultGlobalCircuit() {
+        std::unique_ptr<Circuit> global(new Circuit("global"));
+        global->beginEdit();
+        global->connectInternal(global->getInputUnitId(), 0, global->getOutputUnitId(), 0);
+        global->connectInternal(global->getInputUnitId(), 1, global->getOutputUnitId(), 1);
+        global->endEdit();
+        return global;
     }
 
     Unit& VoiceManager::getUnit(int a_id, int a_voiceInd) {
         if (a_voiceInd >= 0) {
-            return m_voices[a_voiceInd].getUnit(a_id);
+            return m_voiceSet->voices[a_voiceInd].getUnit(a_id);
         }
-        return m_instrument.getUnit(a_id);
+        return m_voiceSet->instrument.getUnit(a_id);
     }
 
     const Unit& VoiceManager::getUnit(int a_id, int a_voiceInd) const {
         if (a_voiceInd >= 0) {
-            return m_voices[a_voiceInd].getUnit(a_id);
+            return m_voiceSet->voices[a_voiceInd].getUnit(a_id);
         }
-        return m_instrument.getUnit(a_id);
+        return m_voiceSet->instrument.getUnit(a_id);
     }
 
     void VoiceManager::setBufferSize(int a_bufferSize) {
         m_bufferSize = a_bufferSize > 0 ? a_bufferSize : 1;
         setInternalBufferSize(m_internalBufferSize);
+        _resizeScratchBuffers();
     }
 
     void VoiceManager::setInternalBufferSize(int a_internalBufferSize)
@@ -281,9 +496,11 @@ namespace syn
         }
 
         // Propogate the new buffer size   
-        for (int i = 0; i < m_voices.size(); i++) {
-            m_voices[i].setBufferSize(m_internalBufferSize);
+        VoiceSet& set = *m_voiceSet;
+        for (int i = 0; i < set.voices.size(); i++) {
+            set.voices[i].setBufferSize(m_internalBufferSize);
         }
-        m_instrument.setBufferSize(m_internalBufferSize);
+        set.instrument.setBufferSize(m_internalBufferSize);
+        m_globalCircuit->setBufferSize(m_internalBufferSize);
     }
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "vosimlib/WorkerPool.h"
+#include <chrono>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYN_CPU_RELAX() _mm_pause()
+#else
+#define SYN_CPU_RELAX()
+#endif
+
+namespace
+{
+    const int c_indexBits = 20;
+    const int c_countBits = 20;
+    const uint64_t c_indexMask = (uint64_t(1) << c_indexBits) - 1;
+    const uint64_t c_countMask = (uint64_t(1) << c_countBits) - 1;
+
+    const int c_spinIterations = 4096; ///< Number of busy-wait iterations before an idle worker starts yielding
+    const int c_yieldIterations = 256; ///< Number of yields before an idle worker goes to sleep
+    const std::chrono::milliseconds c_sleepTimeout{2}; ///< Upper bound on a missed wake-up
+
+    uint64_t packWork(uint64_t a_generation, uint64_t a_count, uint64_t a_index) {
+        return (a_generation << (c_indexBits + c_countBits)) | (a_count << c_indexBits) | a_index;
+    }
+
+    uint64_t workGeneration(uint64_t a_work) { return a_work >> (c_indexBits + c_countBits); }
+    uint64_t workCount(uint64_t a_work) { return (a_work >> c_indexBits) & c_countMask; }
+    uint64_t workIndex(uint64_t a_work) { return a_work & c_indexMask; }
+
+    bool pinThread(std::thread& a_thread, int a_cpu) {
+#if defined(_WIN32)
+        return SetThreadAffinityMask(a_thread.native_handle(), DWORD_PTR(1) << a_cpu) != 0;
+#elif defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(a_cpu, &cpus);
+        return pthread_setaffinity_np(a_thread.native_handle(), sizeof(cpus), &cpus) == 0;
+#else
+        return false;
+#endif
+    }
+}
+
+namespace syn
+{
+    WorkerPool::WorkerPool(int a_numThreads) :
+        m_numThreads(0),
+        m_work(0),
+        m_numCompleted(0),
+        m_isBusy(false),
+        m_quit(false),
+        m_numSleeping(0),
+        m_func(nullptr),
+        m_context(nullptr)
+    {
+        _startThreads(a_numThreads);
+    }
+
+    WorkerPool::~WorkerPool() { _stopThreads(); }
+
+    void WorkerPool::setNumThreads(int a_numThreads)
+    {
+        if (a_numThreads == getNumThreads())
+            return;
+        _lock();
+        _stopThreads();
+        _startThreads(a_numThreads);
+        _unlock();
+    }
+
+    bool WorkerPool::setAffinity(const std::vector<int>& a_cpus)
+    {
+        _lock();
+        m_affinity = a_cpus;
+        bool success = _applyAffinity();
+        _unlock();
+        return success;
+    }
+
+    int WorkerPool::getNumThreads() const { return m_numThreads.load(std::memory_order_relaxed); }
+
+    void WorkerPool::run(int a_numTasks, TaskFunc a_func, void* a_context)
+    {
+        bool wasBusy = false;
+        if (a_numTasks <= 1 || a_numTasks > c_countMask || !m_isBusy.compare_exchange_strong(wasBusy, true, std::memory_order_acquire))
+        {
+            for (int i = 0; i < a_numTasks; i++)
+                a_func(a_context, i);
+            return;
+        }
+        if (m_threads.empty())
+        {
+            m_isBusy.store(false, std::memory_order_release);
+            for (int i = 0; i < a_numTasks; i++)
+                a_func(a_context, i);
+            return;
+        }
+
+        // Publish the new generation. The release store makes the task description visible to any worker
+        // that claims one of its tasks.
+        m_func = a_func;
+        m_context = a_context;
+        m_numCompleted.store(0, std::memory_order_relaxed);
+        uint64_t generation = workGeneration(m_work.load(std::memory_order_relaxed)) + 1;
+        m_work.store(packWork(generation, a_numTasks, 0), std::memory_order_seq_cst);
+        if (m_numSleeping.load(std::memory_order_seq_cst) > 0)
+            m_wakeCondition.notify_all();
+
+        while (_runTask(generation)) {}
+        while (m_numCompleted.load(std::memory_order_acquire) < a_numTasks)
+            SYN_CPU_RELAX();
+
+        m_isBusy.store(false, std::memory_order_release);
+    }
+
+    bool WorkerPool::_runTask(uint64_t a_generation)
+    {
+        uint64_t work = m_work.load(std::memory_order_acquire);
+        while (true)
+        {
+            if (workGeneration(work) != a_generation || workIndex(work) >= workCount(work))
+                return false;
+            if (m_work.compare_exchange_weak(work, work + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+                break;
+        }
+        // The caller waits for this task to complete before publishing anything else, so the task
+        // description cannot change under us.
+        m_func(m_context, static_cast<int>(workIndex(work)));
+        m_numCompleted.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    void WorkerPool::_workerLoop()
+    {
+        uint64_t lastGeneration = workGeneration(m_work.load(std::memory_order_acquire));
+        int idleIterations = 0;
+        while (!m_quit.load(std::memory_order_acquire))
+        {
+            uint64_t generation = workGeneration(m_work.load(std::memory_order_acquire));
+            if (generation != lastGeneration)
+            {
+                lastGeneration = generation;
+                while (_runTask(generation)) {}
+                idleIterations = 0;
+                continue;
+            }
+
+            idleIterations++;
+            if (idleIterations < c_spinIterations)
+            {
+                SYN_CPU_RELAX();
+            }
+            else if (idleIterations < c_spinIterations + c_yieldIterations)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                // The publishing thread never takes the mutex, so a wake-up can be missed. The timeout bounds how
+                // long that can delay this worker, and the publishing thread never waits on a sleeping worker.
+                std::unique_lock<std::mutex> lock(m_sleepMutex);
+                m_numSleeping.fetch_add(1, std::memory_order_seq_cst);
+                m_wakeCondition.wait_for(lock, c_sleepTimeout, [this, lastGeneration]() {
+                    return m_quit.load(std::memory_order_acquire) || workGeneration(m_work.load(std::memory_order_acquire)) != lastGeneration;
+                });
+                m_numSleeping.fetch_sub(1, std::memory_order_seq_cst);
+            }
+        }
+    }
+
+    void WorkerPool::_lock()
+    {
+        bool wasBusy = false;
+        while (!m_isBusy.compare_exchange_weak(wasBusy, true, std::memory_order_acquire))
+        {
+            wasBusy = false;
+            std::this_thread::yield();
+        }
+    }
+
+    void WorkerPool::_unlock() { m_isBusy.store(false, std::memory_order_release); }
+
+    void WorkerPool::_startThreads(int a_numThreads)
+    {
+        m_quit.store(false);
+        for (int i = 0; i < a_numThreads; i++)
+            m_threads.emplace_back(&WorkerPool::_workerLoop, this);
+        m_numThreads.store(a_numThreads, std::memory_order_relaxed);
+        _applyAffinity();
+    }
+
+    bool WorkerPool::_applyAffinity()
+    {
+        if (m_affinity.empty())
+            return true;
+        bool success = true;
+        for (int i = 0; i < m_threads.size(); i++)
+            success &= pinThread(m_threads[i], m_affinity[i % m_affinity.size()]);
+        return success;
+    }
+
+    void WorkerPool::_stopThreads()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_quit.store(true);
+        }
+        m_wakeCondition.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+        m_threads.clear();
+        m_numThreads.store(0, std::memory_order_relaxed);
+    }
+}
@@ -17,44 +17,333 @@ You should have received a copy of the GNU General Public License
 along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 */
 #include "vosimlib/tables.h"
+#include <Eigen/Core>
+#include <unsupported/Eigen/FFT>
 #include <math.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    std::atomic<bool> g_backgroundGeneration{false};
+    std::mutex g_cacheDirectoryMutex;
+    std::string g_cacheDirectory;
+
+    /// 64 bit FNV-1a hash
+    uint64_t hashBytes(const void* a_data, size_t a_size, uint64_t a_hash = 14695981039346656037ull) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(a_data);
+        for (size_t i = 0; i < a_size; i++) {
+            a_hash ^= bytes[i];
+            a_hash *= 1099511628211ull;
+        }
+        return a_hash;
+    }
+
+    const char g_cacheMagic[4] = {'V', 'R', 'S', 'T'};
+
+    /// Taps of a SincFilterBank are processed a few at a time, in SIMD registers
+    typedef Eigen::Array<syn::Sample, 4, 1> TapPacket;
+    typedef Eigen::Map<const TapPacket> TapPacketMap;
+}
 
 namespace syn
 {
-    ResampledTable::ResampledTable(const double* a_data, int a_size, const BlimpTable& a_blimp_table_online, const BlimpTable& a_blimp_table_offline) :
-        NormalTable(a_data, a_size),
-        m_num_resampled_tables(0),
-        m_resampled_sizes(0),
-        m_resampled_tables(0),
-        m_blimp_table_online(a_blimp_table_online),
-        m_blimp_table_offline(a_blimp_table_offline)
+    ResampledTable::ResampledTable(const Sample* a_data, int a_size, const BlimpTable& a_blimp_table_online, const BlimpTable& a_blimp_table_offline, int a_mip_levels_per_octave) :
+        NormalTable(a_data, a_size)
+    {
+        _build_payload(a_blimp_table_online, a_blimp_table_offline, a_mip_levels_per_octave);
+    }
+
+    ResampledTable::ResampledTable(const TableStorage& a_storage, const BlimpTable& a_blimp_table_online, const BlimpTable& a_blimp_table_offline, int a_mip_levels_per_octave) :
+        NormalTable(a_storage)
     {
-        _resample_tables();
+        _build_payload(a_blimp_table_online, a_blimp_table_offline, a_mip_levels_per_octave);
+    }
+
+    void ResampledTable::_build_payload(const BlimpTable& a_blimp_table_online, const BlimpTable& a_blimp_table_offline, int a_mip_levels_per_octave) {
+        std::shared_ptr<Payload> payload = std::make_shared<Payload>(m_data, m_size, a_blimp_table_online, a_blimp_table_offline, a_mip_levels_per_octave);
+        // The mipmap stands in for the downsampled tables until they are ready, so it is built first
+        if (backgroundGeneration())
+            payload->generator = std::thread(&Payload::generateTables, payload.get());
+        else
+            payload->generateTables();
+        m_payload = std::move(payload);
     }
 
-    void ResampledTable::_resample_tables() {
+    std::shared_ptr<const std::vector<Sample>> decodeTable(const TableStorage& a_storage) {
+        switch (a_storage.format) {
+            case TableStorage::Float32:
+                if (sizeof(Sample) == sizeof(float))
+                    return nullptr;
+                {
+                    const float* data = static_cast<const float*>(a_storage.data);
+                    return std::make_shared<const std::vector<Sample>>(data, data + a_storage.size);
+                }
+            case TableStorage::Int16: {
+                const int16_t* data = static_cast<const int16_t*>(a_storage.data);
+                std::shared_ptr<std::vector<Sample>> decoded = std::make_shared<std::vector<Sample>>(a_storage.size);
+                for (int i = 0; i < a_storage.size; i++)
+                    (*decoded)[i] = a_storage.offset + a_storage.scale * data[i];
+                return decoded;
+            }
+            case TableStorage::Native:
+            default:
+                return nullptr;
+        }
+    }
+
+    ResampledTable::Payload::Payload(const Sample* a_data, int a_size, const BlimpTable& a_blimp_table_online, const BlimpTable& a_blimp_table_offline, int a_mip_levels_per_octave) :
+        data(a_data),
+        size(a_size),
+        blimp_table_online(a_blimp_table_online),
+        blimp_table_offline(a_blimp_table_offline),
+        num_resampled_tables(0),
+        mip_levels_per_octave(MAX<int>(1, a_mip_levels_per_octave)),
+        mip_top_period(0.0),
+        cache_directory(cacheDirectory()),
+        ready(false)
+    {
+        for (int band = 0; band <= SINC_FILTER_BANDS_PER_OCTAVE; band++)
+            sinc_banks.emplace_back(blimp_table_online, pow(2.0, -band * 1.0 / SINC_FILTER_BANDS_PER_OCTAVE));
+
         /* Construct resampled tables at ratios of powers of K */
-        m_num_resampled_tables = MIN<int>(6, MAX<int>(1, log2(1.0*m_size) - 2));
-        m_resampled_sizes.resize(m_num_resampled_tables);
-        m_resampled_tables.resize(m_num_resampled_tables);
-        m_resampled_sizes[0] = m_size;
-        m_resampled_tables[0] = std::vector<double>(m_data, m_data + m_size);
-        int currsize = m_size/2;
-        for (int i = 1; i < m_num_resampled_tables; i++) {
-            m_resampled_sizes[i] = currsize;
-            m_resampled_tables[i].resize(currsize);
-            resample_table(m_data, m_size, &m_resampled_tables[i][0], m_resampled_sizes[i], m_blimp_table_offline);
+        num_resampled_tables = MIN<int>(6, MAX<int>(1, log2(1.0*size) - 2));
+        resampled_sizes.resize(num_resampled_tables);
+        resampled_tables.resize(num_resampled_tables);
+        resampled_sizes[0] = size;
+        resampled_tables[0] = std::vector<Sample>(data, data + size);
+        int currsize = size/2;
+        for (int i = 1; i < num_resampled_tables; i++) {
+            resampled_sizes[i] = currsize;
+            resampled_tables[i].resize(currsize);
             currsize /= 2;
         }
+
+        buildMipmaps();
+    }
+
+    ResampledTable::Payload::~Payload() {
+        if (generator.joinable())
+            generator.join();
+    }
+
+    void ResampledTable::setBackgroundGeneration(bool a_background) {
+        g_backgroundGeneration.store(a_background);
+    }
+
+    bool ResampledTable::backgroundGeneration() {
+        return g_backgroundGeneration.load();
+    }
+
+    void ResampledTable::setCacheDirectory(const std::string& a_directory) {
+        std::lock_guard<std::mutex> lock(g_cacheDirectoryMutex);
+        g_cacheDirectory = a_directory;
+    }
+
+    std::string ResampledTable::cacheDirectory() {
+        std::lock_guard<std::mutex> lock(g_cacheDirectoryMutex);
+        return g_cacheDirectory;
+    }
+
+    uint64_t ResampledTable::cacheKey() const {
+        return m_payload->cacheKey();
+    }
+
+    uint64_t ResampledTable::Payload::cacheKey() const {
+        const int header[] = {RESAMPLED_TABLE_CACHE_VERSION, static_cast<int>(sizeof(Sample)), size, num_resampled_tables,
+            blimp_table_offline.m_size, blimp_table_offline.taps, blimp_table_offline.res};
+        uint64_t hash = hashBytes(header, sizeof(header));
+        hash = hashBytes(data, size * sizeof(Sample), hash);
+        return hashBytes(blimp_table_offline.data(), blimp_table_offline.m_size * sizeof(Sample), hash);
+    }
+
+    void ResampledTable::waitUntilReady() const {
+        if (isReady())
+            return;
+        std::unique_lock<std::mutex> lock(m_payload->ready_mutex);
+        m_payload->ready_cond.wait(lock, [this]() { return isReady(); });
+    }
+
+    void ResampledTable::Payload::generateTables() {
+        std::string path;
+        if (!cache_directory.empty()) {
+            std::ostringstream name;
+            name << cache_directory << "/resampled_table_" << std::hex << cacheKey() << ".bin";
+            path = name.str();
+        }
+
+        if (path.empty() || !loadCache(path)) {
+            // Each table has half the samples of the previous one, but its filter has twice the taps, so they
+            // all cost about the same. Threads take them one at a time.
+            std::atomic<int> next_table(1);
+            auto resample = [this, &next_table]() {
+                for (int i = next_table++; i < num_resampled_tables; i = next_table++)
+                    resample_table(data, size, &resampled_tables[i][0], resampled_sizes[i], blimp_table_offline);
+            };
+            const int num_threads = MIN<int>(num_resampled_tables - 1, std::thread::hardware_concurrency());
+            std::vector<std::thread> threads;
+            for (int i = 1; i < num_threads; i++)
+                threads.emplace_back(resample);
+            resample();
+            for (std::thread& thread : threads)
+                thread.join();
+            if (!path.empty())
+                saveCache(path);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            ready.store(true, std::memory_order_release);
+        }
+        ready_cond.notify_all();
+    }
+
+    bool ResampledTable::Payload::loadCache(const std::string& a_path) {
+        std::ifstream file(a_path, std::ios::binary);
+        if (!file)
+            return false;
+        char magic[sizeof(g_cacheMagic)];
+        uint64_t key = 0;
+        int num_tables = 0;
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char*>(&key), sizeof(key));
+        file.read(reinterpret_cast<char*>(&num_tables), sizeof(num_tables));
+        if (!file || !std::equal(magic, magic + sizeof(magic), g_cacheMagic) || key != cacheKey() || num_tables != num_resampled_tables)
+            return false;
+        // Read into a copy, so that a truncated file does not leave the tables half overwritten
+        std::vector<std::vector<Sample>> tables(resampled_tables);
+        for (int i = 1; i < num_resampled_tables; i++) {
+            int table_size = 0;
+            file.read(reinterpret_cast<char*>(&table_size), sizeof(table_size));
+            if (!file || table_size != resampled_sizes[i])
+                return false;
+            file.read(reinterpret_cast<char*>(&tables[i][0]), table_size * sizeof(Sample));
+        }
+        if (!file)
+            return false;
+        resampled_tables.swap(tables);
+        return true;
+    }
+
+    void ResampledTable::Payload::saveCache(const std::string& a_path) const {
+        // Write to a temporary file first, so that other processes never read a partial cache file
+        std::ostringstream temp_path;
+        temp_path << a_path << "." << std::this_thread::get_id() << ".tmp";
+        {
+            std::ofstream file(temp_path.str(), std::ios::binary | std::ios::trunc);
+            if (!file)
+                return;
+            const uint64_t key = cacheKey();
+            file.write(g_cacheMagic, sizeof(g_cacheMagic));
+            file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+            file.write(reinterpret_cast<const char*>(&num_resampled_tables), sizeof(num_resampled_tables));
+            for (int i = 1; i < num_resampled_tables; i++) {
+                file.write(reinterpret_cast<const char*>(&resampled_sizes[i]), sizeof(resampled_sizes[i]));
+                file.write(reinterpret_cast<const char*>(&resampled_tables[i][0]), resampled_sizes[i] * sizeof(Sample));
+            }
+            if (!file) {
+                file.close();
+                std::remove(temp_path.str().c_str());
+                return;
+            }
+        }
+        if (std::rename(temp_path.str().c_str(), a_path.c_str()) != 0)
+            std::remove(temp_path.str().c_str());
+    }
+
+    void ResampledTable::Payload::buildMipmaps() {
+        Eigen::FFT<double> fft;
+        fft.SetFlag(fft.HalfSpectrum);
+        std::vector<double> table(data, data + size);
+        std::vector<std::complex<double>> spectrum;
+        fft.fwd(spectrum, table);
+
+        int max_size = 1;
+        while (max_size < size)
+            max_size *= 2;
+        // The harmonic at the Nyquist frequency of the table is ambiguous, so it is never kept
+        const int max_harmonics = MAX<int>(1, (size - 1) / 2);
+        mip_top_period = 2.0 * max_harmonics;
+
+        mip_offsets.clear();
+        mip_sizes.clear();
+        mip_harmonics.clear();
+        for (int level = 0; ; level++) {
+            const int harmonics = MAX<int>(1, max_harmonics * pow(2.0, -level * 1.0 / mip_levels_per_octave));
+            int level_size = MIPMAP_MIN_LEVEL_SIZE;
+            while (level_size < MIPMAP_OVERSAMPLING * harmonics && level_size < max_size)
+                level_size *= 2;
+            mip_offsets.push_back(mip_offsets.empty() ? 0 : mip_offsets.back() + mip_sizes.back());
+            mip_sizes.push_back(level_size);
+            mip_harmonics.push_back(harmonics);
+            if (harmonics == 1)
+                break;
+        }
+
+        mip_data.resize(mip_offsets.back() + mip_sizes.back());
+        std::vector<std::complex<double>> level_spectrum;
+        std::vector<double> level_table;
+        for (int level = 0; level < static_cast<int>(mip_sizes.size()); level++) {
+            const int level_size = mip_sizes[level];
+            // The inverse transform divides by the new size, so rescale the spectrum to keep the amplitude
+            const double scale = level_size * 1.0 / size;
+            level_spectrum.assign(level_size / 2 + 1, 0.0);
+            for (int h = 0; h <= MIN<int>(mip_harmonics[level], level_size / 2 - 1); h++)
+                level_spectrum[h] = spectrum[h] * scale;
+            fft.inv(level_table, level_spectrum, level_size);
+            std::copy(level_table.begin(), level_table.end(), mip_data.begin() + mip_offsets[level]);
+        }
     }
 
     double ResampledTable::getResampled(double a_phase, double a_period) const {
+        if (!isReady())
+            return getMipmapped(a_phase, a_period);
+        const Payload& payload = *m_payload;
         auto ratio = a_period / m_size;
-        int table_index = CLAMP<int>(floor(-log2(ratio)), 0, m_num_resampled_tables-1);
-        return getresampled_single(&m_resampled_tables[table_index][0], m_resampled_sizes[table_index], a_phase, a_period, m_blimp_table_online);
+        int table_index = CLAMP<int>(floor(-log2(ratio)), 0, payload.num_resampled_tables-1);
+        const Sample* table = &payload.resampled_tables[table_index][0];
+        const int size = payload.resampled_sizes[table_index];
+        // Widest band whose cutoff stays below the new Nyquist frequency
+        const double cutoff = MIN<double>(1.0, a_period / size);
+        const int band = static_cast<int>(ceil(-SINC_FILTER_BANDS_PER_OCTAVE * log2(cutoff) - 1e-9));
+        if (band < static_cast<int>(payload.sinc_banks.size()))
+            return getresampled_single(table, size, a_phase, payload.sinc_banks[band]);
+        // Only the smallest table is played fast enough to need a lower cutoff than the banks provide
+        return getresampled_single(table, size, a_phase, a_period, payload.blimp_table_online);
+    }
+
+    SincFilterBank::SincFilterBank(const BlimpTable& a_blimp_table, double a_cutoff, int a_num_phases, int a_num_taps) :
+        m_num_phases(MAX<int>(1, a_num_phases)),
+        m_num_taps(0),
+        m_cutoff(a_cutoff)
+    {
+        const double support = (a_blimp_table.m_size - 1) * 1.0 / a_blimp_table.res; // zero crossings on each side
+        int num_taps = a_num_taps > 0 ? a_num_taps : 2 * static_cast<int>(ceil(support / m_cutoff));
+        const int packet_size = TapPacket::SizeAtCompileTime;
+        num_taps = MIN<int>(SINC_FILTER_MAX_TAPS, (num_taps + packet_size - 1) / packet_size * packet_size);
+        m_num_taps = num_taps;
+
+        const double step = a_blimp_table.res * m_cutoff;
+        m_taps.resize((m_num_phases + 1) * m_num_taps);
+        for (int phase = 0; phase <= m_num_phases; phase++) {
+            Sample* taps = &m_taps[phase * m_num_taps];
+            const double offset = phase * 1.0 / m_num_phases;
+            double sum = 0.0;
+            for (int i = 0; i < m_num_taps; i++) {
+                // Tap i reads the sample m_num_taps/2 - 1 - i places before the one the offset is relative to
+                const double filt_phase = std::abs(m_num_taps / 2 - 1 - i + offset) * step;
+                const double tap = filt_phase < a_blimp_table.m_size - 1 ? a_blimp_table.lerp(filt_phase) : 0.0;
+                taps[i] = tap;
+                sum += tap;
+            }
+            for (int i = 0; i < m_num_taps; i++)
+                taps[i] = taps[i] / sum;
+        }
     }
 
-    void resample_table(const double* a_table, int a_size, double* a_new_table, double a_new_period, const BlimpTable& a_blimp_table, bool a_preserve_amplitude) {
+    void resample_table(const Sample* a_table, int a_size, Sample* a_new_table, double a_new_period, const BlimpTable& a_blimp_table, bool a_preserve_amplitude) {
         double phase_step = 1. / a_new_period;
         double input_max = 0.0, input_min = 0.0;
         double output_max = 0.0, output_min = 0.0;
@@ -62,16 +351,16 @@ namespace syn
         for (int i = 0; i < new_size; i++) {
             a_new_table[i] = getresampled_single(a_table, a_size, phase_step*i, a_new_period, a_blimp_table);
             if (a_preserve_amplitude) {
-                output_min = i == 0 ? a_new_table[i] : syn::MIN(output_min, a_new_table[i]);
-                output_max = i == 0 ? a_new_table[i] : syn::MAX(output_max, a_new_table[i]);
+                output_min = i == 0 ? a_new_table[i] : syn::MIN<double>(output_min, a_new_table[i]);
+                output_max = i == 0 ? a_new_table[i] : syn::MAX<double>(output_max, a_new_table[i]);
             }
         }
         /* normalize */
         if (a_preserve_amplitude) {
             for (int i = 0; i < a_size; i++)
             {
-                input_min = i == 0 ? a_table[i] : syn::MIN(input_min, a_table[i]);
-                input_max = i == 0 ? a_table[i] : syn::MAX(input_max, a_table[i]);
+                input_min = i == 0 ? a_table[i] : syn::MIN<double>(input_min, a_table[i]);
+                input_max = i == 0 ? a_table[i] : syn::MAX<double>(input_max, a_table[i]);
             }
             double scale = (output_max - output_min) / (input_max - input_min);
             for (int i = 0; i < new_size; i++) {
@@ -80,11 +369,44 @@ namespace syn
         }
     }
 
-    void fft_resample_table(const double* table, int size, double* resampled_table, double period)
+    void fft_resample_table(const Sample* table, int size, Sample* resampled_table, double period)
     {
     }
 
-    double getresampled_single(const double* table, int size, double phase, double new_period, const BlimpTable& blimp_table) {
+    double getresampled_single(const Sample* table, int size, double phase, const SincFilterBank& bank) {
+        const int num_taps = bank.numTaps();
+        phase = WRAP(phase, 1.0) * size;
+        int index = static_cast<int>(phase);
+        const double bank_phase = (phase - index) * bank.numPhases();
+        const int bank_index = MIN<int>(static_cast<int>(bank_phase), bank.numPhases() - 1);
+        index = index == size ? 0 : index;
+
+        // Read the taps straight from the table, unless they wrap around its end
+        int first = index - num_taps / 2 + 1;
+        const Sample* samples = table + first;
+        Sample wrapped[SINC_FILTER_MAX_TAPS];
+        if (first < 0 || first + num_taps > size) {
+            first = (first % size + size) % size;
+            for (int i = 0; i < num_taps; i++) {
+                wrapped[i] = table[first];
+                first = first == size - 1 ? 0 : first + 1;
+            }
+            samples = wrapped;
+        }
+
+        // Blend the two phases tap by tap, so that the window is only read once
+        const Sample blend = bank_phase - bank_index;
+        const Sample* taps = bank.taps(bank_index);
+        const Sample* next_taps = bank.taps(bank_index + 1);
+        TapPacket output = TapPacket::Zero();
+        for (int i = 0; i < num_taps; i += TapPacket::SizeAtCompileTime) {
+            const TapPacketMap tap(taps + i);
+            output += (tap + blend * (TapPacketMap(next_taps + i) - tap)) * TapPacketMap(samples + i);
+        }
+        return output.sum();
+    }
+
+    double getresampled_single(const Sample* table, int size, double phase, double new_period, const BlimpTable& blimp_table) {
         double ratio = new_period / size;
         phase = WRAP(phase, 1.0) * size;
 
@@ -20,8 +20,15 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #include "vosimlib/DSPMath.h"
 
 namespace syn {
+    namespace {
+        const double c_retrigBias = -1.376e-2; ///< per sample
+        const double c_retrigFb = 0.9862; ///< per sample
+    }
+
     ADSREnvelope::ADSREnvelope(const string& a_name) :
         Unit(a_name),
+        m_retrigBias(c_retrigBias),
+        m_retrigFb(c_retrigFb),
         m_currState(Off),
         m_lastOutput(0),
         m_lastGate(false)
@@ -36,6 +43,7 @@ namespace syn {
         addParameter_(pDownShape, UnitParameter("fall", 0.001, 1.0, 0.007));
         addParameter_(pLegato, UnitParameter("legato", false));
         addOutput_("out");
+        enableControlRate_();
     }
 
     ADSREnvelope::ADSREnvelope(const ADSREnvelope& a_rhs) :
@@ -73,10 +81,11 @@ namespace syn {
             if (output <= 0.0) {
                 output = 0.0;
                 m_currState = Off;
+                updateActivity_();
             }
             break;
         case Retrigger:
-            output = -1.376e-2 + m_lastOutput * 0.9862;
+            output = m_retrigBias + m_lastOutput * m_retrigFb;
             if (output <= 0.0) {
                 output = 0.0;
                 m_currState = Attack;
@@ -92,6 +101,7 @@ namespace syn {
             bool gate = READ_INPUT(iGate) > 0.5;
             if (gate && !m_lastGate) {
                 m_currState = Attack;
+                updateActivity_();
             } else if (!gate && m_lastGate) {
                 m_currState = Release;
             }
@@ -157,6 +167,9 @@ namespace syn {
         setAttackTime_(m_atkTime);
         setDecayTime_(m_decTime);
         setReleaseTime_(m_relTime);
+        // Run the per sample recurrence once per control tick
+        m_retrigFb = pow(c_retrigFb, getControlPeriod());
+        m_retrigBias = c_retrigBias * ((1.0 - m_retrigFb) / (1.0 - c_retrigFb));
     }
 
     void ADSREnvelope::setAttackTime_(double a_time) {
@@ -197,6 +210,7 @@ namespace syn {
         m_currState = Off;
         m_lastOutput = 0;
         m_lastGate = false;
+        updateActivity_();
     }
 
     bool ADSREnvelope::isActive() const {
@@ -41,8 +41,8 @@ void syn::FollowerUnit::reset()
 void syn::FollowerUnit::process_()
 {
     BEGIN_PROC_FUNC
-        double alpha = param(m_pAlpha).getDouble();
-        double beta = param(m_pBeta).getDouble();
+        double alpha = READ_PARAM(m_pAlpha);
+        double beta = READ_PARAM(m_pBeta);
         double input = READ_INPUT(0) * 0.5 * (1 + alpha);
         // dc removal + rectification
         double old_w = m_w;
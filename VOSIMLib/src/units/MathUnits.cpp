@@ -40,24 +40,34 @@ syn::DCRemoverUnit::DCRemoverUnit(const string& a_name) :
 {
     addInput_("in");
     addOutput_("out");
+    enableBlockProcessing_();
 }
 
 syn::DCRemoverUnit::DCRemoverUnit(const DCRemoverUnit& a_rhs) :
     DCRemoverUnit(a_rhs.name()) {}
 
-void syn::DCRemoverUnit::process_()
+void syn::DCRemoverUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
 {
-    BEGIN_PROC_FUNC
-        double input = READ_INPUT(0);
-        double alpha = param(m_pAlpha).getDouble();
-        double gain = 0.5 * (1 + alpha);
+    const Sample* in = a_inputs[0];
+    Sample* out = a_outputs[0];
+    const double alpha = READ_PARAM(m_pAlpha);
+    const double gain = 0.5 * (1 + alpha);
+    for (int i = 0; i < a_numSamples; i++) {
         // dc removal
-        input = input * gain;
+        double input = in[i] * gain;
         double output = input - m_lastInput + alpha * m_lastOutput;
         m_lastInput = input;
         m_lastOutput = output;
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+        out[i] = output;
+    }
+}
+
+bool syn::DCRemoverUnit::isSilent_()
+{
+    if (!isInputSilent_(0) || std::abs(m_lastOutput) > c_silenceThreshold)
+        return false;
+    reset();
+    return true;
 }
 
 void syn::DCRemoverUnit::reset()
@@ -77,28 +87,33 @@ syn::RectifierUnit::RectifierUnit(const string& a_name) :
 {
     addInput_("in");
     addOutput_("out");
+    enableBlockProcessing_();
 }
 
 syn::RectifierUnit::RectifierUnit(const RectifierUnit& a_rhs) :
     RectifierUnit(a_rhs.name()) { }
 
-void syn::RectifierUnit::process_()
+void syn::RectifierUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
 {
-    BEGIN_PROC_FUNC
-        double input = READ_INPUT(0);
-        double output;
-        switch (param(m_pRectType).getInt())
-        {
-        case 1: // half
-            output = input > 0 ? input : 0;
-            break;
-        case 0: // full
-        default:
-            output = abs(input);
-            break;
-        }
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+    const Sample* in = a_inputs[0];
+    Sample* out = a_outputs[0];
+    if (isInputConstant_(0)) {
+        const double input = readConstantInput_(0);
+        writeConstantOutput_(0, readParamInt_(m_pRectType) == 1 ? MAX(input, 0.0) : std::abs(input));
+        return;
+    }
+    switch (readParamInt_(m_pRectType))
+    {
+    case 1: // half
+        for (int i = 0; i < a_numSamples; i++)
+            out[i] = in[i] > 0 ? in[i] : 0;
+        break;
+    case 0: // full
+    default:
+        for (int i = 0; i < a_numSamples; i++)
+            out[i] = abs(in[i]);
+        break;
+    }
 }
 
 syn::SummerUnit::SummerUnit(const string& a_name) :
@@ -109,22 +124,38 @@ syn::SummerUnit::SummerUnit(const string& a_name) :
         addInput_(std::to_string(i), 0.0);
     }
     addOutput_("out");
+    enableBlockProcessing_();
 }
 
 syn::SummerUnit::SummerUnit(const SummerUnit& a_rhs) :
     SummerUnit(a_rhs.name()) { }
 
-void syn::SummerUnit::process_()
+void syn::SummerUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
 {
-    BEGIN_PROC_FUNC
-        double output = param(m_pBias).getDouble();
-        for (int i = 0; i < numInputs(); i++) {
-            int id = inputs().ids()[i];
-            if (isInputConnected(id))
-                output += READ_INPUT(id);
-        }
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+    Sample* out = a_outputs[0];
+    // Constant inputs are folded into the bias, so that only the others are summed sample by sample
+    double bias = READ_PARAM(m_pBias);
+    int varyingInputs[MAX_INPUTS];
+    int numVaryingInputs = 0;
+    for (int j = 0; j < numInputs(); j++) {
+        int id = inputs().ids()[j];
+        if (!isInputConnected(id))
+            continue;
+        if (isInputConstant_(id))
+            bias += readConstantInput_(id);
+        else
+            varyingInputs[numVaryingInputs++] = id;
+    }
+    if (!numVaryingInputs) {
+        writeConstantOutput_(0, bias);
+        return;
+    }
+    std::fill(out, out + a_numSamples, bias);
+    for (int j = 0; j < numVaryingInputs; j++) {
+        const Sample* in = a_inputs[varyingInputs[j]];
+        for (int i = 0; i < a_numSamples; i++)
+            out[i] += in[i];
+    }
 }
 
 syn::GainUnit::GainUnit(const string& a_name) :
@@ -135,22 +166,38 @@ syn::GainUnit::GainUnit(const string& a_name) :
         addInput_(std::to_string(i), 1.0);
     }
     addOutput_("out");
+    enableBlockProcessing_();
 }
 
 syn::GainUnit::GainUnit(const GainUnit& a_rhs) :
     GainUnit(a_rhs.name()) { }
 
-void syn::GainUnit::process_()
+void syn::GainUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
 {
-    BEGIN_PROC_FUNC
-        double output = param(m_pGain).getDouble();
-        for (int i = 0; i < numInputs(); i++) {
-            int id = inputs().ids()[i];
-            if (isInputConnected(id))
-                output *= READ_INPUT(id);
-        }
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+    Sample* out = a_outputs[0];
+    // Constant inputs are folded into the gain, so that only the others are multiplied sample by sample
+    double gain = READ_PARAM(m_pGain);
+    int varyingInputs[MAX_INPUTS];
+    int numVaryingInputs = 0;
+    for (int j = 0; j < numInputs(); j++) {
+        int id = inputs().ids()[j];
+        if (!isInputConnected(id))
+            continue;
+        if (isInputConstant_(id))
+            gain *= readConstantInput_(id);
+        else
+            varyingInputs[numVaryingInputs++] = id;
+    }
+    if (!numVaryingInputs || gain == 0.0) {
+        writeConstantOutput_(0, gain);
+        return;
+    }
+    std::fill(out, out + a_numSamples, gain);
+    for (int j = 0; j < numVaryingInputs; j++) {
+        const Sample* in = a_inputs[varyingInputs[j]];
+        for (int i = 0; i < a_numSamples; i++)
+            out[i] *= in[i];
+    }
 }
 
 syn::ConstantUnit::ConstantUnit(const string& a_name) :
@@ -159,17 +206,15 @@ syn::ConstantUnit::ConstantUnit(const string& a_name) :
     addParameter_(UnitParameter{"out",-1E6,1E6,0.0,UnitParameter::None,2});
     param("out").setControlType(UnitParameter::EControlType::Unbounded);
     addOutput_("out");
+    enableBlockProcessing_();
 }
 
 syn::ConstantUnit::ConstantUnit(const ConstantUnit& a_rhs) :
     ConstantUnit(a_rhs.name()) { }
 
-void syn::ConstantUnit::process_()
+void syn::ConstantUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
 {
-    BEGIN_PROC_FUNC
-        double output = param(0).getDouble();
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+    writeConstantOutput_(0, READ_PARAM(0));
 }
 
 syn::PanningUnit::PanningUnit(const string& a_name) :
@@ -181,25 +226,28 @@ syn::PanningUnit::PanningUnit(const string& a_name) :
     addInput_("bal2");
     addOutput_("out1");
     addOutput_("out2");
-    m_pBalance1 = addParameter_({"bal1",-1.0,1.0,0.0});
-    m_pBalance2 = addParameter_({"bal2",-1.0,1.0,0.0});
+    m_pBalance1 = addParameter_(UnitParameter("bal1", -1.0, 1.0, 0.0).setSmoothed(true));
+    m_pBalance2 = addParameter_(UnitParameter("bal2", -1.0, 1.0, 0.0).setSmoothed(true));
+    enableBlockProcessing_();
 }
 
 syn::PanningUnit::PanningUnit(const PanningUnit& a_rhs) :
     PanningUnit(a_rhs.name()) { }
 
-void syn::PanningUnit::process_()
+void syn::PanningUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
 {
-    BEGIN_PROC_FUNC
-        double in1 = READ_INPUT(0);
-        double in2 = READ_INPUT(1);
-        double bal1 = param(m_pBalance1).getDouble() + READ_INPUT(2);
-        double bal2 = param(m_pBalance2).getDouble() + READ_INPUT(3);
-        bal1 = 0.5 * (1 + CLAMP(bal1, -1.0, 1.0));
-        bal2 = 0.5 * (1 + CLAMP(bal2, -1.0, 1.0));
-        WRITE_OUTPUT(0, (1 - bal1) * in1 + (1 - bal2) * in2);
-        WRITE_OUTPUT(1, bal1 * in1 + bal2 * in2);
-    END_PROC_FUNC
+    const Sample* in1 = a_inputs[0];
+    const Sample* in2 = a_inputs[1];
+    const Sample* balIn1 = a_inputs[2];
+    const Sample* balIn2 = a_inputs[3];
+    Sample* out1 = a_outputs[0];
+    Sample* out2 = a_outputs[1];
+    for (int i = 0; i < a_numSamples; i++) {
+        double bal1 = 0.5 * (1 + CLAMP(readParamRamp_(m_pBalance1, i) + balIn1[i], -1.0, 1.0));
+        double bal2 = 0.5 * (1 + CLAMP(readParamRamp_(m_pBalance2, i) + balIn2[i], -1.0, 1.0));
+        out1[i] = (1 - bal1) * in1[i] + (1 - bal2) * in2[i];
+        out2[i] = bal1 * in1[i] + bal2 * in2[i];
+    }
 }
 
 syn::LerpUnit::LerpUnit(const string& a_name) :
@@ -212,25 +260,29 @@ syn::LerpUnit::LerpUnit(const string& a_name) :
     m_pClip = addParameter_(UnitParameter("clip", false));
     addInput_("in");
     addOutput_("out");
+    enableBlockProcessing_();
 }
 
 syn::LerpUnit::LerpUnit(const LerpUnit& a_rhs) :
     LerpUnit(a_rhs.name()) { }
 
-void syn::LerpUnit::process_()
+void syn::LerpUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
 {
-    BEGIN_PROC_FUNC
-        double input = READ_INPUT(0);
-        double aIn = param(m_pMinInput).getDouble();
-        double bIn = param(m_pMaxInput).getDouble();
-        double aOut = param(m_pMinOutput).getDouble();
-        double bOut = param(m_pMaxOutput).getDouble();
-        double inputNorm = INVLERP(aIn, bIn, input);
-        double output = LERP(aOut, bOut, inputNorm);
-        if (param(m_pClip).getBool())
-            output = CLAMP(output, MIN(aOut, bOut), MAX(aOut, bOut));
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+    const Sample* in = a_inputs[0];
+    Sample* out = a_outputs[0];
+    const double aIn = READ_PARAM(m_pMinInput);
+    const double bIn = READ_PARAM(m_pMaxInput);
+    const double aOut = READ_PARAM(m_pMinOutput);
+    const double bOut = READ_PARAM(m_pMaxOutput);
+    for (int i = 0; i < a_numSamples; i++) {
+        double inputNorm = INVLERP<double>(aIn, bIn, in[i]);
+        out[i] = LERP(aOut, bOut, inputNorm);
+    }
+    if (readParamBool_(m_pClip)) {
+        const double minOut = MIN(aOut, bOut), maxOut = MAX(aOut, bOut);
+        for (int i = 0; i < a_numSamples; i++)
+            out[i] = CLAMP<double>(out[i], minOut, maxOut);
+    }
 }
 
 
@@ -238,16 +290,22 @@ syn::TanhUnit::TanhUnit(const string& a_name) : Unit(a_name) {
     addParameter_(pSat, UnitParameter("sat", 1.0, 10.0, 1.0));
     addInput_("in");
     addOutput_("out");
+    enableBlockProcessing_();
 }
 
 syn::TanhUnit::TanhUnit(const TanhUnit& a_rhs) : TanhUnit(a_rhs.name()) {}
 
-void syn::TanhUnit::process_() {
-    BEGIN_PROC_FUNC
-    double input = READ_INPUT(0);
-    double sat = param(pSat).getDouble();
-    WRITE_OUTPUT(0, fast_tanh_rat(input * sat) / fast_tanh_rat(sat));
-    END_PROC_FUNC
+void syn::TanhUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) {
+    const Sample* in = a_inputs[0];
+    Sample* out = a_outputs[0];
+    const double sat = READ_PARAM(pSat);
+    const double satOut = fast_tanh_rat(sat);
+    if (isInputConstant_(0)) {
+        writeConstantOutput_(0, fast_tanh_rat(readConstantInput_(0) * sat) / satOut);
+        return;
+    }
+    for (int i = 0; i < a_numSamples; i++)
+        out[i] = fast_tanh_rat(in[i] * sat) / satOut;
 }
 
 syn::QuantizerUnit::QuantizerUnit(const string& a_name) : Unit(a_name) {
@@ -255,13 +313,17 @@ syn::QuantizerUnit::QuantizerUnit(const string& a_name) : Unit(a_name) {
     addInput_(iIn, "in");
     addInput_(iStep, "step");
     addOutput_(0, "out");
+    enableBlockProcessing_();
 }
 
-void syn::QuantizerUnit::process_() {
-    BEGIN_PROC_FUNC
-        double in = READ_INPUT(iIn);
-    double quantStep = CLAMP(param(pStep).getDouble() + READ_INPUT(iStep), param(pStep).getMin(), param(pStep).getMax());
-    double out = quantStep>0 ? quantStep * std::floor(in / quantStep + 0.5) : in;
-    WRITE_OUTPUT(0, out);
-    END_PROC_FUNC
+void syn::QuantizerUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) {
+    const Sample* in = a_inputs[iIn];
+    const Sample* stepIn = a_inputs[iStep];
+    Sample* out = a_outputs[0];
+    const double stepParam = READ_PARAM(pStep);
+    const double minStep = param(pStep).getMin(), maxStep = param(pStep).getMax();
+    for (int i = 0; i < a_numSamples; i++) {
+        double quantStep = CLAMP(stepParam + stepIn[i], minStep, maxStep);
+        out[i] = quantStep>0 ? quantStep * std::floor(in[i] / quantStep + 0.5) : in[i];
+    }
 }
\ No newline at end of file
@@ -140,8 +140,8 @@ namespace syn
         addParameter_(pBufBPMFreq, UnitParameter("rate", g_bpmStrs, g_bpmVals, 0, UnitParameter::EUnitsType::BPM).setVisible(false));
         addParameter_(pBufSamples, UnitParameter("samples", 1.0, 48000.0, 1.0, UnitParameter::EUnitsType::Samples).setVisible(false));
         addParameter_(pBufType, UnitParameter("units", {"sec","Hz","BPM","samples"}, {pBufDelay, pBufFreq, pBufBPMFreq, pBufSamples}));
-        addParameter_(pDryGain, UnitParameter("dry", 0.0, 1.0, 0.0));
-        addParameter_(pWetGain, UnitParameter("wet", 0.0, 1.0, 1.0));
+        addParameter_(pDryGain, UnitParameter("dry", 0.0, 1.0, 0.0).setSmoothed(true));
+        addParameter_(pWetGain, UnitParameter("wet", 0.0, 1.0, 1.0).setSmoothed(true));
         m_delay.resizeBuffer(48000);
     }
 
@@ -176,20 +176,20 @@ namespace syn
     void VariableMemoryUnit::process_()
     {
         BEGIN_PROC_FUNC
-        int bufType = param(pBufType).getEnum();
+        int bufType = READ_PARAM_ENUM(pBufType);
         switch (bufType)
         {
             case pBufDelay:
-                m_delaySamples = periodToSamples(param(pBufDelay).getDouble() + READ_INPUT(iSizeMod), fs());
+                m_delaySamples = periodToSamples(READ_PARAM(pBufDelay) + READ_INPUT(iSizeMod), fs());
                 break;
             case pBufFreq:
-                m_delaySamples = freqToSamples(param(pBufFreq).getDouble() + READ_INPUT(iSizeMod), fs());
+                m_delaySamples = freqToSamples(READ_PARAM(pBufFreq) + READ_INPUT(iSizeMod), fs());
                 break;
             case pBufBPMFreq:
-                m_delaySamples = freqToSamples(bpmToFreq(param(pBufBPMFreq).getEnum(param(pBufBPMFreq).getInt() + READ_INPUT(iSizeMod)), tempo()), fs());
+                m_delaySamples = freqToSamples(bpmToFreq(param(pBufBPMFreq).getEnum(READ_PARAM_INT(pBufBPMFreq) + READ_INPUT(iSizeMod)), tempo()), fs());
                 break;
             case pBufSamples:
-                m_delaySamples = param(pBufSamples).getDouble() + READ_INPUT(iSizeMod);
+                m_delaySamples = READ_PARAM(pBufSamples) + READ_INPUT(iSizeMod);
                 break;
             default:
                 break;
@@ -201,8 +201,8 @@ namespace syn
         output = m_delay.process(input + receive);        
         m_lastOutput = output;
 
-        double dryMix = input*param(pDryGain).getDouble();
-        double wetMix = output*param(pWetGain).getDouble();
+        double dryMix = input*READ_PARAM_RAMP(pDryGain);
+        double wetMix = output*READ_PARAM_RAMP(pWetGain);
         WRITE_OUTPUT(oOut, wetMix + dryMix);
         WRITE_OUTPUT(oSend, output);
         END_PROC_FUNC
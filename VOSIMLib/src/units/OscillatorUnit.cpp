@@ -36,12 +36,13 @@ namespace syn
     {
         addOutput_(oOut, "out");
         addOutput_(oPhase, "ph");
-        addParameter_(pGain, {"gain", 0.0, 1.0, 1.0});
+        addParameter_(pGain, UnitParameter("gain", 0.0, 1.0, 1.0).setSmoothed(true));
         addParameter_(pPhaseOffset, {"phase", 0.0, 1.0, 0.0});
         addParameter_(pUnipolar, UnitParameter("unipolar", false));
         addInput_(iGainMul, "g[x]", 1.0);
         addInput_(iPhaseAdd, "ph");
         addInput_(iSync, "sync");
+        enableBlockProcessing_();
     }
 
     void OscillatorUnit::reset()
@@ -63,15 +64,14 @@ namespace syn
         }
     }
 
-    void OscillatorUnit::tickPhase_(double a_phaseOffset)
+    void OscillatorUnit::tickPhase_(double a_phaseOffset, double a_sync)
     {        
         // sync
-        double sync = READ_INPUT(iSync);
-        if (m_lastSync - sync > 0.5)
+        if (m_lastSync - a_sync > 0.5)
         {
             reset();
         }
-        m_lastSync = READ_INPUT(iSync);
+        m_lastSync = a_sync;
 
         m_basePhase += m_phase_step;
         if (m_basePhase >= 1)
@@ -83,21 +83,21 @@ namespace syn
         m_last_phase = m_phase;
     }
 
-    void OscillatorUnit::process_()
+    void OscillatorUnit::tickOscillator_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_offset)
     {
-        double phase_offset = param(pPhaseOffset).getDouble() + READ_INPUT(iPhaseAdd);
-        m_gain = param(pGain).getDouble() * READ_INPUT(iGainMul);
+        double phase_offset = READ_PARAM(pPhaseOffset) + a_inputs[iPhaseAdd][a_offset];
+        m_gain = readParamRamp_(pGain, a_offset) * a_inputs[iGainMul][a_offset];
         m_bias = 0;
-        if (param(pUnipolar).getBool())
+        if (readParamBool_(pUnipolar))
         {
             // make signal unipolar
             m_gain *= 0.5;
             m_bias = m_gain;
         }
         updatePhaseStep_();
-        tickPhase_(phase_offset);
+        tickPhase_(phase_offset, a_inputs[iSync][a_offset]);
 
-        WRITE_OUTPUT(oPhase, m_phase);
+        a_outputs[oPhase][a_offset] = m_phase;
     }
 
     void TunedOscillatorUnit::onNoteOn_()
@@ -123,45 +123,63 @@ namespace syn
     TunedOscillatorUnit::TunedOscillatorUnit(const TunedOscillatorUnit& a_rhs) :
         TunedOscillatorUnit(a_rhs.name()) {}
 
-    void TunedOscillatorUnit::process_()
+    void TunedOscillatorUnit::tickOscillator_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_offset)
     {
-        double tune = param(pTune).getDouble() + READ_INPUT(iNote);
-        double oct = param(pOctave).getInt();
+        double tune = READ_PARAM(pTune) + a_inputs[iNote][a_offset];
+        double oct = readParamInt_(pOctave);
         m_pitch = tune + oct * 12;
-        OscillatorUnit::process_();
+        OscillatorUnit::tickOscillator_(a_inputs, a_outputs, a_offset);
     }
 
     BasicOscillatorUnit::BasicOscillatorUnit(const string& a_name) :
         TunedOscillatorUnit(a_name)
     {
         addParameter_(pWaveform, UnitParameter("waveform", wave_shape_names));
+        addParameter_(pQuality, UnitParameter("quality", wave_quality_names));
     }
 
     BasicOscillatorUnit::BasicOscillatorUnit(const BasicOscillatorUnit& a_rhs) : BasicOscillatorUnit(a_rhs.name()) {}
 
-    void BasicOscillatorUnit::process_()
+    void BasicOscillatorUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
     {
-        BEGIN_PROC_FUNC
-        TunedOscillatorUnit::process_();
-        double output = 0.0;
-        WaveShape shape = static_cast<WaveShape>(param(pWaveform).getInt());
+        Sample* out = a_outputs[oOut];
+        const WaveShape shape = static_cast<WaveShape>(readParamInt_(pWaveform));
+        const bool useSinc = readParamInt_(pQuality) == SINC_QUALITY;
+        const ResampledTable* table = nullptr;
         switch (shape)
         {
             case SAW_WAVE:
-                output = lut_bl_saw_table().getResampled(m_phase, m_period);
-                break;
-            case SINE_WAVE:
-                output = lut_sin_table().plerp(m_phase);
+                table = &lut_bl_saw_table();
                 break;
             case TRI_WAVE:
-                output = lut_bl_tri_table().getResampled(m_phase, m_period);
+                table = &lut_bl_tri_table();
                 break;
             case SQUARE_WAVE:
-                output = lut_bl_square_table().getResampled(m_phase, m_period);
+                table = &lut_bl_square_table();
+                break;
+            default:
                 break;
         }
-        WRITE_OUTPUT(oOut, m_gain * output + m_bias);
-        END_PROC_FUNC
+        // The mipmap levels only depend on the period, which rarely changes within a block
+        double mipPeriod = -1.0;
+        ResampledTable::MipPosition mipPosition = { 0, 0.0 };
+        for (int i = 0; i < a_numSamples; i++)
+        {
+            tickOscillator_(a_inputs, a_outputs, i);
+            double output;
+            if (!table)
+                output = lut_sin_table().plerp(m_phase);
+            else if (useSinc)
+                output = table->getResampled(m_phase, m_period);
+            else {
+                if (m_period != mipPeriod) {
+                    mipPeriod = m_period;
+                    mipPosition = table->mipPosition(m_period);
+                }
+                output = table->getMipmapped(m_phase, mipPosition);
+            }
+            out[i] = m_gain * output + m_bias;
+        }
     }
 
     LFOOscillatorUnit::LFOOscillatorUnit(const string& a_name) :
@@ -176,46 +194,57 @@ namespace syn
         addParameter_(pFreq, UnitParameter("freq", 0.0, 100.0, 1.0, UnitParameter::EUnitsType::Freq));
         addParameter_(pWaveform, UnitParameter("waveform", wave_shape_names));
         addParameter_(pTempoSync, UnitParameter("tempo sync", false));
+        enableControlRate_();
+        // Interpolating across the wrap around would sweep back through every phase
+        setControlInterpolation_(oPhase, HoldControl);
     }
 
-    void LFOOscillatorUnit::process_()
+    void LFOOscillatorUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
     {
-        BEGIN_PROC_FUNC
-        // determine frequency
-        if (param(pTempoSync).getBool())
-        {
-            m_freq = bpmToFreq(param(pBPMFreq).getEnum(READ_INPUT(iFreqMul) * (param(pBPMFreq).getInt() + READ_INPUT(iFreqAdd))), tempo());
-        }
-        else
-        {
-            m_freq = READ_INPUT(iFreqMul) * (param(pFreq).getDouble() + READ_INPUT(iFreqAdd));
-        }
-        OscillatorUnit::process_();
-        double output, quadoutput;
-        WaveShape shape = static_cast<WaveShape>(param(pWaveform).getInt());
-        switch (shape)
+        const Sample* freqAdd = a_inputs[iFreqAdd];
+        const Sample* freqMul = a_inputs[iFreqMul];
+        Sample* out = a_outputs[oOut];
+        Sample* quadOut = a_outputs[oQuadOut];
+        const bool useTempoSync = readParamBool_(pTempoSync);
+        const WaveShape shape = static_cast<WaveShape>(readParamInt_(pWaveform));
+        const UnitParameter& bpmFreq = param(pBPMFreq);
+        const int bpmIndex = readParamInt_(pBPMFreq);
+        for (int i = 0; i < a_numSamples; i++)
         {
-            case SAW_WAVE:
-                output = naive_saw(m_phase);
-                quadoutput = naive_saw(m_phase + 0.25);
-                break;
-            case SINE_WAVE:
-                output = lut_sin_table().plerp(m_phase);
-                quadoutput = lut_sin_table().plerp(m_phase + 0.25);
-                break;
-            case TRI_WAVE:
-                output = naive_tri(m_phase);
-                quadoutput = naive_tri(m_phase + 0.25);
-                break;
-            default:
-            case SQUARE_WAVE:
-                output = naive_square(m_phase);
-                quadoutput = naive_square(m_phase + 0.25);
-                break;
+            // determine frequency
+            if (useTempoSync)
+            {
+                m_freq = bpmToFreq(bpmFreq.getEnum(freqMul[i] * (bpmIndex + freqAdd[i])), tempo());
+            }
+            else
+            {
+                m_freq = freqMul[i] * (READ_PARAM(pFreq) + freqAdd[i]);
+            }
+            tickOscillator_(a_inputs, a_outputs, i);
+            double output, quadoutput;
+            switch (shape)
+            {
+                case SAW_WAVE:
+                    output = naive_saw(m_phase);
+                    quadoutput = naive_saw(m_phase + 0.25);
+                    break;
+                case SINE_WAVE:
+                    output = lut_sin_table().plerp(m_phase);
+                    quadoutput = lut_sin_table().plerp(m_phase + 0.25);
+                    break;
+                case TRI_WAVE:
+                    output = naive_tri(m_phase);
+                    quadoutput = naive_tri(m_phase + 0.25);
+                    break;
+                default:
+                case SQUARE_WAVE:
+                    output = naive_square(m_phase);
+                    quadoutput = naive_square(m_phase + 0.25);
+                    break;
+            }
+            out[i] = m_gain * output + m_bias;
+            quadOut[i] = m_gain * quadoutput + m_bias;
         }
-        WRITE_OUTPUT(oOut, m_gain * output + m_bias);
-        WRITE_OUTPUT(oQuadOut, m_gain * quadoutput + m_bias);
-        END_PROC_FUNC
     }
 
     void LFOOscillatorUnit::onParamChange_(int a_paramId)
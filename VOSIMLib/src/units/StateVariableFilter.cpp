@@ -18,6 +18,7 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 */
 #include "vosimlib/units/StateVariableFilter.h"
 #include "vosimlib/tables.h"
+#include "vosimlib/DSPMath.h"
 
 #include "vosimlib/common.h"
 
@@ -39,6 +40,7 @@ syn::StateVariableFilter::StateVariableFilter(const string& a_name)
     addOutput_(oHP, "HP");
     addOutput_(oBP, "BP");
     addOutput_(oN, "N");
+    enableBlockProcessing_();
 }
 
 void syn::StateVariableFilter::reset() {
@@ -46,18 +48,37 @@ void syn::StateVariableFilter::reset() {
     m_prevLPOut = 0.0;
 }
 
-void syn::StateVariableFilter::process_() {
-    BEGIN_PROC_FUNC
-        double fc = READ_INPUT(iFcMul) * (param(pFc).getDouble() + READ_INPUT(iFcAdd));
-        fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
-        m_F = 2 * lut_sin_table().plerp(0.5 * fc / (fs() * c_oversamplingFactor));
+bool syn::StateVariableFilter::isSilent_() {
+    if (!isInputSilent_(iAudioIn) || std::abs(m_prevBPOut) > c_silenceThreshold || std::abs(m_prevLPOut) > c_silenceThreshold)
+        return false;
+    reset();
+    return true;
+}
 
-        double input_res = READ_INPUT(iResMul) * param(pRes).getDouble() + READ_INPUT(iResAdd);
-        input_res = CLAMP<double>(input_res, 0, 1);
-        double res = LERP(c_minRes, c_maxRes, input_res);
-        m_damp = 1.0 / res;
+void syn::StateVariableFilter::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) {
+    const Sample* audioIn = a_inputs[iAudioIn];
+    const Sample* fcAdd = a_inputs[iFcAdd];
+    const Sample* fcMul = a_inputs[iFcMul];
+    const Sample* resAdd = a_inputs[iResAdd];
+    const Sample* resMul = a_inputs[iResMul];
+    const double fcParam = READ_PARAM(pFc);
+    const double resParam = READ_PARAM(pRes);
+    const double fcMin = param(pFc).getMin(), fcMax = param(pFc).getMax();
+    const double osFs = fs() * c_oversamplingFactor;
+
+    for (int j = 0; j < a_numSamples; j++) {
+        if (pollControlTick_()) {
+            double fc = fcMul[j] * (fcParam + fcAdd[j]);
+            fc = CLAMP(fc, fcMin, fcMax);
+            m_F = 2 * lut_sin_table().plerp(0.5 * fc / osFs);
+
+            double input_res = resMul[j] * resParam + resAdd[j];
+            input_res = CLAMP<double>(input_res, 0, 1);
+            double res = LERP(c_minRes, c_maxRes, input_res);
+            m_damp = 1.0 / res;
+        }
 
-        double input = READ_INPUT(iAudioIn);
+        double input = audioIn[j];
         double LPOut = 0, HPOut = 0, BPOut = 0;
         int i = c_oversamplingFactor;
         while (i--) {
@@ -70,11 +91,65 @@ void syn::StateVariableFilter::process_() {
         }
         double NOut = HPOut + LPOut;
 
-        WRITE_OUTPUT(oLP, LPOut);
-        WRITE_OUTPUT(oHP, HPOut);
-        WRITE_OUTPUT(oBP, BPOut);
-        WRITE_OUTPUT(oN, NOut);
-    END_PROC_FUNC
+        a_outputs[oLP][j] = LPOut;
+        a_outputs[oHP][j] = HPOut;
+        a_outputs[oBP][j] = BPOut;
+        a_outputs[oN][j] = NOut;
+    }
+}
+
+void syn::StateVariableFilter::processLanes_(Unit* const* a_lanes, int a_numLanes) {
+    StateVariableFilter* lanes[SYN_LANES];
+    LaneArray prevBPOut, prevLPOut, F, damp;
+    for (int i = 0; i < SYN_LANES; i++) {
+        lanes[i] = static_cast<StateVariableFilter*>(a_lanes[i < a_numLanes ? i : 0]);
+        prevBPOut[i] = lanes[i]->m_prevBPOut;
+        prevLPOut[i] = lanes[i]->m_prevLPOut;
+        F[i] = lanes[i]->m_F;
+        damp[i] = lanes[i]->m_damp;
+    }
+    const LaneArray fcParam = readLaneParam_(a_lanes, a_numLanes, pFc);
+    const LaneArray resParam = readLaneParam_(a_lanes, a_numLanes, pRes);
+    const double fcMin = param(pFc).getMin(), fcMax = param(pFc).getMax();
+    const double osFs = fs() * c_oversamplingFactor;
+
+    for (int j = 0; j < getNumSamples(); j++) {
+        // The control ticks of the first lane pace every lane
+        if (pollControlTick_()) {
+            LaneArray fc = readLaneInput_(a_lanes, a_numLanes, iFcMul, j) * (fcParam + readLaneInput_(a_lanes, a_numLanes, iFcAdd, j));
+            fc = fc.max(fcMin).min(fcMax);
+            for (int i = 0; i < SYN_LANES; i++)
+                F[i] = 2 * lut_sin_table().plerp(0.5 * fc[i] / osFs);
+
+            LaneArray input_res = readLaneInput_(a_lanes, a_numLanes, iResMul, j) * resParam + readLaneInput_(a_lanes, a_numLanes, iResAdd, j);
+            input_res = input_res.max(0.0).min(1.0);
+            damp = 1.0 / (c_maxRes * input_res + c_minRes * (1 - input_res));
+        }
+
+        const LaneArray input = readLaneInput_(a_lanes, a_numLanes, iAudioIn, j);
+        LaneArray LPOut = LaneArray::Zero(), HPOut = LaneArray::Zero(), BPOut = LaneArray::Zero();
+        int i = c_oversamplingFactor;
+        while (i--) {
+            LPOut = prevLPOut + F * prevBPOut;
+            HPOut = input - LPOut - damp * prevBPOut;
+            BPOut = F * HPOut + prevBPOut;
+
+            prevBPOut = BPOut;
+            prevLPOut = LPOut;
+        }
+
+        writeLaneOutput_(a_lanes, a_numLanes, oLP, j, LPOut);
+        writeLaneOutput_(a_lanes, a_numLanes, oHP, j, HPOut);
+        writeLaneOutput_(a_lanes, a_numLanes, oBP, j, BPOut);
+        writeLaneOutput_(a_lanes, a_numLanes, oN, j, HPOut + LPOut);
+    }
+
+    for (int i = 0; i < a_numLanes; i++) {
+        lanes[i]->m_prevBPOut = prevBPOut[i];
+        lanes[i]->m_prevLPOut = prevLPOut[i];
+        lanes[i]->m_F = F[i];
+        lanes[i]->m_damp = damp[i];
+    }
 }
 
 void syn::StateVariableFilter::onNoteOn_() {
@@ -90,18 +165,34 @@ void syn::TrapStateVariableFilter::reset() {
     m_prevInput = 0.0;
 }
 
-void syn::TrapStateVariableFilter::process_() {
-    BEGIN_PROC_FUNC
-        double fc = READ_INPUT(iFcMul) * (param(pFc).getDouble() + READ_INPUT(iFcAdd));
-        fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
-        m_F = tan(SYN_PI * fc / (fs() * c_oversamplingFactor));
+bool syn::TrapStateVariableFilter::isSilent_() {
+    return std::abs(m_prevInput) <= c_silenceThreshold && StateVariableFilter::isSilent_();
+}
 
-        double input_res = READ_INPUT(iResMul) * param(pRes).getDouble() + READ_INPUT(iResAdd);
-        input_res = CLAMP<double>(input_res, 0, 1);
-        double res = LERP(c_minRes, c_maxRes, input_res);
-        m_damp = 1.0 / res;
+void syn::TrapStateVariableFilter::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) {
+    const Sample* audioIn = a_inputs[iAudioIn];
+    const Sample* fcAdd = a_inputs[iFcAdd];
+    const Sample* fcMul = a_inputs[iFcMul];
+    const Sample* resAdd = a_inputs[iResAdd];
+    const Sample* resMul = a_inputs[iResMul];
+    const double fcParam = READ_PARAM(pFc);
+    const double resParam = READ_PARAM(pRes);
+    const double fcMin = param(pFc).getMin(), fcMax = param(pFc).getMax();
+    const double osFs = fs() * c_oversamplingFactor;
+
+    for (int j = 0; j < a_numSamples; j++) {
+        if (pollControlTick_()) {
+            double fc = fcMul[j] * (fcParam + fcAdd[j]);
+            fc = CLAMP(fc, fcMin, fcMax);
+            m_F = tan(SYN_PI * fc / osFs);
+
+            double input_res = resMul[j] * resParam + resAdd[j];
+            input_res = CLAMP<double>(input_res, 0, 1);
+            double res = LERP(c_minRes, c_maxRes, input_res);
+            m_damp = 1.0 / res;
+        }
 
-        double input = READ_INPUT(0);
+        double input = audioIn[j];
         double LPOut = 0, BPOut = 0;
         const double denom = 1 + m_F * (m_F + m_damp);
         int i = c_oversamplingFactor;
@@ -116,11 +207,65 @@ void syn::TrapStateVariableFilter::process_() {
         }
         double HPOut = input - m_damp * BPOut - LPOut;
         double NOut = HPOut + LPOut;
-        WRITE_OUTPUT(oLP, LPOut);
-        WRITE_OUTPUT(oHP, HPOut);
-        WRITE_OUTPUT(oBP, BPOut);
-        WRITE_OUTPUT(oN, NOut);
-    END_PROC_FUNC
+        a_outputs[oLP][j] = LPOut;
+        a_outputs[oHP][j] = HPOut;
+        a_outputs[oBP][j] = BPOut;
+        a_outputs[oN][j] = NOut;
+    }
+}
+
+void syn::TrapStateVariableFilter::processLanes_(Unit* const* a_lanes, int a_numLanes) {
+    TrapStateVariableFilter* lanes[SYN_LANES];
+    LaneArray prevBPOut, prevLPOut, prevInput, F, damp;
+    for (int i = 0; i < SYN_LANES; i++) {
+        lanes[i] = static_cast<TrapStateVariableFilter*>(a_lanes[i < a_numLanes ? i : 0]);
+        prevBPOut[i] = lanes[i]->m_prevBPOut;
+        prevLPOut[i] = lanes[i]->m_prevLPOut;
+        prevInput[i] = lanes[i]->m_prevInput;
+        F[i] = lanes[i]->m_F;
+        damp[i] = lanes[i]->m_damp;
+    }
+    const LaneArray fcParam = readLaneParam_(a_lanes, a_numLanes, pFc);
+    const LaneArray resParam = readLaneParam_(a_lanes, a_numLanes, pRes);
+    const double fcMin = param(pFc).getMin(), fcMax = param(pFc).getMax();
+    const double osFs = fs() * c_oversamplingFactor;
+
+    for (int j = 0; j < getNumSamples(); j++) {
+        if (pollControlTick_()) {
+            LaneArray fc = readLaneInput_(a_lanes, a_numLanes, iFcMul, j) * (fcParam + readLaneInput_(a_lanes, a_numLanes, iFcAdd, j));
+            fc = fc.max(fcMin).min(fcMax);
+            F = (SYN_PI * fc / osFs).tan();
+
+            LaneArray input_res = readLaneInput_(a_lanes, a_numLanes, iResMul, j) * resParam + readLaneInput_(a_lanes, a_numLanes, iResAdd, j);
+            input_res = input_res.max(0.0).min(1.0);
+            damp = 1.0 / (c_maxRes * input_res + c_minRes * (1 - input_res));
+        }
+
+        const LaneArray input = readLaneInput_(a_lanes, a_numLanes, iAudioIn, j);
+        LaneArray LPOut = LaneArray::Zero(), BPOut = LaneArray::Zero();
+        const LaneArray denom = 1 + F * (F + damp);
+        int i = c_oversamplingFactor;
+        while (i--) {
+            BPOut = (prevBPOut + F * (-2 * prevLPOut + input + prevInput - prevBPOut * (F + damp))) / denom;
+            LPOut = (prevLPOut + F * (2 * prevBPOut + F * (input + prevInput) - prevLPOut * (F - damp))) / denom;
+            prevInput = input;
+            prevBPOut = BPOut;
+            prevLPOut = LPOut;
+        }
+        const LaneArray HPOut = input - damp * BPOut - LPOut;
+        writeLaneOutput_(a_lanes, a_numLanes, oLP, j, LPOut);
+        writeLaneOutput_(a_lanes, a_numLanes, oHP, j, HPOut);
+        writeLaneOutput_(a_lanes, a_numLanes, oBP, j, BPOut);
+        writeLaneOutput_(a_lanes, a_numLanes, oN, j, HPOut + LPOut);
+    }
+
+    for (int i = 0; i < a_numLanes; i++) {
+        lanes[i]->m_prevBPOut = prevBPOut[i];
+        lanes[i]->m_prevLPOut = prevLPOut[i];
+        lanes[i]->m_prevInput = prevInput[i];
+        lanes[i]->m_F = F[i];
+        lanes[i]->m_damp = damp[i];
+    }
 }
 
 void syn::OnePoleLP::setFc(double a_fc) {
@@ -152,6 +297,7 @@ syn::OnePoleLPUnit::OnePoleLPUnit(const string& a_name)
     addInput_(iSync, "rst");
     addOutput_(oLP, "LP");
     addOutput_(oHP, "HP");
+    enableBlockProcessing_();
 }
 
 double syn::OnePoleLPUnit::getState() const {
@@ -163,25 +309,43 @@ void syn::OnePoleLPUnit::reset() {
     m_lastSync = 0.0;
 }
 
-void syn::OnePoleLPUnit::process_() {
-    BEGIN_PROC_FUNC
+bool syn::OnePoleLPUnit::isSilent_() {
+    if (!isInputSilent_(iAudioIn) || !isInputSilent_(iSync) || m_lastSync != 0.0 || std::abs(implem.m_state) > c_silenceThreshold)
+        return false;
+    reset();
+    return true;
+}
+
+void syn::OnePoleLPUnit::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) {
+    const Sample* audioIn = a_inputs[iAudioIn];
+    const Sample* fcAdd = a_inputs[iFcAdd];
+    const Sample* fcMul = a_inputs[iFcMul];
+    const Sample* syncIn = a_inputs[iSync];
+    Sample* lpOut = a_outputs[oLP];
+    Sample* hpOut = a_outputs[oHP];
+    const double fcParam = READ_PARAM(pFc);
+    const double fcMin = param(pFc).getMin(), fcMax = param(pFc).getMax();
+
+    for (int j = 0; j < a_numSamples; j++) {
         // Calculate gain for specified cutoff
-        double fc = (param(pFc).getDouble() + READ_INPUT(iFcAdd)) * READ_INPUT(iFcMul); // freq cutoff
-        fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
-        implem.setFc(fc);
+        if (pollControlTick_()) {
+            double fc = (fcParam + fcAdd[j]) * fcMul[j]; // freq cutoff
+            fc = CLAMP(fc, fcMin, fcMax);
+            implem.setFc(fc);
+        }
 
         // sync
-        double sync = READ_INPUT(iSync);
+        double sync = syncIn[j];
         if (m_lastSync - sync > 0.5) {
             reset();
         }
-        m_lastSync = READ_INPUT(iSync);
+        m_lastSync = sync;
 
-        double input = READ_INPUT(0);
+        double input = audioIn[j];
         double output = implem.process(input);
-        WRITE_OUTPUT(oLP, output);
-        WRITE_OUTPUT(oHP, input - output);
-    END_PROC_FUNC
+        lpOut[j] = output;
+        hpOut[j] = input - output;
+    }
 }
 
 void syn::OnePoleLPUnit::onFsChange_() {
@@ -199,6 +363,7 @@ syn::LadderFilterBase::LadderFilterBase(const string& a_name)
     addInput_(iFbAdd, "res");
     addInput_(iDrvAdd, "drv");
     addOutput_("out");
+    enableBlockProcessing_();
 }
 
 void syn::LadderFilterBase::onNoteOn_() {
@@ -207,7 +372,8 @@ void syn::LadderFilterBase::onNoteOn_() {
 
 syn::LadderFilterA::LadderFilterA(const string& a_name)
     :
-    LadderFilterBase(a_name) {
+    LadderFilterBase(a_name),
+    m_g(0.0) {
     LadderFilterA::reset();
 }
 
@@ -217,23 +383,48 @@ void syn::LadderFilterA::reset() {
     m_tV.fill(0.0);
 }
 
-void syn::LadderFilterA::process_() {
-    BEGIN_PROC_FUNC
-        double input = READ_INPUT(iAudioIn);
-        // Calculate gain for specified cutoff
-        double fs = LadderFilterA::fs() * c_oversamplingFactor;
-
-        double fc = (param(pFc).getDouble() + READ_INPUT(iFcAdd)) * READ_INPUT(iFcMul); // freq cutoff
-        fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
+bool syn::LadderFilterA::isSilent_() {
+    if (!isInputSilent_(iAudioIn))
+        return false;
+    for (int i = 0; i < 4; i++) {
+        if (std::abs(m_V[i]) > c_silenceThreshold || std::abs(m_dV[i]) > c_silenceThreshold || std::abs(m_tV[i]) > c_silenceThreshold)
+            return false;
+    }
+    reset();
+    return true;
+}
 
-        double wd = SYN_PI * fc / fs;
+void syn::LadderFilterA::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) {
+    const Sample* audioIn = a_inputs[iAudioIn];
+    const Sample* fcAdd = a_inputs[iFcAdd];
+    const Sample* fcMul = a_inputs[iFcMul];
+    const Sample* drvAdd = a_inputs[iDrvAdd];
+    const Sample* fbAdd = a_inputs[iFbAdd];
+    Sample* out = a_outputs[0];
+    const double fcParam = READ_PARAM(pFc);
+    const double drvParam = READ_PARAM(pDrv);
+    const double fbParam = READ_PARAM(pFb);
+    const double fcMin = param(pFc).getMin(), fcMax = param(pFc).getMax();
+    // Calculate gain for specified cutoff
+    const double fs = LadderFilterA::fs() * c_oversamplingFactor;
+    const double stage_gain = 1.0 / (2.0 * VT);
+    const double dt = 1.0 / (2.0 * fs);
+
+    for (int j = 0; j < a_numSamples; j++) {
+        double input = audioIn[j];
+
+        if (pollControlTick_()) {
+            double fc = (fcParam + fcAdd[j]) * fcMul[j]; // freq cutoff
+            fc = CLAMP(fc, fcMin, fcMax);
+
+            double wd = SYN_PI * fc / fs;
+            m_g = 4 * SYN_PI * VT * fc * (1.0 - wd) / (1.0 + wd);
+        }
 
         // Prepare parameter values and insert them into each stage.
-        double g = 4 * SYN_PI * VT * fc * (1.0 - wd) / (1.0 + wd);
-        double drive = 1 + 3 * (param(pDrv).getDouble() + READ_INPUT(iDrvAdd));
-        double res = 3.9 * (param(pFb).getDouble() + READ_INPUT(iFbAdd));
-        double stage_gain = 1.0 / (2.0 * VT);
-        double dt = 1.0 / (2.0 * fs);
+        const double g = m_g;
+        double drive = 1 + 3 * (drvParam + drvAdd[j]);
+        double res = 3.9 * (fbParam + fbAdd[j]);
 
         for (int i = 0; i < c_oversamplingFactor; i++) {
             double dV0 = -g * (fast_tanh_rat((drive * input + res * m_V[3]) * stage_gain) + m_tV[0]);
@@ -256,8 +447,8 @@ void syn::LadderFilterA::process_() {
             m_dV[3] = dV3;
             m_tV[3] = fast_tanh_rat(m_V[3] * stage_gain);
         }
-        WRITE_OUTPUT(0, m_V[3]);
-    END_PROC_FUNC
+        out[j] = m_V[3];
+    }
 }
 
 syn::LadderFilterB::LadderFilterB(const string& a_name)
@@ -270,21 +461,42 @@ void syn::LadderFilterB::reset() {
     m_LP[3].reset();
 }
 
-void syn::LadderFilterB::process_() {
-    BEGIN_PROC_FUNC
-        double input = READ_INPUT(iAudioIn);
-        // Calculate gain for specified cutoff
-        double fs = LadderFilterB::fs() * c_oversamplingFactor;
-
-        double fc = (param(pFc).getDouble() + READ_INPUT(iFcAdd)) * READ_INPUT(iFcMul); // freq cutoff
-        fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
-        double drive = 1.0 + 3.0 * (param(pDrv).getDouble() + READ_INPUT(iDrvAdd));
-        double res = 3.9 * (param(pFb).getDouble() + READ_INPUT(iFbAdd));
+bool syn::LadderFilterB::isSilent_() {
+    if (!isInputSilent_(iAudioIn))
+        return false;
+    for (int i = 0; i < 4; i++) {
+        if (std::abs(m_LP[i].m_state) > c_silenceThreshold)
+            return false;
+    }
+    reset();
+    return true;
+}
 
-        m_LP[0].setFc(fc);
-        m_LP[1].m_G = m_LP[0].m_G;
-        m_LP[2].m_G = m_LP[0].m_G;
-        m_LP[3].m_G = m_LP[0].m_G;
+void syn::LadderFilterB::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples) {
+    const Sample* audioIn = a_inputs[iAudioIn];
+    const Sample* fcAdd = a_inputs[iFcAdd];
+    const Sample* fcMul = a_inputs[iFcMul];
+    const Sample* drvAdd = a_inputs[iDrvAdd];
+    const Sample* fbAdd = a_inputs[iFbAdd];
+    Sample* out = a_outputs[0];
+    const double fcParam = READ_PARAM(pFc);
+    const double drvParam = READ_PARAM(pDrv);
+    const double fbParam = READ_PARAM(pFb);
+    const double fcMin = param(pFc).getMin(), fcMax = param(pFc).getMax();
+
+    for (int j = 0; j < a_numSamples; j++) {
+        double input = audioIn[j];
+        // Calculate gain for specified cutoff
+        if (pollControlTick_()) {
+            double fc = (fcParam + fcAdd[j]) * fcMul[j]; // freq cutoff
+            fc = CLAMP(fc, fcMin, fcMax);
+            m_LP[0].setFc(fc);
+            m_LP[1].m_G = m_LP[0].m_G;
+            m_LP[2].m_G = m_LP[0].m_G;
+            m_LP[3].m_G = m_LP[0].m_G;
+        }
+        double drive = 1.0 + 3.0 * (drvParam + drvAdd[j]);
+        double res = 3.9 * (fbParam + fbAdd[j]);
 
         double g = m_LP[0].m_G / (1 - m_LP[0].m_G);
         double lp3_fb_gain = 1.0 / (1.0 + g);
@@ -307,9 +519,8 @@ void syn::LadderFilterB::process_() {
             out_states[3] = m_LP[2].process(out_states[2]);
             out_states[4] = m_LP[3].process(out_states[3]);
         }
-        double out = out_states[4];
-        WRITE_OUTPUT(0, out);
-    END_PROC_FUNC
+        out[j] = out_states[4];
+    }
 }
 
 void syn::LadderFilterB::onFsChange_() {
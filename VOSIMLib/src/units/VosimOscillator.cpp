@@ -38,13 +38,20 @@ namespace syn
     VosimOscillator::VosimOscillator(const VosimOscillator& a_rhs) :
         VosimOscillator(a_rhs.name()) { }
 
-    void VosimOscillator::process_()
+    void VosimOscillator::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
     {
-        BEGIN_PROC_FUNC
-            m_num_pulses = param(pNumPulses).getInt();
-            m_pulse_tune = CLAMP<double>(READ_INPUT(iPulseTuneMul) * (param(pPulseTune).getDouble() + READ_INPUT(iPulseTuneAdd)), 0, 1);
-            TunedOscillatorUnit::process_();
-            double pulse_decay = CLAMP<double>(READ_INPUT(iDecayMul) * param(pPulseDecay).getDouble(), 0, 1);
+        const Sample* pulseTuneAdd = a_inputs[iPulseTuneAdd];
+        const Sample* pulseTuneMul = a_inputs[iPulseTuneMul];
+        const Sample* decayMul = a_inputs[iDecayMul];
+        Sample* out = a_outputs[oOut];
+        const double pulseTuneParam = READ_PARAM(pPulseTune);
+        const double pulseDecayParam = READ_PARAM(pPulseDecay);
+        m_num_pulses = readParamInt_(pNumPulses);
+        for (int i = 0; i < a_numSamples; i++)
+        {
+            m_pulse_tune = CLAMP<double>(pulseTuneMul[i] * (pulseTuneParam + pulseTuneAdd[i]), 0, 1);
+            tickOscillator_(a_inputs, a_outputs, i);
+            double pulse_decay = CLAMP<double>(decayMul[i] * pulseDecayParam, 0, 1);
 
             double output = 0.0;
 
@@ -66,8 +73,8 @@ namespace syn
                 output = pulseval * pulseval;
                 output *= curr_pulse_gain; // * sqrt(m_pulse_step / m_phase_step);
             }
-            WRITE_OUTPUT(oOut, m_gain * output + m_bias);
-        END_PROC_FUNC
+            out[i] = m_gain * output + m_bias;
+        }
     }
 
     void VosimOscillator::updatePhaseStep_()
@@ -101,10 +108,19 @@ namespace syn
     FormantOscillator::FormantOscillator(const FormantOscillator& a_rhs) :
         FormantOscillator(a_rhs.name()) { }
 
-    void FormantOscillator::process_()
+    void FormantOscillator::processBlock_(const Sample* const* a_inputs, Sample* const* a_outputs, int a_numSamples)
     {
-        BEGIN_PROC_FUNC
-            TunedOscillatorUnit::process_();
+        const Sample* widthAdd = a_inputs[iWidthAdd];
+        const Sample* widthMul = a_inputs[iWidthMul];
+        const Sample* fmtAdd = a_inputs[iFmtAdd];
+        const Sample* fmtMul = a_inputs[iFmtMul];
+        Sample* out = a_outputs[oOut];
+        const double widthParam = READ_PARAM(pWidth);
+        const double fmtParam = READ_PARAM(pFmt);
+        const double fmtMin = param(pFmt).getMin(), fmtMax = param(pFmt).getMax();
+        for (int i = 0; i < a_numSamples; i++)
+        {
+            tickOscillator_(a_inputs, a_outputs, i);
             double fmtFreq;
             double width;
             if (m_freq > fs()/8.0)
@@ -114,8 +130,8 @@ namespace syn
             }
             else
             {
-                fmtFreq = CLAMP<double>(READ_INPUT(iFmtMul) * (param(pFmt).getDouble() + READ_INPUT(iFmtAdd)), param(pFmt).getMin(), param(pFmt).getMax());
-                width = 1 + 6 * CLAMP<double>(READ_INPUT(iWidthMul) * (param(pWidth).getDouble() + READ_INPUT(iWidthAdd)), 0, 1);
+                fmtFreq = CLAMP<double>(fmtMul[i] * (fmtParam + fmtAdd[i]), fmtMin, fmtMax);
+                width = 1 + 6 * CLAMP<double>(widthMul[i] * (widthParam + widthAdd[i]), 0, 1);
             }
             
             double cos_phase = CLAMP<double>(m_phase * width, 0, 1);
@@ -123,7 +139,7 @@ namespace syn
 
             double sinval = lut_sin_table().plerp(m_phase*fmtFreq/m_freq);
             double output = sinval * cosval * sqrt(width);
-            WRITE_OUTPUT(oOut, m_gain * output + m_bias);
-        END_PROC_FUNC
+            out[i] = m_gain * output + m_bias;
+        }
     }
 }
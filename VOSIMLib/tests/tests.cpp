@@ -9,11 +9,20 @@
 #include <vosimlib/common_serial.h>
 
 #include <sstream>
+#include <fstream>
 #include <random>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <numeric>
+#include <algorithm>
 #include <vosimlib/units/MidiUnits.h>
 #include <vosimlib/units/ADSREnvelope.h>
 #include <vosimlib/units/MathUnits.h>
 #include <vosimlib/tables.h>
+#include <unsupported/Eigen/FFT>
+#include <vosimlib/WorkerPool.h>
+#include <vosimlib/CommandQueue.h>
 
 std::random_device RandomDevice;
 
@@ -177,8 +186,8 @@ TEST_CASE("Measure error for rational approximation of tanh", "[fast_tanh]") {
 TEST_CASE("Check that units are ticked correctly", "[Unit]") {
     SECTION("1-sample buffer solo unit") {
         syn::MemoryUnit mu("mu0");
-        double input = 1.0;
-        mu.connectInput(0, syn::ReadOnlyBuffer<double>{&input});
+        syn::Sample input = 1.0;
+        mu.connectInput(0, syn::ReadOnlyBuffer<syn::Sample>{&input});
         mu.tick();
         double out1 = mu.readOutput(0, 0);
         mu.tick();
@@ -189,7 +198,7 @@ TEST_CASE("Check that units are ticked correctly", "[Unit]") {
 
     SECTION("10-sample buffer solo unit") {
         syn::MemoryUnit mu("mu0");
-        typedef Eigen::Array<double, -1, -1, Eigen::RowMajor> io_type;
+        typedef Eigen::Array<syn::Sample, -1, -1, Eigen::RowMajor> io_type;
         io_type inputs(1, 10);
         io_type outputs(1, 10);
         for (int i = 0; i < 10; i++) {
@@ -210,7 +219,7 @@ TEST_CASE("Check that units are ticked correctly", "[Unit]") {
 
     SECTION("10-sample buffer circuit") {
         const int bufSize = 10;
-        Eigen::Array<double, 1, bufSize, Eigen::RowMajor> inputs;
+        Eigen::Array<syn::Sample, 1, bufSize, Eigen::RowMajor> inputs;
         for (int i = 0; i < 10; i++) {
             inputs(0, i) = i;
         }
@@ -218,29 +227,1057 @@ TEST_CASE("Check that units are ticked correctly", "[Unit]") {
         syn::Circuit circ;
         circ.setBufferSize(bufSize);
         int circ_svf_id = circ.addUnit(new syn::StateVariableFilter("circ_svf"));
-        circ.connectInput(0, syn::ReadOnlyBuffer<double>{&inputs(0, 0)});
+        circ.connectInput(0, syn::ReadOnlyBuffer<syn::Sample>{&inputs(0, 0)});
         circ.connectInternal(circ.getInputUnitId(), 0, circ_svf_id, 0);
         circ.connectInternal(circ_svf_id, 0, circ.getOutputUnitId(), 0);
         circ.tick();
-        Eigen::Array<double, 1, bufSize, Eigen::RowMajor> circ_output;
+        Eigen::Array<syn::Sample, 1, bufSize, Eigen::RowMajor> circ_output;
         std::copy(circ.output(0).buf(), circ.output(0).buf() + bufSize, &circ_output(0, 0));
 
         syn::StateVariableFilter svf;
         svf.setBufferSize(bufSize);
         REQUIRE(svf.inputName(0) == "in");
-        Eigen::Array<double, -1, -1, Eigen::RowMajor> outputs(4, bufSize);
+        Eigen::Array<syn::Sample, -1, -1, Eigen::RowMajor> outputs(4, bufSize);
         svf.tick(inputs, outputs);
         for (int i = 0; i<bufSize; i++)
-            REQUIRE(outputs(0, i) == circ_output(0, i));        
+            REQUIRE(outputs(0, i) == circ_output(0, i));
     }
+
+    SECTION("Block processing unit with unconnected inputs") {
+        // Only "in1" is connected: "in2" and both balance inputs read their default of 0 over the whole block
+        syn::PanningUnit pan("pan");
+        typedef Eigen::Array<syn::Sample, -1, -1, Eigen::RowMajor> io_type;
+        io_type inputs(1, 10);
+        io_type outputs(2, 10);
+        for (int i = 0; i < 10; i++) {
+            inputs(0, i) = i;
+        }
+        pan.tick(inputs, outputs);
+        for (int i = 0; i < 10; i++) {
+            REQUIRE(outputs(0, i) == 0.5 * i);
+            REQUIRE(outputs(1, i) == 0.5 * i);
+        }
+
+        // Defaults follow buffer size changes, and partial ticks only write the requested samples
+        syn::GainUnit gain("gain");
+        gain.setParam("gain", 2.0);
+        gain.setBufferSize(4);
+        gain.tick();
+        gain.setBufferSize(16);
+        gain.tick(12);
+        for (int i = 0; i < 12; i++)
+            REQUIRE(gain.readOutput(0, i) == 2.0);
+        REQUIRE(gain.readOutput(0, 12) == 0.0);
+    }
+}
+
+TEST_CASE("Check that parameters are read from a per-block snapshot", "[Unit]") {
+    const int bufSize = 8;
+    typedef Eigen::Array<syn::Sample, -1, -1, Eigen::RowMajor> io_type;
+    io_type inputs(1, bufSize);
+    io_type outputs(2, bufSize);
+    inputs.setOnes();
+    syn::PanningUnit pan("pan");
+    REQUIRE(pan.param("bal1").isSmoothed());
+    pan.tick(inputs, outputs);
+    for (int i = 0; i < bufSize; i++)
+        REQUIRE(outputs(1, i) == 0.5);
+
+    SECTION("Smoothed parameters ramp linearly across the next block") {
+        pan.setParam("bal1", 1.0);
+        pan.tick(inputs, outputs);
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(outputs(1, i) == Approx(0.5 * (1.0 + (i + 1.0) / bufSize)));
+        REQUIRE(outputs(1, bufSize - 1) == 1.0);
+
+        // Once the ramp is over, the parameter holds still
+        pan.tick(inputs, outputs);
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(outputs(1, i) == 1.0);
+    }
+
+    SECTION("Smoothed parameters jump on note on") {
+        pan.setParam("bal1", 1.0);
+        pan.noteOn(60, 127);
+        pan.tick(inputs, outputs);
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(outputs(1, i) == 1.0);
+    }
+
+    SECTION("Parameters that are not smoothed jump at the start of the block") {
+        syn::GainUnit gain("gain");
+        REQUIRE_FALSE(gain.param("gain").isSmoothed());
+        io_type gainOutputs(1, bufSize);
+        gain.tick(inputs, gainOutputs);
+        gain.setParam("gain", 3.0);
+        gain.tick(inputs, gainOutputs);
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(gainOutputs(0, i) == 3.0);
+    }
+}
+
+TEST_CASE("Check that control rate units are evaluated on control ticks", "[Unit]") {
+    const int bufSize = 10;
+    syn::Circuit circ("main");
+    circ.setBufferSize(bufSize);
+    circ.setControlPeriod(4);
+
+    SECTION("Control values are ramped to over one control period") {
+        int ccId = circ.addUnit(new syn::MidiCCUnit("cc"));
+        circ.connectInternal(ccId, 0, circ.getOutputUnitId(), 0);
+        REQUIRE(circ.getUnit(ccId).fs() == circ.fs() / 4);
+
+        // Control ticks fall on samples 0, 4 and 8, then on samples 2 and 6 of the next block
+        circ.tick();
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(circ.readOutput(0, i) == 0.0);
+        circ.notifyMidiControlChange(0, 1.0);
+        circ.tick();
+        const double expected[bufSize] = {0.0, 0.0, 0.25, 0.5, 0.75, 1.0, 1.0, 1.0, 1.0, 1.0};
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(circ.readOutput(0, i) == expected[i]);
+    }
+
+    SECTION("Held outputs jump on note events") {
+        int velId = circ.addUnit(new syn::VelocityUnit("vel"));
+        circ.connectInternal(velId, 0, circ.getOutputUnitId(), 0);
+        circ.tick(3);
+        circ.noteOn(60, 64);
+        circ.tick();
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(circ.readOutput(0, i) == 0.5);
+    }
+
+    SECTION("Control ticks carry over split blocks") {
+        int lfoId = circ.addUnit(new syn::LFOOscillatorUnit("lfo"));
+        circ.getUnit(lfoId).setParam(syn::LFOOscillatorUnit::pFreq, 50.0);
+        circ.connectInternal(lfoId, 0, circ.getOutputUnitId(), 0);
+        syn::Circuit split(circ);
+
+        std::vector<syn::Sample> whole, pieces;
+        const int splits[] = {3, 7, 1, 9, 10};
+        for (int numSamples : splits) {
+            split.tick(numSamples);
+            pieces.insert(pieces.end(), split.output(0).buf(), split.output(0).buf() + numSamples);
+        }
+        for (int i = 0; i < 3; i++) {
+            circ.tick();
+            whole.insert(whole.end(), circ.output(0).buf(), circ.output(0).buf() + bufSize);
+        }
+        REQUIRE(whole == pieces);
+    }
+
+    SECTION("Filters with constant coefficients are unaffected") {
+        std::vector<syn::Sample> input(bufSize);
+        std::iota(input.begin(), input.end(), 0.0);
+        syn::ReadOnlyBuffer<syn::Sample> inputBuffer{input.data()};
+        circ.connectInput(0, inputBuffer);
+        int svfId = circ.addUnit(new syn::TrapStateVariableFilter("svf"));
+        circ.connectInternal(circ.getInputUnitId(), 0, svfId, 0);
+        circ.connectInternal(svfId, 0, circ.getOutputUnitId(), 0);
+        syn::Circuit audioRate(circ);
+        audioRate.connectInput(0, inputBuffer);
+        audioRate.setControlPeriod(1);
+        for (int n = 0; n < 3; n++) {
+            circ.tick();
+            audioRate.tick();
+            for (int i = 0; i < bufSize; i++)
+                REQUIRE(circ.readOutput(0, i) == audioRate.readOutput(0, i));
+        }
+    }
+}
+
+TEST_CASE("Check that constant and silent buffers are tagged through the graph", "[Circuit]") {
+    const int bufSize = 8;
+    syn::Circuit circ("main");
+    circ.setBufferSize(bufSize);
+    std::vector<syn::Sample> input(bufSize);
+    std::iota(input.begin(), input.end(), 1.0);
+    syn::ReadOnlyBuffer<syn::Sample> inputBuffer{input.data()};
+    circ.connectInput(0, inputBuffer);
+    int constId = circ.addUnit(new syn::ConstantUnit("const"));
+    int gainId = circ.addUnit(new syn::GainUnit("gain"));
+    int sumId = circ.addUnit(new syn::SummerUnit("sum"));
+    circ.getUnit(constId).setParam(0, 2.0);
+    circ.getUnit(gainId).setParam(0, 3.0);
+
+    SECTION("Constant outputs fold into constant results") {
+        circ.connectInternal(constId, 0, gainId, 0);
+        circ.connectInternal(gainId, 0, circ.getOutputUnitId(), 0);
+        circ.tick();
+        REQUIRE(circ.output(0).tag()->isConstant);
+        REQUIRE(circ.output(0).tag()->value == 6.0);
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(circ.readOutput(0, i) == 6.0);
+
+        // Mixing in a varying signal clears the tag
+        circ.connectInternal(gainId, 0, sumId, 0);
+        circ.connectInternal(circ.getInputUnitId(), 0, sumId, 1);
+        circ.connectInternal(sumId, 0, circ.getOutputUnitId(), 0);
+        circ.tick();
+        REQUIRE_FALSE(circ.output(0).tag()->isConstant);
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(circ.readOutput(0, i) == 6.0 + input[i]);
+    }
+
+    SECTION("Held control rate outputs are constant") {
+        circ.setControlPeriod(4);
+        int velId = circ.addUnit(new syn::VelocityUnit("vel"));
+        circ.connectInternal(velId, 0, circ.getOutputUnitId(), 0);
+        circ.noteOn(60, 32);
+        circ.tick();
+        REQUIRE(circ.output(0).tag()->isConstant);
+        REQUIRE(circ.output(0).tag()->value == 0.25);
+    }
+
+    SECTION("Silent filters are skipped once their state has decayed") {
+        int svfId = circ.addUnit(new syn::StateVariableFilter("svf"));
+        circ.getUnit(svfId).setParam(syn::StateVariableFilter::pFc, 1000.0);
+        circ.connectInternal(circ.getInputUnitId(), 0, gainId, 0);
+        circ.connectInternal(gainId, 0, svfId, 0);
+        circ.connectInternal(svfId, 0, circ.getOutputUnitId(), 0);
+        circ.tick();
+        REQUIRE_FALSE(circ.output(0).tag()->isConstant);
+
+        // The filter rings for a while after its input is muted, then goes silent
+        circ.getUnit(gainId).setParam(0, 0.0);
+        circ.tick();
+        REQUIRE_FALSE(circ.output(0).tag()->isSilent());
+        int numTicks = 0;
+        while (!circ.output(0).tag()->isSilent() && numTicks++ < 100000)
+            circ.tick();
+        REQUIRE(circ.output(0).tag()->isSilent());
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(circ.readOutput(0, i) == 0.0);
+
+        circ.getUnit(gainId).setParam(0, 1.0);
+        circ.tick();
+        REQUIRE_FALSE(circ.output(0).tag()->isConstant);
+        REQUIRE(circ.readOutput(0, bufSize - 1) != 0.0);
+    }
+}
+
+TEST_CASE("Check that circuits keep their execution plan in sync with edits", "[Circuit]") {
+    const int bufSize = 8;
+    syn::Circuit circ("main");
+    circ.setBufferSize(bufSize);
+    int constId = circ.addUnit(new syn::ConstantUnit("const"));
+    int gainId = circ.addUnit(new syn::GainUnit("gain"));
+    circ.getUnit(constId).setParam(0, 2.0);
+    circ.getUnit(gainId).setParam(0, 3.0);
+
+    SECTION("Unconnected inputs read their default values") {
+        circ.connectInternal(gainId, 0, circ.getOutputUnitId(), 0);
+        circ.tick();
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(circ.readOutput(0, i) == 3.0);
+    }
+
+    SECTION("Connections, parameter changes and buffer resizes are reflected") {
+        circ.connectInternal(constId, 0, gainId, 0);
+        circ.connectInternal(gainId, 0, circ.getOutputUnitId(), 0);
+        circ.tick();
+        REQUIRE(circ.readOutput(0, bufSize - 1) == 6.0);
+
+        circ.getUnit(gainId).setParam(0, -1.0);
+        circ.setBufferSize(2 * bufSize);
+        circ.tick();
+        for (int i = 0; i < 2 * bufSize; i++)
+            REQUIRE(circ.readOutput(0, i) == -2.0);
+
+        circ.disconnectInternal(constId, 0, gainId, 0);
+        circ.tick();
+        REQUIRE(circ.readOutput(0, 0) == -1.0);
+    }
+
+    SECTION("Batched edits are applied when the outermost edit ends") {
+        circ.beginEdit();
+        circ.connectInternal(constId, 0, gainId, 0);
+        circ.beginEdit();
+        circ.connectInternal(gainId, 0, circ.getOutputUnitId(), 0);
+        circ.endEdit();
+        REQUIRE(circ.execOrder()[0] == nullptr);
+        circ.endEdit();
+        REQUIRE(circ.execOrder()[0] == &circ.getUnit(constId));
+        REQUIRE(circ.execOrder()[1] == &circ.getUnit(gainId));
+        REQUIRE(circ.execOrder()[2] == &circ.getUnit(circ.getOutputUnitId()));
+        REQUIRE(circ.execOrder()[3] == nullptr);
+
+        syn::Circuit copy(circ);
+        copy.tick();
+        REQUIRE(copy.readOutput(0, 0) == 6.0);
+    }
+}
+
+TEST_CASE("Check that circuit outputs share buffers when their lifetimes do not overlap", "[Circuit]") {
+    const int bufSize = 4;
+    const int chainLength = 6;
+    syn::Circuit circ("main");
+    circ.setBufferSize(bufSize);
+    int constId = circ.addUnit(new syn::ConstantUnit("const"));
+    circ.getUnit(constId).setParam(0, 1.0);
+    vector<int> gainIds;
+    int prevId = constId;
+    for (int i = 0; i < chainLength; i++) {
+        int gainId = circ.addUnit(new syn::GainUnit("gain" + std::to_string(i)));
+        circ.getUnit(gainId).setParam(0, 2.0);
+        circ.connectInternal(prevId, 0, gainId, 0);
+        gainIds.push_back(gainId);
+        prevId = gainId;
+    }
+    circ.connectInternal(prevId, 0, circ.getOutputUnitId(), 0);
+
+    // A linear chain only needs two alternating buffers
+    for (int i = 0; i < chainLength - 2; i++)
+        REQUIRE(circ.getUnit(gainIds[i]).outputs()[0].buf() == circ.getUnit(gainIds[i + 2]).outputs()[0].buf());
+    for (int i = 0; i < chainLength - 1; i++)
+        REQUIRE(circ.getUnit(gainIds[i]).outputs()[0].buf() != circ.getUnit(gainIds[i + 1]).outputs()[0].buf());
+
+    circ.tick();
+    for (int i = 0; i < bufSize; i++)
+        REQUIRE(circ.readOutput(0, i) == 64.0);
+
+    // Intermediate outputs can still be inspected once their buffers have been reused
+    double expected = 1.0;
+    for (int i = 0; i < chainLength; i++) {
+        expected *= 2.0;
+        REQUIRE(circ.getUnit(gainIds[i]).lastOutput(0) == expected);
+    }
+    REQUIRE(circ.getUnit(gainIds[0]).readOutput(0, 0) != circ.getUnit(gainIds[0]).lastOutput(0));
+    REQUIRE(circ.getUnit(gainIds[0]).outputs()[0].isOverwritten());
+    REQUIRE_FALSE(circ.getUnit(gainIds[chainLength - 1]).outputs()[0].isOverwritten());
+
+    // Observed outputs keep their own buffer
+    REQUIRE(circ.setOutputObserved(gainIds[0], 0));
+    REQUIRE_FALSE(circ.setOutputObserved(gainIds[0], 1));
+    REQUIRE_FALSE(circ.getUnit(gainIds[0]).outputs()[0].isOverwritten());
+    circ.tick();
+    for (int i = 0; i < bufSize; i++) {
+        REQUIRE(circ.getUnit(gainIds[0]).readOutput(0, i) == 2.0);
+        REQUIRE(circ.readOutput(0, i) == 64.0);
+    }
+    REQUIRE(circ.setOutputObserved(gainIds[0], 0, false));
+    REQUIRE(circ.getUnit(gainIds[0]).outputs()[0].isOverwritten());
+
+    circ.setBufferSize(2 * bufSize);
+    circ.tick();
+    for (int i = 0; i < 2 * bufSize; i++)
+        REQUIRE(circ.readOutput(0, i) == 64.0);
+}
+
+TEST_CASE("Check that units wired into a cycle that does not reach the outputs are left unscheduled", "[Circuit]") {
+    syn::Circuit circ("main");
+    circ.setBufferSize(4);
+    int aId = circ.addUnit(new syn::GainUnit("a"));
+    int bId = circ.addUnit(new syn::GainUnit("b"));
+    int constId = circ.addUnit(new syn::ConstantUnit("const"));
+    circ.getUnit(constId).setParam(0, 3.0);
+    circ.connectInternal(constId, 0, circ.getOutputUnitId(), 0);
+    REQUIRE(circ.connectInternal(aId, 0, bId, 0));
+    REQUIRE(circ.connectInternal(bId, 0, aId, 0));
+    circ.tick();
+    REQUIRE(circ.readOutput(0, 0) == 3.0);
+
+    // The cycle is scheduled once it reaches an output
+    circ.connectInternal(bId, 0, circ.getOutputUnitId(), 1);
+    circ.tick();
+    REQUIRE(circ.readOutput(0, 0) == 3.0);
+    REQUIRE(circ.readOutput(1, 0) == 0.0);
+
+    // Nothing else scheduled
+    syn::Circuit bare("bare");
+    int cId = bare.addUnit(new syn::GainUnit("c"));
+    int dId = bare.addUnit(new syn::GainUnit("d"));
+    REQUIRE(bare.connectInternal(cId, 0, dId, 0));
+    REQUIRE(bare.connectInternal(dId, 0, cId, 0));
+    bare.tick();
+}
+
+TEST_CASE("Check that circuits track the activity of their units as it changes", "[Circuit]") {
+    const int bufSize = 32;
+    syn::Circuit circ("main");
+    circ.setBufferSize(bufSize);
+    int envId = circ.addUnit(new syn::ADSREnvelope("env"));
+    circ.getUnit(envId).setParam(syn::ADSREnvelope::pAtkTime, 0.001);
+    circ.getUnit(envId).setParam(syn::ADSREnvelope::pRelTime, 0.005);
+    circ.connectInternal(envId, 0, circ.getOutputUnitId(), 0);
+    // Units outside of the execution plan are ignored
+    circ.addUnit(new syn::ADSREnvelope("unscheduled"));
+
+    auto pollActivity = [&circ]() {
+        int numActiveUnits = 0;
+        for (syn::Unit* const* unit = circ.execOrder().data(); *unit != nullptr; unit++)
+            numActiveUnits += (*unit)->isActive();
+        return numActiveUnits;
+    };
+
+    REQUIRE(!circ.isActive());
+    circ.noteOn(60, 127);
+    REQUIRE(circ.isActive());
+    REQUIRE(circ.getNumActiveUnits() == pollActivity());
+    for (int i = 0; i < 8; i++)
+        circ.tick();
+    circ.noteOff();
+    // Only the envelope keeps the circuit active during its release
+    REQUIRE(circ.getNumActiveUnits() == 1);
+
+    int numTicks = 0;
+    while (circ.isActive() && numTicks < 1000) {
+        circ.tick();
+        REQUIRE(circ.getNumActiveUnits() == pollActivity());
+        numTicks++;
+    }
+    REQUIRE(!circ.isActive());
+    REQUIRE(numTicks > 1);
+
+    // Resetting a retriggered envelope is reported too, and so are edits to the execution plan
+    circ.noteOn(62, 127);
+    circ.noteOff();
+    REQUIRE(circ.isActive());
+    circ.reset();
+    REQUIRE(!circ.isActive());
+    circ.noteOn(64, 127);
+    circ.disconnectInternal(envId, 0, circ.getOutputUnitId(), 0);
+    REQUIRE(circ.getNumActiveUnits() == pollActivity());
+    circ.noteOff();
+    REQUIRE(!circ.isActive());
+}
+
+TEST_CASE("Check that the layer-parallel scheduler matches serial processing", "[Circuit]") {
+    const int bufSize = 16;
+    const int numBranches = 8;
+    syn::Circuit circ("main");
+    circ.setBufferSize(bufSize);
+    circ.beginEdit();
+    int sumId = circ.addUnit(new syn::SummerUnit("sum"));
+    for (int i = 0; i < numBranches; i++) {
+        int oscId = circ.addUnit(new syn::LFOOscillatorUnit("lfo" + std::to_string(i)));
+        int svfId = circ.addUnit(new syn::TrapStateVariableFilter("svf" + std::to_string(i)));
+        circ.getUnit(oscId).setParam(syn::LFOOscillatorUnit::Param::pFreq, 10.0 * (i + 1));
+        circ.connectInternal(oscId, 0, svfId, 0);
+        circ.connectInternal(svfId, 0, sumId, i);
+    }
+    circ.connectInternal(sumId, 0, circ.getOutputUnitId(), 0);
+    circ.endEdit();
+    circ.noteOn(60, 127);
+
+    syn::Circuit parallelCirc(circ);
+    syn::WorkerPool pool(3);
+    parallelCirc.setWorkerPool(&pool);
+    parallelCirc.setParallelWorkThreshold(0);
+
+    double energy = 0.0;
+    for (int tick = 0; tick < 16; tick++) {
+        circ.tick();
+        parallelCirc.tick();
+        for (int i = 0; i < bufSize; i++) {
+            REQUIRE(circ.readOutput(0, i) == parallelCirc.readOutput(0, i));
+            energy += circ.readOutput(0, i) * circ.readOutput(0, i);
+        }
+    }
+    REQUIRE(energy > 0.0);
+}
+
+TEST_CASE("Check that threaded voice rendering matches serial rendering", "[VoiceManager]") {
+    const int bufSize = 64;
+    syn::Circuit proto("main");
+    proto.beginEdit();
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    int svfId = proto.addUnit(new syn::TrapStateVariableFilter("svf"));
+    int sumId = proto.addUnit(new syn::SummerUnit("sum"));
+    proto.connectInternal(oscId, 0, svfId, 0);
+    proto.connectInternal(svfId, 0, sumId, 0);
+    proto.connectInternal(proto.getInputUnitId(), 0, sumId, 1);
+    proto.connectInternal(sumId, 0, proto.getOutputUnitId(), 0);
+    proto.connectInternal(svfId, 1, proto.getOutputUnitId(), 1);
+    proto.endEdit();
+
+    syn::VoiceManager serialVm, threadedVm;
+    threadedVm.setNumWorkerThreads(3);
+    threadedVm.setParallelVoiceThreshold(0);
+    for (syn::VoiceManager* vm : { &serialVm, &threadedVm }) {
+        vm->setPrototypeCircuit(proto);
+        vm->setMaxVoices(8);
+        vm->setBufferSize(bufSize);
+        vm->setInternalBufferSize(16);
+        for (int note = 60; note < 66; note++)
+            vm->noteOn(note, 100);
+    }
+    REQUIRE(threadedVm.getNumWorkerThreads() == 3);
+
+    std::vector<syn::Sample> input(bufSize);
+    std::vector<syn::Sample> serialOut[2] = { std::vector<syn::Sample>(bufSize), std::vector<syn::Sample>(bufSize) };
+    std::vector<syn::Sample> threadedOut[2] = { std::vector<syn::Sample>(bufSize), std::vector<syn::Sample>(bufSize) };
+    for (int tick = 0; tick < 16; tick++) {
+        for (int i = 0; i < bufSize; i++)
+            input[i] = i + tick * bufSize;
+        serialVm.tick(input.data(), input.data(), serialOut[0].data(), serialOut[1].data());
+        threadedVm.tick(input.data(), input.data(), threadedOut[0].data(), threadedOut[1].data());
+        REQUIRE(serialOut[0] == threadedOut[0]);
+        REQUIRE(serialOut[1] == threadedOut[1]);
+    }
+
+    // The pool can be resized from another thread while voices are rendered
+    std::atomic<bool> quit(false);
+    std::thread resizeThread([&]() {
+        for (int i = 0; !quit.load(); i++)
+            threadedVm.setNumWorkerThreads(1 + i % 3);
+    });
+    for (int tick = 16; tick < 32; tick++) {
+        for (int i = 0; i < bufSize; i++)
+            input[i] = i + tick * bufSize;
+        serialVm.tick(input.data(), input.data(), serialOut[0].data(), serialOut[1].data());
+        threadedVm.tick(input.data(), input.data(), threadedOut[0].data(), threadedOut[1].data());
+        REQUIRE(serialOut[0] == threadedOut[0]);
+        REQUIRE(serialOut[1] == threadedOut[1]);
+    }
+    quit.store(true);
+    resizeThread.join();
+
+    // Every internal buffer reads its own slice of the input
+    std::vector<syn::Sample> zeros(bufSize, 0.0);
+    threadedVm.setMaxVoices(1);
+    serialVm.setMaxVoices(1);
+    threadedVm.noteOn(60, 100);
+    serialVm.noteOn(60, 100);
+    serialVm.tick(input.data(), input.data(), serialOut[0].data(), serialOut[1].data());
+    threadedVm.tick(zeros.data(), zeros.data(), threadedOut[0].data(), threadedOut[1].data());
+    for (int i = 0; i < bufSize; i++)
+        REQUIRE(serialOut[0][i] - threadedOut[0][i] == Approx(input[i]));
+}
+
+TEST_CASE("Check that voices rendered in lockstep lanes match voices rendered one by one", "[VoiceManager]") {
+    const int bufSize = 32;
+    syn::Circuit proto("main");
+    proto.beginEdit();
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    int svfId = proto.addUnit(new syn::StateVariableFilter("svf"));
+    int tsvfId = proto.addUnit(new syn::TrapStateVariableFilter("tsvf"));
+    proto.connectInternal(oscId, 0, svfId, 0);
+    proto.connectInternal(oscId, 0, tsvfId, 0);
+    proto.connectInternal(oscId, 0, tsvfId, 1);
+    proto.connectInternal(svfId, 0, proto.getOutputUnitId(), 0);
+    proto.connectInternal(tsvfId, 2, proto.getOutputUnitId(), 1);
+    proto.endEdit();
+    proto.getUnit(svfId).setParam(syn::StateVariableFilter::pRes, 0.7);
+    proto.getUnit(tsvfId).setParam(syn::StateVariableFilter::pFc, 800.0);
+
+    syn::VoiceManager laneVm, scalarVm;
+    scalarVm.setLaneBatching(false);
+    for (syn::VoiceManager* vm : { &laneVm, &scalarVm }) {
+        vm->setPrototypeCircuit(proto);
+        vm->setMaxVoices(8);
+        vm->setBufferSize(bufSize);
+        vm->setInternalBufferSize(bufSize);
+        // One full batch and a partial one
+        for (int note = 40; note < 46; note++)
+            vm->noteOn(note, 100);
+    }
+
+    std::vector<syn::Sample> input(bufSize, 0.0);
+    std::vector<syn::Sample> laneOut[2] = { std::vector<syn::Sample>(bufSize), std::vector<syn::Sample>(bufSize) };
+    std::vector<syn::Sample> scalarOut[2] = { std::vector<syn::Sample>(bufSize), std::vector<syn::Sample>(bufSize) };
+    for (int tick = 0; tick < 32; tick++) {
+        laneVm.tick(input.data(), input.data(), laneOut[0].data(), laneOut[1].data());
+        scalarVm.tick(input.data(), input.data(), scalarOut[0].data(), scalarOut[1].data());
+        for (int i = 0; i < bufSize; i++) {
+            REQUIRE(laneOut[0][i] == Approx(scalarOut[0][i]).margin(1e-9));
+            REQUIRE(laneOut[1][i] == Approx(scalarOut[1][i]).margin(1e-9));
+        }
+    }
+    for (int voice = 0; voice < 6; voice++) {
+        REQUIRE(laneVm.getVoiceCircuit(voice).getUnit(tsvfId).readOutput(2, bufSize - 1) ==
+            Approx(scalarVm.getVoiceCircuit(voice).getUnit(tsvfId).readOutput(2, bufSize - 1)).margin(1e-9));
+    }
+}
+
+TEST_CASE("Check that MIDI events are applied at their exact sample offset", "[VoiceManager]") {
+    const int bufSize = 64;
+    syn::Circuit proto("main");
+    proto.beginEdit();
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    int svfId = proto.addUnit(new syn::TrapStateVariableFilter("svf"));
+    proto.connectInternal(oscId, 0, svfId, 0);
+    proto.connectInternal(svfId, 0, proto.getOutputUnitId(), 0);
+    proto.connectInternal(oscId, 0, proto.getOutputUnitId(), 1);
+    proto.endEdit();
+
+    // Block-split voice manager, with events in the middle of internal buffers
+    syn::VoiceManager blockVm;
+    blockVm.setPrototypeCircuit(proto);
+    blockVm.setMaxVoices(4);
+    blockVm.setBufferSize(bufSize);
+    blockVm.setInternalBufferSize(16);
+    // Reference voice manager, ticked one sample at a time
+    syn::VoiceManager sampleVm;
+    sampleVm.setPrototypeCircuit(proto);
+    sampleVm.setMaxVoices(4);
+    sampleVm.setBufferSize(1);
+
+    std::vector<syn::MidiEvent> events = {
+        { 5, syn::MidiEvent::NoteOn, 60, 100 },
+        { 37, syn::MidiEvent::NoteOn, 67, 100 },
+        { 37, syn::MidiEvent::PitchWheel, 0, 0.25 },
+        { 50, syn::MidiEvent::NoteOff, 60, 0 }
+    };
+    std::vector<syn::Sample> input(bufSize, 0.0);
+    std::vector<syn::Sample> blockOut[2] = { std::vector<syn::Sample>(bufSize), std::vector<syn::Sample>(bufSize) };
+    blockVm.tick(input.data(), input.data(), blockOut[0].data(), blockOut[1].data(), events.data(), int(events.size()));
+
+    int eventIndex = 0;
+    for (int i = 0; i < bufSize; i++) {
+        std::vector<syn::MidiEvent> sampleEvents;
+        while (eventIndex < events.size() && events[eventIndex].offset == i) {
+            sampleEvents.push_back(events[eventIndex++]);
+            sampleEvents.back().offset = 0;
+        }
+        syn::Sample left, right;
+        sampleVm.tick(&input[i], &input[i], &left, &right, sampleEvents.data(), int(sampleEvents.size()));
+        if (i < 5) {
+            REQUIRE(blockOut[1][i] == 0.0);
+        }
+        REQUIRE(left == Approx(blockOut[0][i]).margin(1e-12));
+        REQUIRE(right == Approx(blockOut[1][i]).margin(1e-12));
+    }
+    REQUIRE(blockOut[1][5] != 0.0);
+}
+
+TEST_CASE("Check that voices can be rebuilt while the audio thread is running", "[VoiceManager]") {
+    const int bufSize = 32;
+    syn::Circuit proto("main");
+    proto.beginEdit();
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    proto.connectInternal(oscId, 0, proto.getOutputUnitId(), 0);
+    proto.endEdit();
+
+    syn::VoiceManager vm;
+    vm.setPrototypeCircuit(proto);
+    vm.setMaxVoices(2);
+    vm.setBufferSize(bufSize);
+    vm.setInternalBufferSize(bufSize);
+
+    std::atomic<bool> quit(false);
+    std::atomic<int> numTicks(0);
+    std::atomic<int> tickInterval(0);
+    vm.setAudioActive(true);
+    std::thread audioThread([&]() {
+        std::vector<syn::Sample> input(bufSize, 0.0), left(bufSize), right(bufSize);
+        while (!quit.load()) {
+            vm.tick(input.data(), input.data(), left.data(), right.data());
+            numTicks++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(tickInterval.load()));
+        }
+    });
+    while (numTicks.load() == 0)
+        std::this_thread::yield();
+
+    for (int numVoices = 1; numVoices <= 8; numVoices++) {
+        // Edits queued before the rebuild must make it into the new voices
+        double gain = numVoices * 0.1;
+        vm.queueAction([&vm, oscId, gain]() { vm.getPrototypeCircuit().getUnit(oscId).setParam(syn::OscillatorUnit::pGain, gain); });
+        vm.setMaxVoices(numVoices);
+        REQUIRE(vm.getMaxVoices() == numVoices);
+        REQUIRE(vm.getVoiceCircuit(numVoices - 1).getUnit(oscId).param(syn::OscillatorUnit::pGain).getDouble() == Approx(gain));
+    }
+    vm.setPrototypeCircuit(proto);
+    REQUIRE(vm.getMaxVoices() == 8);
+    REQUIRE(vm.getVoiceCircuit(7).getUnit(oscId).param(syn::OscillatorUnit::pGain).getDouble() ==
+        Approx(proto.getUnit(oscId).param(syn::OscillatorUnit::pGain).getDouble()));
+
+    // Long buffers leave long gaps between ticks, but the actions still only run on the audio thread
+    tickInterval.store(30);
+    const std::thread::id audioThreadId = audioThread.get_id();
+    for (int numVoices = 2; numVoices <= 3; numVoices++) {
+        std::thread::id actionThreadId;
+        vm.queueAction([&actionThreadId]() { actionThreadId = std::this_thread::get_id(); });
+        vm.setMaxVoices(numVoices);
+        REQUIRE(vm.getMaxVoices() == numVoices);
+        REQUIRE(actionThreadId == audioThreadId);
+    }
+
+    quit.store(true);
+    audioThread.join();
+
+    // Idle calls leave the actions to the audio thread for as long as it is active
+    bool ranAction = false;
+    vm.queueAction([&ranAction]() { ranAction = true; });
+    vm.onIdle();
+    REQUIRE_FALSE(ranAction);
+
+    // Once audio is stopped, the new voices are installed immediately
+    vm.setAudioActive(false);
+    vm.setMaxVoices(4);
+    REQUIRE(ranAction);
+    REQUIRE(vm.getMaxVoices() == 4);
+}
+
+TEST_CASE("Check that voices are allocated and stolen according to the voice stealing policy", "[VoiceManager]") {
+    const int bufSize = 8;
+    syn::Circuit proto("main");
+    proto.beginEdit();
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    proto.connectInternal(oscId, 0, proto.getOutputUnitId(), 0);
+    proto.endEdit();
+
+    syn::VoiceManager vm;
+    vm.setPrototypeCircuit(proto);
+    vm.setBufferSize(bufSize);
+    std::vector<syn::Sample> input(bufSize, 0.0), left(bufSize), right(bufSize);
+
+    auto heldNotes = [&vm]() {
+        std::vector<int> notes;
+        for (int i = 0; i < vm.getMaxVoices(); i++) {
+            if (vm.getVoiceCircuit(i).isNoteOn())
+                notes.push_back(vm.getVoiceCircuit(i).note());
+        }
+        std::sort(notes.begin(), notes.end());
+        return notes;
+    };
+
+    struct PolicyCase { syn::VoiceManager::VoiceStealPolicy policy; int stolenNote; };
+    for (PolicyCase policyCase : { PolicyCase{ syn::VoiceManager::Oldest, 64 }, PolicyCase{ syn::VoiceManager::Newest, 62 },
+                                   PolicyCase{ syn::VoiceManager::Lowest, 67 }, PolicyCase{ syn::VoiceManager::Highest, 60 } }) {
+        vm.setMaxVoices(4);
+        vm.setVoiceStealPolicy(policyCase.policy);
+        for (int note : { 64, 60, 67, 62 })
+            vm.noteOn(note, 100);
+        REQUIRE(vm.getIdleVoiceIndices().empty());
+        vm.noteOn(70, 100);
+        std::vector<int> expected = { 60, 62, 64, 67, 70 };
+        expected.erase(std::find(expected.begin(), expected.end(), policyCase.stolenNote));
+        REQUIRE(heldNotes() == expected);
+        REQUIRE(vm.getVoiceCircuit(vm.getNewestVoiceIndex()).note() == 70);
+    }
+
+    // Released voices are stolen before held ones, even when they are newer
+    vm.setMaxVoices(4);
+    vm.setVoiceStealPolicy(syn::VoiceManager::Oldest);
+    for (int note : { 60, 62, 64, 67 })
+        vm.noteOn(note, 100);
+    vm.noteOff(64);
+    REQUIRE(vm.getReleasedVoiceIndices().size() == 1);
+    vm.noteOn(70, 100);
+    REQUIRE(heldNotes() == std::vector<int>({ 60, 62, 67, 70 }));
+
+    // Note off releases every voice playing the note, and silent voices become idle once rendered
+    vm.noteOff(60);
+    vm.noteOff(62);
+    vm.noteOn(62, 100);
+    vm.noteOn(62, 100);
+    REQUIRE(heldNotes() == std::vector<int>({ 62, 62, 67, 70 }));
+    vm.noteOff(62);
+    REQUIRE(heldNotes() == std::vector<int>({ 67, 70 }));
+    REQUIRE(vm.getReleasedVoiceIndices().size() == 2);
+    vm.tick(input.data(), input.data(), left.data(), right.data());
+    REQUIRE(vm.getReleasedVoiceIndices().empty());
+    REQUIRE(vm.getIdleVoiceIndices().size() == 2);
+    REQUIRE(vm.getActiveVoiceIndices().size() == 2);
+    REQUIRE(vm.getNumActiveVoices() == 2);
+    std::vector<int> visitedVoices;
+    vm.forEachActiveVoice([&visitedVoices](int a_voiceIndex) { visitedVoices.push_back(a_voiceIndex); });
+    REQUIRE(visitedVoices == vm.getActiveVoiceIndices());
+
+    // Polyphony is not capped
+    vm.setMaxVoices(128);
+    REQUIRE(vm.getMaxVoices() == 128);
+    for (int note = 0; note < 128; note++)
+        vm.noteOn(note, 100);
+    vm.tick(input.data(), input.data(), left.data(), right.data());
+    REQUIRE(vm.getActiveVoiceIndices().size() == 128);
+    std::vector<int> allNotes(128);
+    std::iota(allNotes.begin(), allNotes.end(), 0);
+    REQUIRE(heldNotes() == allNotes);
+    for (int note = 0; note < 128; note++)
+        vm.noteOff(note);
+    vm.tick(input.data(), input.data(), left.data(), right.data());
+    REQUIRE(vm.getIdleVoiceIndices().size() == 128);
+}
+
+TEST_CASE("Check that the global circuit processes the voice mix once", "[VoiceManager]") {
+    const int bufSize = 32;
+    syn::Circuit proto("main");
+    proto.beginEdit();
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    int svfId = proto.addUnit(new syn::TrapStateVariableFilter("svf"));
+    proto.connectInternal(oscId, 0, svfId, 0);
+    proto.connectInternal(oscId, 0, proto.getOutputUnitId(), 0);
+    proto.connectInternal(svfId, 0, proto.getOutputUnitId(), 1);
+    proto.endEdit();
+
+    // Left output is the sum of both channels of the mix, right output is the left channel of the mix
+    syn::Circuit global("global");
+    global.beginEdit();
+    int sumId = global.addUnit(new syn::SummerUnit("sum"));
+    global.connectInternal(global.getInputUnitId(), 0, sumId, 0);
+    global.connectInternal(global.getInputUnitId(), 1, sumId, 1);
+    global.connectInternal(sumId, 0, global.getOutputUnitId(), 0);
+    global.connectInternal(global.getInputUnitId(), 0, global.getOutputUnitId(), 1);
+    global.endEdit();
+
+    syn::VoiceManager globalVm, referenceVm;
+    for (syn::VoiceManager* vm : { &globalVm, &referenceVm }) {
+        vm->setPrototypeCircuit(proto);
+        vm->setMaxVoices(4);
+        vm->setBufferSize(bufSize);
+        vm->setInternalBufferSize(8);
+        vm->noteOn(60, 100);
+        vm->noteOn(64, 100);
+    }
+    globalVm.setGlobalCircuit(global);
+    REQUIRE(globalVm.getGlobalCircuit().getUnit(sumId).name() == "sum");
+
+    std::vector<syn::Sample> input(bufSize, 0.0);
+    std::vector<syn::Sample> globalOut[2] = { std::vector<syn::Sample>(bufSize), std::vector<syn::Sample>(bufSize) };
+    std::vector<syn::Sample> referenceOut[2] = { std::vector<syn::Sample>(bufSize), std::vector<syn::Sample>(bufSize) };
+    for (int tick = 0; tick < 4; tick++) {
+        globalVm.tick(input.data(), input.data(), globalOut[0].data(), globalOut[1].data());
+        referenceVm.tick(input.data(), input.data(), referenceOut[0].data(), referenceOut[1].data());
+        for (int i = 0; i < bufSize; i++) {
+            REQUIRE(globalOut[0][i] == Approx(referenceOut[0][i] + referenceOut[1][i]));
+            REQUIRE(globalOut[1][i] == referenceOut[0][i]);
+        }
+    }
+
+    // The default global circuit passes the mix through untouched
+    globalVm.resetGlobalCircuit();
+    globalVm.tick(input.data(), input.data(), globalOut[0].data(), globalOut[1].data());
+    referenceVm.tick(input.data(), input.data(), referenceOut[0].data(), referenceOut[1].data());
+    REQUIRE(globalOut[0] == referenceOut[0]);
+    REQUIRE(globalOut[1] == referenceOut[1]);
+}
+
+TEST_CASE("Check that voices share their parameters with the prototype circuit", "[VoiceManager]") {
+    const int bufSize = 32;
+    syn::Circuit proto("main");
+    proto.beginEdit();
+    int envId = proto.addUnit(new syn::ADSREnvelope("env"));
+    proto.connectInternal(envId, 0, proto.getOutputUnitId(), 0);
+    proto.endEdit();
+
+    syn::VoiceManager sharedVm, referenceVm;
+    sharedVm.setPrototypeCircuit(proto);
+    proto.getUnit(envId).setParam(syn::ADSREnvelope::pAtkTime, 0.5);
+    referenceVm.setPrototypeCircuit(proto);
+    for (syn::VoiceManager* vm : { &sharedVm, &referenceVm }) {
+        vm->setMaxVoices(4);
+        vm->setBufferSize(bufSize);
+        vm->setInternalBufferSize(bufSize);
+    }
+
+    // A single write to the prototype reaches every voice
+    syn::Unit& protoEnv = sharedVm.getPrototypeCircuit().getUnit(envId);
+    protoEnv.param(syn::ADSREnvelope::pAtkTime).set(0.5);
+    protoEnv.updateParameters();
+    for (int i = 0; i < 4; i++) {
+        const syn::Unit& voiceEnv = sharedVm.getVoiceCircuit(i).getUnit(envId);
+        REQUIRE(voiceEnv.hasSharedParameters());
+        REQUIRE(&voiceEnv.param(syn::ADSREnvelope::pAtkTime) == &protoEnv.param(syn::ADSREnvelope::pAtkTime));
+    }
+
+    // Voices catch up on the derived state (here, the attack rate) before they are processed
+    std::vector<syn::Sample> input(bufSize, 0.0);
+    std::vector<syn::Sample> sharedOut[2] = { std::vector<syn::Sample>(bufSize), std::vector<syn::Sample>(bufSize) };
+    std::vector<syn::Sample> referenceOut[2] = { std::vector<syn::Sample>(bufSize), std::vector<syn::Sample>(bufSize) };
+    sharedVm.noteOn(60, 100);
+    referenceVm.noteOn(60, 100);
+    for (int tick = 0; tick < 4; tick++) {
+        sharedVm.tick(input.data(), input.data(), sharedOut[0].data(), sharedOut[1].data());
+        referenceVm.tick(input.data(), input.data(), referenceOut[0].data(), referenceOut[1].data());
+        REQUIRE(sharedOut[0] == referenceOut[0]);
+    }
+
+    // A detached voice overrides the parameter without affecting the others
+    syn::Unit& overriddenEnv = sharedVm.getVoiceCircuit(1).getUnit(envId);
+    overriddenEnv.detachParameters();
+    overriddenEnv.setParam(syn::ADSREnvelope::pAtkTime, 0.1);
+    REQUIRE_FALSE(overriddenEnv.hasSharedParameters());
+    REQUIRE(protoEnv.param(syn::ADSREnvelope::pAtkTime).getDouble() == Approx(0.5));
+    REQUIRE(sharedVm.getVoiceCircuit(2).getUnit(envId).param(syn::ADSREnvelope::pAtkTime).getDouble() == Approx(0.5));
+
+    // Clones never share parameters
+    syn::Unit* clone = protoEnv.clone();
+    REQUIRE(clone->param(syn::ADSREnvelope::pAtkTime).getDouble() == Approx(0.5));
+    clone->setParam(syn::ADSREnvelope::pAtkTime, 0.2);
+    REQUIRE(protoEnv.param(syn::ADSREnvelope::pAtkTime).getDouble() == Approx(0.5));
+    delete clone;
+}
+
+TEST_CASE("Check that the command queue runs commands in order and recycles their slots", "[CommandQueue]") {
+    syn::CommandQueue queue(4);
+    std::vector<int> ran;
+    auto token = std::make_shared<int>(0);
+    for (int i = 0; i < 4; i++)
+        REQUIRE(queue.push([&ran, i, token]() { ran.push_back(i); }));
+    REQUIRE_FALSE(queue.push([]() {}));
+    REQUIRE(token.use_count() == 5);
+
+    // The budget bounds how many commands run at once
+    REQUIRE(queue.process(3) == 3);
+    REQUIRE(ran == std::vector<int>({ 0, 1, 2 }));
+    // Commands that ran are only destroyed when the producer collects them
+    REQUIRE(token.use_count() == 5);
+    queue.collect();
+    REQUIRE(token.use_count() == 2);
+
+    REQUIRE(queue.push([&ran]() { ran.push_back(4); }));
+    REQUIRE(queue.process(10) == 2);
+    REQUIRE(ran == std::vector<int>({ 0, 1, 2, 3, 4 }));
+
+    // Commands queued through the voice manager are spread over ticks
+    syn::VoiceManager vm;
+    vm.setMaxActionsPerTick(2);
+    int numRan = 0;
+    for (int i = 0; i < 5; i++)
+        REQUIRE(vm.queueAction([&numRan]() { numRan++; }));
+    syn::Sample input = 0.0, left, right;
+    vm.tick(&input, &input, &left, &right);
+    REQUIRE(numRan == 2);
+    vm.tick(&input, &input, &left, &right);
+    vm.tick(&input, &input, &left, &right);
+    REQUIRE(numRan == 5);
+}
+
+TEST_CASE("Check that the memory pool allocates aligned blocks and merges them when freed", "[MemoryPool]") {
+    const size_t poolSize = 1 << 16;
+    syn::MemoryPool pool(poolSize);
+    const syn::MemoryPool::Stats empty = pool.getStats();
+    REQUIRE(empty.capacity >= poolSize);
+    REQUIRE(empty.largestFreeBlock >= poolSize);
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> sizeDist(1, 2000);
+    std::vector<std::pair<uint8_t*, size_t>> blocks;
+    for (int i = 0; i < 32; i++) {
+        const size_t alignment = size_t(1) << (3 + i % 4);
+        const size_t size = sizeDist(rng);
+        uint8_t* ptr = static_cast<uint8_t*>(pool.allocate(size, alignment));
+        REQUIRE(ptr);
+        REQUIRE(pool.owns(ptr));
+        REQUIRE(reinterpret_cast<uintptr_t>(ptr) % alignment == 0);
+        std::fill(ptr, ptr + size, uint8_t(i));
+        blocks.emplace_back(ptr, size);
+    }
+    REQUIRE(pool.getStats().numAllocations == 32);
+    REQUIRE(pool.getStats().peakBytesUsed == pool.getStats().bytesUsed);
+
+    // Blocks do not overlap, and freeing every other block keeps the rest intact
+    for (int i = 0; i < blocks.size(); i += 2)
+        pool.free(blocks[i].first);
+    for (int i = 1; i < blocks.size(); i += 2)
+        for (size_t j = 0; j < blocks[i].second; j++)
+            REQUIRE(blocks[i].first[j] == uint8_t(i));
+    for (int i = 1; i < blocks.size(); i += 2)
+        pool.free(blocks[i].first);
+
+    // Once everything is freed, neighbours have been merged back into a single block
+    const syn::MemoryPool::Stats freed = pool.getStats();
+    REQUIRE(freed.numAllocations == 0);
+    REQUIRE(freed.bytesUsed == 0);
+    REQUIRE(freed.largestFreeBlock == empty.largestFreeBlock);
+    REQUIRE(freed.peakBytesUsed > 0);
+
+    SECTION("Exhausted pools fall back to the heap") {
+        REQUIRE(pool.allocate(2 * poolSize) == nullptr);
+        REQUIRE(pool.getStats().numFailedAllocations == 1);
+        void* ptr = syn::MemoryPool::allocateFrom(&pool, 2 * poolSize, 64);
+        REQUIRE_FALSE(pool.owns(ptr));
+        syn::MemoryPool::release(&pool, ptr);
+    }
+
+    SECTION("Containers and units built within a scope are allocated from its pool") {
+        syn::MemoryPool::Scope scope(&pool);
+        syn::PoolVector<double> buffer(128, 1.0);
+        REQUIRE(pool.owns(buffer.data()));
+        std::unique_ptr<syn::Unit> unit(new syn::VariableMemoryUnit("delay"));
+        REQUIRE(pool.owns(unit.get()));
+        REQUIRE(reinterpret_cast<uintptr_t>(unit.get()) % 64 == 0);
+        unit->setBufferSize(64);
+        REQUIRE(pool.owns(unit->output(0).buf()));
+        {
+            syn::MemoryPool::Scope heapScope(nullptr);
+            syn::PoolVector<double> heapBuffer(128, 1.0);
+            REQUIRE_FALSE(pool.owns(heapBuffer.data()));
+            // Copies made within a scope belong to it, wherever the original came from
+            syn::PoolVector<double> copy(buffer);
+            REQUIRE_FALSE(pool.owns(copy.data()));
+        }
+        unit.reset();
+        buffer = syn::PoolVector<double>();
+        REQUIRE(pool.getStats().numAllocations == 0);
+    }
+
+    SECTION("Voices are built in the voice manager's pool") {
+        syn::VoiceManager vm;
+        vm.getPrototypeCircuit().addUnit(new syn::BasicOscillatorUnit("osc"));
+        vm.setMaxVoices(4);
+        const syn::MemoryPool::Stats voiceStats = vm.getVoiceMemoryStats();
+        REQUIRE(voiceStats.capacity >= 4 * vm.getVoiceMemoryBudget());
+        REQUIRE(voiceStats.numAllocations > 0);
+        REQUIRE(voiceStats.numFailedAllocations == 0);
+    }
+}
+
+TEST_CASE("Check that each voice is laid out in its own slice of the voice arena", "[VoiceManager]") {
+    syn::VoiceManager vm;
+    syn::Circuit& proto = vm.getPrototypeCircuit();
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    int delayId = proto.addUnit(new syn::VariableMemoryUnit("delay"));
+    proto.connectInternal(oscId, 0, delayId, 0);
+    proto.connectInternal(delayId, 0, proto.getOutputUnitId(), 0);
+    vm.setInternalBufferSize(32);
+    vm.setBufferSize(32);
+
+    auto checkLayout = [&](int a_numVoices) {
+        std::vector<syn::VoiceManager::VoiceMemoryRegion> regions = vm.getVoiceMemoryMap();
+        REQUIRE(regions.size() == a_numVoices + 1);
+        const uint8_t* arenaBegin = static_cast<const uint8_t*>(regions[0].begin);
+        REQUIRE(regions[0].voice == -1);
+        REQUIRE(regions[0].backing != syn::MemoryPool::ParentBacking);
+        for (int i = 0; i < a_numVoices; i++) {
+            const syn::VoiceManager::VoiceMemoryRegion& region = regions[i + 1];
+            const uint8_t* begin = static_cast<const uint8_t*>(region.begin);
+            REQUIRE(region.voice == i);
+            REQUIRE(region.backing == syn::MemoryPool::ParentBacking);
+            REQUIRE(begin >= arenaBegin);
+            REQUIRE(begin + region.numBytes <= arenaBegin + regions[0].numBytes);
+            REQUIRE(region.stats.numAllocations > 0);
+            REQUIRE(region.stats.numFailedAllocations == 0);
+            REQUIRE_FALSE(region.blocks.empty());
+            // Units and their buffers live in the slice of their voice, aligned to cache lines
+            auto inSlice = [&](const void* a_ptr) { return a_ptr >= region.begin && static_cast<const uint8_t*>(a_ptr) < begin + region.numBytes; };
+            const syn::Circuit& voice = vm.getVoiceCircuit(i);
+            for (int unitId : { oscId, delayId, voice.getOutputUnitId() }) {
+                const syn::Unit& unit = voice.getUnit(unitId);
+                REQUIRE(inSlice(&unit));
+                REQUIRE(reinterpret_cast<uintptr_t>(&unit) % SYN_CACHE_LINE_SIZE == 0);
+            }
+            REQUIRE(inSlice(voice.getUnit(delayId).outputs()[0].buf()));
+            REQUIRE(reinterpret_cast<uintptr_t>(voice.getUnit(delayId).outputs()[0].buf()) % SYN_CACHE_LINE_SIZE == 0);
+        }
+    };
+
+    vm.setMaxVoices(3);
+    checkLayout(3);
+
+    vm.setVoiceMemoryHugePages(true);
+    vm.setMaxVoices(2);
+    checkLayout(2);
+
+    // Voices still render, and their delay lines grow within the arena
+    vm.getPrototypeCircuit().getUnit(delayId).setParam(syn::VariableMemoryUnit::pBufDelay, 0.01);
+    vm.noteOn(60, 127);
+    std::vector<syn::Sample> input(32, 0.0), left(32), right(32);
+    for (int i = 0; i < 32; i++)
+        vm.tick(input.data(), input.data(), left.data(), right.data());
+    REQUIRE(vm.getVoiceMemoryStats().numFailedAllocations == 0);
 }
 
 TEST_CASE("Test resampler", "[Resample]") {
-    Eigen::Matrix<double, 128, 1> original_table = Eigen::Array<double, 128, 1>::LinSpaced(0, 2 * SYN_PI).sin();
+    Eigen::Matrix<syn::Sample, 128, 1> original_table = Eigen::Array<syn::Sample, 128, 1>::LinSpaced(0, 2 * SYN_PI).sin();
 
-    Eigen::Matrix<double, 128, 1> identical_table;
-    Eigen::Matrix<double, 250, 1> upsampled_table;
-    Eigen::Matrix<double, 33, 1> downsampled_table;
+    Eigen::Matrix<syn::Sample, 128, 1> identical_table;
+    Eigen::Matrix<syn::Sample, 250, 1> upsampled_table;
+    Eigen::Matrix<syn::Sample, 33, 1> downsampled_table;
     
     for (int i = 0; i < identical_table.size(); i++) {
         double phase = i * (1.0 / identical_table.size());
@@ -262,6 +1299,291 @@ TEST_CASE("Test resampler", "[Resample]") {
     std::cout << "downsampled=array(" << downsampled_table.format(listFmt) << ")" << std::endl;
 }
 
+TEST_CASE("Check that the polyphase sinc filter bank matches the sinc resampler", "[Resample]") {
+    const syn::ResampledTable& table = syn::lut_bl_saw_table();
+    const syn::BlimpTable& blimp = syn::lut_blimp_table_online();
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> phases(0.0, 1.0);
+
+    SECTION("Each phase of the bank has unity gain") {
+        syn::SincFilterBank bank(blimp, 0.7);
+        REQUIRE(bank.numTaps() % 4 == 0);
+        REQUIRE(bank.numTaps() >= blimp.taps / 0.7);
+        for (int phase = 0; phase <= bank.numPhases(); phase++) {
+            const syn::Sample* taps = bank.taps(phase);
+            REQUIRE(std::accumulate(taps, taps + bank.numTaps(), 0.0) == Approx(1.0));
+        }
+    }
+
+    SECTION("The bank agrees with the resampler for upsampling and downsampling") {
+        for (double ratio : { 2.3, 1.0, 0.93, 0.7, 0.51 }) {
+            syn::SincFilterBank bank(blimp, syn::MIN(1.0, ratio));
+            double max_error = 0.0;
+            for (int i = 0; i < 1000; i++) {
+                // Also land on the edges of the table, where the taps wrap around
+                const double phase = i < 10 ? i * 0.0001 : i < 20 ? 1.0 - i * 0.0001 : phases(rng);
+                const double reference = syn::getresampled_single(table.data(), table.m_size, phase, ratio * table.m_size, blimp);
+                const double filtered = syn::getresampled_single(table.data(), table.m_size, phase, bank);
+                max_error = std::max(max_error, std::abs(reference - filtered));
+            }
+            INFO("ratio " << ratio);
+            REQUIRE(max_error < 1e-3);
+        }
+    }
+
+    SECTION("The number of phases and taps can be traded for accuracy") {
+        syn::SincFilterBank bank(blimp, 1.0, 16, 6);
+        REQUIRE(bank.numPhases() == 16);
+        REQUIRE(bank.numTaps() == 8);
+        const syn::Sample* small_table = syn::lut_sin_table().data();
+        const int small_size = syn::lut_sin_table().m_size;
+        for (int i = 0; i < 100; i++) {
+            const double phase = phases(rng);
+            REQUIRE(syn::getresampled_single(small_table, small_size, phase, bank) == Approx(sin(2 * SYN_PI * phase)).margin(1e-3));
+        }
+    }
+
+    SECTION("Tables resampled through their banks stay close to the resampler") {
+        for (double period : { 3000.0, 1024.0, 700.7, 150.3, 40.5, 12.3 }) {
+            double error = 0.0, power = 0.0;
+            for (int i = 0; i < 512; i++) {
+                const double phase = i / 512.0;
+                const double ratio = period / table.m_size;
+                const int level = syn::CLAMP<int>(floor(-log2(ratio)), 0, static_cast<int>(table.resampledTables().size()) - 1);
+                const std::vector<syn::Sample>& resampled = table.resampledTables()[level];
+                const double reference = syn::getresampled_single(resampled.data(), resampled.size(), phase, period, blimp);
+                const double output = table.getResampled(phase, period);
+                error += (reference - output) * (reference - output);
+                power += reference * reference;
+            }
+            INFO("period " << period);
+            REQUIRE(sqrt(error / power) < 0.05);
+        }
+    }
+}
+
+TEST_CASE("Check that resampled tables can be generated in the background and cached on disk", "[Resample]") {
+    const syn::ResampledTable& saw = syn::lut_bl_saw_table();
+    const syn::BlimpTable& online = syn::lut_blimp_table_online();
+    const syn::BlimpTable& offline = syn::lut_blimp_table_offline();
+    const std::vector<std::vector<syn::Sample>> reference = saw.resampledTables();
+
+    SECTION("Tables generated in the background match tables generated up front") {
+        syn::ResampledTable::setBackgroundGeneration(true);
+        syn::ResampledTable table(saw.data(), saw.m_size, online, offline);
+        syn::ResampledTable::setBackgroundGeneration(false);
+        // Lookups never wait for the generation
+        const double sample = table.getResampled(0.25, 100.0);
+        REQUIRE(std::abs(sample - saw.getResampled(0.25, 100.0)) < 0.1);
+        table.waitUntilReady();
+        REQUIRE(table.isReady());
+        REQUIRE(table.resampledTables() == reference);
+        REQUIRE(table.getResampled(0.25, 100.0) == saw.getResampled(0.25, 100.0));
+    }
+
+    SECTION("Tables are saved to the cache and loaded back from it") {
+        syn::ResampledTable::setCacheDirectory(".");
+        const std::string path = [&saw]() {
+            std::ostringstream name;
+            name << "./resampled_table_" << std::hex << saw.cacheKey() << ".bin";
+            return name.str();
+        }();
+        std::remove(path.c_str());
+
+        {
+            syn::ResampledTable table(saw.data(), saw.m_size, online, offline);
+            REQUIRE(table.resampledTables() == reference);
+            REQUIRE(std::ifstream(path, std::ios::binary).good());
+        }
+
+        // Tag the last sample of the file, to tell a loaded table from a generated one
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(-static_cast<int>(sizeof(syn::Sample)), std::ios::end);
+            const syn::Sample tag = 42;
+            file.write(reinterpret_cast<const char*>(&tag), sizeof(tag));
+        }
+        {
+            syn::ResampledTable table(saw.data(), saw.m_size, online, offline);
+            REQUIRE(table.resampledTables().back().back() == 42);
+        }
+
+        // A truncated file is ignored and replaced
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write("VRST", 4);
+        }
+        {
+            syn::ResampledTable table(saw.data(), saw.m_size, online, offline);
+            REQUIRE(table.resampledTables() == reference);
+        }
+        {
+            syn::ResampledTable table(saw.data(), saw.m_size, online, offline);
+            REQUIRE(table.resampledTables() == reference);
+        }
+
+        // Different tables are cached under different keys
+        syn::ResampledTable square(syn::lut_bl_square_table().data(), saw.m_size, online, offline);
+        REQUIRE(square.cacheKey() != saw.cacheKey());
+        syn::ResampledTable::setCacheDirectory("");
+        std::remove(path.c_str());
+        std::ostringstream square_path;
+        square_path << "./resampled_table_" << std::hex << square.cacheKey() << ".bin";
+        std::remove(square_path.str().c_str());
+    }
+}
+
+TEST_CASE("Check that copies of resampled tables share their storage", "[Resample]") {
+    const syn::ResampledTable& saw = syn::lut_bl_saw_table();
+    std::unique_ptr<syn::ResampledTable> original(new syn::ResampledTable(saw.data(), saw.m_size, syn::lut_blimp_table_online(), syn::lut_blimp_table_offline()));
+    syn::ResampledTable copy(*original);
+    REQUIRE(copy.mipLevel(0) == original->mipLevel(0));
+    REQUIRE(&copy.resampledTables() == &original->resampledTables());
+    REQUIRE(copy.cacheKey() == original->cacheKey());
+
+    // The shared storage outlives the table it was built for
+    const double expected = original->getResampled(0.3, 123.4);
+    const double expected_mipmapped = original->getMipmapped(0.3, 123.4);
+    original.reset();
+    REQUIRE(copy.getResampled(0.3, 123.4) == expected);
+    REQUIRE(copy.getMipmapped(0.3, 123.4) == expected_mipmapped);
+
+    // Copies made while the tables are generated in the background see them once they are ready
+    syn::ResampledTable::setBackgroundGeneration(true);
+    std::vector<syn::ResampledTable> copies;
+    {
+        syn::ResampledTable table(saw.data(), saw.m_size, syn::lut_blimp_table_online(), syn::lut_blimp_table_offline());
+        syn::ResampledTable::setBackgroundGeneration(false);
+        for (int i = 0; i < 4; i++)
+            copies.emplace_back(table);
+    }
+    for (const syn::ResampledTable& table : copies) {
+        table.waitUntilReady();
+        REQUIRE(table.getResampled(0.3, 123.4) == expected);
+    }
+}
+
+TEST_CASE("Measure interpolation error of tables read from compact storage", "[lut]") {
+    const int size = 1024;
+    const double min = -0.25, max = 0.75;
+    std::vector<syn::Sample> native(size);
+    std::vector<float> float32(size);
+    std::vector<int16_t> int16(size);
+    const double scale = 0.5 * (max - min) / 32767.0, offset = 0.5 * (max + min);
+    for (int i = 0; i < size; i++) {
+        const double x = offset + 0.5 * (max - min) * std::sin(2 * SYN_PI * i / size);
+        native[i] = x;
+        float32[i] = x;
+        int16[i] = static_cast<int16_t>(std::round((x - offset) / scale));
+    }
+
+    syn::NormalTable native_table({syn::TableStorage::Native, native.data(), size, 1.0, 0.0});
+    syn::NormalTable float32_table({syn::TableStorage::Float32, float32.data(), size, 1.0, 0.0});
+    syn::NormalTable int16_table({syn::TableStorage::Int16, int16.data(), size, scale, offset});
+    REQUIRE(native_table.data() == native.data());
+    REQUIRE(int16_table.m_size == size);
+
+    double native_error = 0, float32_error = 0, int16_error = 0;
+    for (int i = 0; i < 10 * size; i++) {
+        const double phase = i * 0.1 / size;
+        const double expected = offset + 0.5 * (max - min) * std::sin(2 * SYN_PI * phase);
+        native_error = std::max(native_error, std::abs(native_table.plerp(phase) - expected));
+        float32_error = std::max(float32_error, std::abs(float32_table.plerp(phase) - expected));
+        int16_error = std::max(int16_error, std::abs(int16_table.plerp(phase) - expected));
+    }
+    INFO("native: " << native_error << " float32: " << float32_error << " int16: " << int16_error);
+    REQUIRE(native_error < 1e-5);
+    REQUIRE(float32_error < 1e-5);
+    REQUIRE(int16_error < 5e-5);
+
+    // Copies keep the decoded samples alive
+    std::unique_ptr<syn::NormalTable> original(new syn::NormalTable({syn::TableStorage::Int16, int16.data(), size, scale, offset}));
+    syn::NormalTable copy(*original);
+    REQUIRE(copy.data() == original->data());
+    const double expected = original->plerp(0.3);
+    original.reset();
+    REQUIRE(copy.plerp(0.3) == expected);
+
+    // The generated tables stay accurate in whichever format they were generated in
+    double sin_error = 0, pitch_error = 0;
+    for (int i = 0; i < 10000; i++) {
+        const double phase = i / 10000.0;
+        sin_error = std::max(sin_error, std::abs(syn::lut_sin_table().plerp(phase) - std::sin(2 * SYN_PI * phase)));
+        const double note = 127.0 * i / 10000.0;
+        const double freq = 440.0 * std::pow(2.0, (note - 69.0) / 12.0);
+        pitch_error = std::max(pitch_error, std::abs(syn::lut_pitch_table().lerp(note) - freq) / freq);
+    }
+    INFO("sin: " << sin_error << " pitch: " << pitch_error);
+    REQUIRE(sin_error < 5e-5);
+    REQUIRE(pitch_error < 1e-4);
+}
+
+TEST_CASE("Check that mipmapped tables are band-limited and agree with the sinc resampler", "[Resample]") {
+    const syn::ResampledTable& table = syn::lut_bl_saw_table();
+    REQUIRE(table.numMipLevels() > 1);
+    REQUIRE(table.mipLevelHarmonics(table.numMipLevels() - 1) == 1);
+
+    Eigen::FFT<double> fft;
+    fft.SetFlag(fft.HalfSpectrum);
+    std::vector<double> base(table.data(), table.data() + table.m_size);
+    std::vector<std::complex<double>> base_spectrum;
+    fft.fwd(base_spectrum, base);
+
+    SECTION("Each level keeps the harmonics of the table up to its limit, and nothing above") {
+        for (int level = 0; level < table.numMipLevels(); level++) {
+            const int size = table.mipLevelSize(level);
+            const int harmonics = table.mipLevelHarmonics(level);
+            REQUIRE((size & (size - 1)) == 0);
+            REQUIRE(harmonics < size / 2);
+            if (level > 0)
+                REQUIRE(harmonics <= table.mipLevelHarmonics(level - 1));
+
+            std::vector<double> samples(table.mipLevel(level), table.mipLevel(level) + size);
+            std::vector<std::complex<double>> spectrum;
+            fft.fwd(spectrum, samples);
+            double max_kept_error = 0.0, max_removed = 0.0;
+            for (int h = 0; h <= size / 2; h++) {
+                const std::complex<double> normalized = spectrum[h] / (0.5 * size);
+                if (h <= harmonics)
+                    max_kept_error = std::max(max_kept_error, std::abs(normalized - base_spectrum[h] / (0.5 * table.m_size)));
+                else
+                    max_removed = std::max(max_removed, std::abs(normalized));
+            }
+            INFO("level " << level << " size " << size << " harmonics " << harmonics);
+            REQUIRE(max_kept_error < 1e-5);
+            REQUIRE(max_removed < 1e-5);
+        }
+    }
+
+    SECTION("Mipmapped samples are close to the resampled ones") {
+        for (double period : { 12.3, 40.5, 150.3, 700.7, 3000.0 }) {
+            double error = 0.0, power = 0.0;
+            const int num_samples = 512;
+            for (int i = 0; i < num_samples; i++) {
+                const double phase = i * 1.0 / num_samples;
+                const double reference = table.getResampled(phase, period);
+                const double mipmapped = table.getMipmapped(phase, period);
+                error += (reference - mipmapped) * (reference - mipmapped);
+                power += reference * reference;
+            }
+            INFO("period " << period);
+            REQUIRE(sqrt(error / power) < 0.1);
+        }
+    }
+
+    SECTION("Sweeping the period does not make the output jump between levels") {
+        for (double phase : { 0.3, 0.7 }) {
+            double last = table.getMipmapped(phase, 2.0);
+            for (double period = 2.0; period < 2.0 * table.m_size; period *= 1.001) {
+                const double current = table.getMipmapped(phase, period);
+                INFO("phase " << phase << " period " << period);
+                REQUIRE(std::abs(current - last) < 0.01);
+                last = current;
+            }
+        }
+    }
+}
+
 TEST_CASE("Check IntMap use cases", "[IntMap]") {
     syn::IntMap<int, 8> nc;
     std::array<int, 8> nc_vec{};
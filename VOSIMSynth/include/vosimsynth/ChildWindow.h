@@ -25,11 +25,7 @@ Copyright 2016, Austen Satterlee
 using SystemHandle = HWND;
 #endif
 
-#include <boost/lockfree/spsc_queue.hpp>
-
-namespace syn {
-    class Command;
-}
+#include <vosimlib/CommandQueue.h>
 
 struct GLFWwindow;
 
@@ -47,9 +43,11 @@ namespace synui {
         /// Close the system window (the GUI is preserved)
         void closeWindow();
         /// Queue a task (to be called only from the real-time thread)
-        bool queueExternalMessage(syn::Command* a_msg);
+        template <typename F>
+        bool queueExternalMessage(F&& a_msg) { return m_guiExternalMsgQueue.push(std::forward<F>(a_msg)); }
         /// Queue a task (to be called only from the GUI thread)
-        bool queueInternalMessage(syn::Command* a_msg);
+        template <typename F>
+        bool queueInternalMessage(F&& a_msg) { return m_guiInternalMsgQueue.push(std::forward<F>(a_msg)); }
         int getWidth() const;
         int getHeight() const;
 
@@ -75,7 +73,7 @@ namespace synui {
         GLFWwindow* m_window;
         bool m_isOpen;
 
-        boost::lockfree::spsc_queue<syn::Command*> m_guiInternalMsgQueue;
-        boost::lockfree::spsc_queue<syn::Command*> m_guiExternalMsgQueue;
+        syn::CommandQueue m_guiInternalMsgQueue;
+        syn::CommandQueue m_guiExternalMsgQueue;
     };
 }
@@ -3,24 +3,25 @@
 
 #include <IPlug/IPlug_include_in_plug_hdr.h>
 #include <IPlug/IMidiQueue.h>
+#include <vosimlib/VoiceManager.h>
+#include <vector>
 
 namespace syn {
 
-    class VoiceManager;
-
     /**
      * \brief Midi queue handler
+     *
+     * Translates the MIDI messages received during a block into timestamped events for VoiceManager::tick.
      */
     class MIDIReceiver
     {
     public:
-        explicit MIDIReceiver(VoiceManager& a_vm) 
-            : m_offset(0),
-              m_vm(a_vm) 
+        MIDIReceiver()
         {
             for (int i = 0; i < s_keyCount; i++) {
                 m_keyStatus[i] = false;
             }
+            m_events.reserve(s_initialEventCapacity);
         };
 
         // Returns true if the key with a given index is currently pressed
@@ -28,7 +29,11 @@ namespace syn {
             return m_keyStatus[keyIndex];
         }
 
-        void advance();
+        /**
+         * Collect the events of the first \p nFrames samples, sorted by offset. The returned list stays valid
+         * until the next call.
+         */
+        const std::vector<MidiEvent>& gatherEvents(int nFrames);
 
         void onMessageReceived(IMidiMsg* midiMessage);
 
@@ -39,9 +44,9 @@ namespace syn {
     private:
         IMidiQueue m_midiQueue;
         static const int s_keyCount = 128;
+        static const int s_initialEventCapacity = 1024;
         bool m_keyStatus[s_keyCount]; // array of on/off for each key (index is note number)
-        int m_offset;
-        VoiceManager& m_vm;
+        std::vector<MidiEvent> m_events;
     };
 }
 
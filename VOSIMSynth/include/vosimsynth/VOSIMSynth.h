@@ -36,6 +36,7 @@ public:
     void makeGraphics();
     void makeInstrument();
     void Reset() override;
+    void OnActivate(bool active) override;
     void ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames) override;
     void ProcessMidiMsg(IMidiMsg* pMsg) override;
     bool SerializeState(ByteChunk* pChunk) override;
@@ -52,6 +53,10 @@ private:
 
     int m_tempo;
     unsigned m_tickCount;
+#if defined(VOSIMLIB_SINGLE_PRECISION)
+    /// The host always hands us doubles, so a single precision engine renders through these buffers.
+    std::vector<syn::Sample> m_sampleBuffers[4];
+#endif
 };
 
 #endif
@@ -66,6 +66,10 @@ namespace synui {
         void _processPeriodic();
         void _processNonPeriodic();
         void _sync();
+        /**
+         * Display \p a_numSamples input samples, decimated so that they fit in the scope buffers.
+         */
+        void _setScopeSize(int a_numSamples);
 
     private:
         int m_readIndex;
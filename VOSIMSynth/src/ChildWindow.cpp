@@ -1,7 +1,6 @@
 #include "vosimsynth/ChildWindow.h"
 #include "vosimsynth/MainGUI.h"
 #include "vosimsynth/common.h"
-#include <vosimlib/Command.h>
 #include <vosimlib/Logging.h>
 #include <GLFW/glfw3.h>
 
@@ -149,24 +148,6 @@ void synui::ChildWindow::closeWindow() {
     }
 }
 
-bool synui::ChildWindow::queueExternalMessage(syn::Command* a_msg) {
-    SYN_TIMING_TRACE
-    if (!m_guiExternalMsgQueue.write_available()) {
-        return false;
-    }
-    m_guiExternalMsgQueue.push(a_msg);
-    return true;
-}
-
-bool synui::ChildWindow::queueInternalMessage(syn::Command* a_msg) {
-    SYN_TIMING_TRACE
-    if (!m_guiInternalMsgQueue.write_available()) {
-        return false;
-    }
-    m_guiInternalMsgQueue.push(a_msg);
-    return true;
-}
-
 int synui::ChildWindow::getWidth() const {
     int width;
     glfwGetWindowSize(m_window, &width, nullptr);
@@ -180,14 +161,6 @@ int synui::ChildWindow::getHeight() const {
 }
 
 void synui::ChildWindow::_flushMessageQueues() {
-    syn::Command* msg;
-    while (m_guiInternalMsgQueue.pop(msg)) {
-        (*msg)();
-        delete msg;
-
-    }
-    while (m_guiExternalMsgQueue.pop(msg)) {
-        (*msg)();
-        delete msg;
-    }
+    m_guiInternalMsgQueue.process(m_guiInternalMsgQueue.capacity());
+    m_guiExternalMsgQueue.process(m_guiExternalMsgQueue.capacity());
 }
\ No newline at end of file
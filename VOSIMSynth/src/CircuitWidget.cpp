@@ -9,7 +9,6 @@
 #include "vosimsynth/widgets/CircuitWire.h"
 #include "vosimsynth/VOSIMTheme.h"
 #include <vosimlib/VoiceManager.h>
-#include <vosimlib/Command.h>
 #include <vosimlib/units/MathUnits.h>
 #include <GLFW/glfw3.h>
 #include <unordered_set>
@@ -252,17 +251,14 @@ void synui::CircuitWidget::createInputOutputUnits_() {
 void synui::CircuitWidget::createUnit(syn::UnitTypeId a_classId) {
     auto unit = syn::UnitFactory::instance().createUnit(a_classId);
     auto f = [this, unit]() {
-                for (int i = 0; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).addUnit(unit->clone());
-                }
-                int unitId = m_vm->getPrototypeCircuit().addUnit(unit);
+                int unitId = m_vm->addUnit(unit);
                 // Queue return message
                 auto f = [this, unitId]() {
                             _changeState(new cwstate::CreatingUnitState(unitId));
                         };
-                m_window->queueExternalMessage(syn::MakeCommand(f));
+                m_window->queueExternalMessage(f);
             };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 synui::UnitWidget* synui::CircuitWidget::createUnitWidget(syn::UnitTypeId a_classId, int a_unitId) {
@@ -301,7 +297,7 @@ void synui::CircuitWidget::deleteUnit(int a_unitId) {
                 }
                 m_vm->getPrototypeCircuit().removeUnit(a_unitId);
             };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 void synui::CircuitWidget::deleteConnection(const Port& a_inputPort, const Port& a_outputPort) {
@@ -335,9 +331,9 @@ void synui::CircuitWidget::deleteConnection(const Port& a_inputPort, const Port&
                             updateUnitPos(fromWidget, fromWidget->position(), true);
                             updateUnitPos(toWidget, toWidget->position(), true);
                         };
-                m_window->queueExternalMessage(syn::MakeCommand(f));
+                m_window->queueExternalMessage(f);
             };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 void synui::CircuitWidget::createConnection(const Port& a_inputPort, const Port& a_outputPort) {
@@ -354,10 +350,10 @@ void synui::CircuitWidget::createConnection(const Port& a_inputPort, const Port&
                 auto f = [this, a_outputPort, a_inputPort]() {
                             this->createWireWidget(a_inputPort, a_outputPort);
                         };
-                m_window->queueExternalMessage(syn::MakeCommand(f));
+                m_window->queueExternalMessage(f);
             };
 
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 void synui::CircuitWidget::createWireWidget(const Port& a_inputPort, const Port& a_outputPort) {
@@ -482,10 +478,7 @@ void synui::CircuitWidget::deleteUnitWidget(UnitWidget* widget) {
 void synui::CircuitWidget::createJunction(std::shared_ptr<CircuitWire> a_toWire, std::shared_ptr<CircuitWire> a_fromWire, const Vector2i& a_pos, syn::UnitTypeId a_classId) {
     auto unit = syn::UnitFactory::instance().createUnit(a_classId);
     auto f = [this, unit, a_toWire, a_fromWire, a_pos]() {
-                for (int i = 0; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).addUnit(unit->clone());
-                }
-                int unitId = m_vm->getPrototypeCircuit().addUnit(unit);
+                int unitId = m_vm->addUnit(unit);
                 // Queue return message
                 auto f = [this, unit, unitId, a_toWire, a_fromWire, a_pos]() {
                             UnitWidget* uw = createUnitWidget(unit->getClassIdentifier(), unitId);
@@ -506,18 +499,15 @@ void synui::CircuitWidget::createJunction(std::shared_ptr<CircuitWire> a_toWire,
                                 _changeState(new cwstate::CreatingUnitState(unitId, onSuccess));
                             }
                         };
-                m_window->queueExternalMessage(syn::MakeCommand(f));
+                m_window->queueExternalMessage(f);
             };
-    m_window->queueExternalMessage(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 void synui::CircuitWidget::spliceWire(std::shared_ptr<CircuitWire> a_wire, const Eigen::Vector2i& a_pos, syn::UnitTypeId a_classId) {
     auto unit = syn::UnitFactory::instance().createUnit(a_classId);
     auto f = [this, unit, a_wire, a_pos]() {
-        for (int i = 0; i < m_vm->getMaxVoices(); i++) {
-            m_vm->getVoiceCircuit(i).addUnit(unit->clone());
-        }
-        int unitId = m_vm->getPrototypeCircuit().addUnit(unit);
+        int unitId = m_vm->addUnit(unit);
         // Queue return message
         auto f = [this, unit, unitId, a_wire, a_pos]() {
             UnitWidget* uw = createUnitWidget(unit->getClassIdentifier(), unitId);
@@ -537,9 +527,9 @@ void synui::CircuitWidget::spliceWire(std::shared_ptr<CircuitWire> a_wire, const
                 _changeState(new cwstate::CreatingUnitState(unitId, onSuccess));
             }
         };
-        m_window->queueExternalMessage(syn::MakeCommand(f));
+        m_window->queueExternalMessage(f);
     };
-    m_window->queueExternalMessage(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 void synui::CircuitWidget::_changeState(cwstate::State* a_state) {
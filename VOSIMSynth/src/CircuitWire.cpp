@@ -10,8 +10,6 @@ std::string synui::CircuitWire::info() const {
     std::ostringstream os;
 
     // List current output value for this wire held by each active voice
-    std::vector<int> activeVoiceIndices = m_parentCircuit->m_vm->getActiveVoiceIndices();
-    std::sort(activeVoiceIndices.begin(), activeVoiceIndices.end());
     {
         const syn::Unit& unit = m_parentCircuit->m_vm->getUnit(m_outputPort.first);
         std::ostringstream portInfo, portAddress;
@@ -21,11 +19,11 @@ std::string synui::CircuitWire::info() const {
         os << portInfo.str() << portAddress.str() << std::endl;
     }
     os << std::setprecision(4) << std::showpos << std::showpoint;
-    for (int vind : activeVoiceIndices) {
+    m_parentCircuit->m_vm->forEachActiveVoice([this, &os](int vind) {
         const syn::Unit& unit = m_parentCircuit->m_vm->getUnit(m_outputPort.first, vind);
-        double value = unit.readOutput(m_outputPort.second, 0);
+        double value = unit.lastOutput(m_outputPort.second);
         os << "Voice " << vind << ": " << std::setprecision(4) << std::showpos << value << std::endl;
-    }
+    });
     return os.str();
 }
 
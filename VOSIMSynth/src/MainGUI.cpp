@@ -8,7 +8,6 @@
 #include "vosimsynth/VOSIMTheme.h"
 #include <vosimlib/Logging.h>
 #include <vosimlib/VoiceManager.h>
-#include <vosimlib/Command.h>
 #include <vosimlib/UnitFactory.h>
 #include <nanogui/vscrollpanel.h>
 #include <nanogui/tabwidget.h>
@@ -141,11 +140,9 @@ void synui::MainGui::createSettingsEditor_(nanogui::Widget* a_widget) {
     helper->addGroup("Plugin Settings");
 
     helper->addSerializableVariable<int>("max_voices", "Max voices", [this, helper](const int& maxVoices) {
-        auto f = [this, maxVoices, helper]() {
-            m_vm->setMaxVoices(maxVoices);
-            helper->refresh();
-        };
-        m_vm->queueAction(syn::MakeCommand(f));
+        // Builds the new voices here and hands them to the audio thread
+        m_vm->setMaxVoices(maxVoices);
+        helper->refresh();
     }, [this]() {
         return m_vm->getMaxVoices();
     });
@@ -155,18 +152,25 @@ void synui::MainGui::createSettingsEditor_(nanogui::Widget* a_widget) {
             m_vm->setInternalBufferSize(size);
             helper->refresh();
         };
-        m_vm->queueAction(syn::MakeCommand(f));
+        m_vm->queueAction(f);
     }, [this]() {
         return m_vm->getInternalBufferSize();
     });
 
+    // Reconfiguring the worker pool is safe while the audio thread is running, so it is not queued.
+    helper->addSerializableVariable<int>("worker_threads", "Worker threads", [this](const int& numThreads) {
+        m_vm->setNumWorkerThreads(std::max(0, numThreads));
+    }, [this]() {
+        return m_vm->getNumWorkerThreads();
+    });
+
     using VoiceStealPolicy = syn::VoiceManager::VoiceStealPolicy;
     helper->addVariable<VoiceStealPolicy>("Voice Stealing", [this, helper](const VoiceStealPolicy& policy) {
         auto f = [this, policy, helper]() {
             m_vm->setVoiceStealPolicy(policy);
             helper->refresh();
         };
-        m_vm->queueAction(syn::MakeCommand(f));
+        m_vm->queueAction(f);
     }, [this]() {
         return m_vm->getVoiceStealPolicy();
     })->setItems({ "Oldest", "Newest", "Highest", "Lowest" });
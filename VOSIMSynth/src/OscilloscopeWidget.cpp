@@ -60,11 +60,8 @@ namespace synui {
     void OscilloscopeUnit::onParamChange_(int a_paramId) {
         switch (a_paramId) {
         case pBufSize:
-        {
-            m_subPeriod = param(pBufSize).getInt() / MAX_BUF + 1;
-            m_bufSize = param(pBufSize).getInt() / m_subPeriod;
+            _setScopeSize(param(pBufSize).getInt());
             break;
-        }
         default:
             break;
         }
@@ -121,7 +118,7 @@ namespace synui {
 
     void OscilloscopeUnit::_sync() {
         m_syncCount++;
-        int numPeriods = param(pNumPeriods).getInt();
+        int numPeriods = READ_PARAM_INT(pNumPeriods);
         if (m_syncCount >= numPeriods) {
             double bufSize = m_samplesSinceLastSync;
             const double period = m_samplesSinceLastSync * (1.0 / numPeriods);
@@ -130,14 +127,20 @@ namespace synui {
                 bufSize -= period;
                 numPeriods--;
             }
-            setParam(pBufSize, bufSize * m_subPeriod);
-            setParam(pNumPeriods, numPeriods);
+            // The parameters are shared by every voice, so the measured size is only kept by this unit
+            _setScopeSize(static_cast<int>(bufSize * m_subPeriod));
             m_samplesSinceLastSync = 0;
             m_syncCount = 0;
             m_writeIndex = 0;
         }
     }
 
+    void OscilloscopeUnit::_setScopeSize(int a_numSamples) {
+        a_numSamples = syn::CLAMP<int>(a_numSamples, 3 * MAX_SUBP, MAX_BUF * MAX_SUBP);
+        m_subPeriod = a_numSamples / MAX_BUF + 1;
+        m_bufSize = a_numSamples / m_subPeriod;
+    }
+
     void OscilloscopeWidget::draw(NVGcontext* ctx) {
         const auto& circuit = m_vm->getPrototypeCircuit();
         auto unitClassId = circuit.getUnit(m_unitId).getClassIdentifier();
@@ -1,7 +1,6 @@
 #include "vosimsynth/widgets/UnitEditor.h"
 #include "vosimsynth/UI.h"
 #include <vosimlib/VoiceManager.h>
-#include <vosimlib/Command.h>
 #include <nanogui/layout.h>
 #include <nanogui/formhelper.h>
 #include <nanogui/slider.h>
@@ -214,45 +213,46 @@ void synui::UnitEditor::_build()
 void synui::UnitEditor::setParamValue(int a_paramId, double a_val)
 {
     auto f = [this, a_paramId, a_val]() {
-                for (int i = -1; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).getUnit(m_unitId).param(a_paramId).set(a_val);
-                }
+                // Voices share the prototype's parameters and catch up on their own
+                syn::Unit& unit = m_vm->getUnit(m_unitId);
+                unit.param(a_paramId).set(a_val);
+                unit.updateParameters();
                 m_isDirty = true;
             };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 void synui::UnitEditor::setParamNorm(int a_paramId, double a_normval)
 {
     auto f = [this, a_paramId, a_normval]() {
-                for (int i = -1; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).getUnit(m_unitId).param(a_paramId).setNorm(a_normval);
-                }
+                syn::Unit& unit = m_vm->getUnit(m_unitId);
+                unit.param(a_paramId).setNorm(a_normval);
+                unit.updateParameters();
                 m_isDirty = true;
             };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 void synui::UnitEditor::nudgeParam(int a_paramId, double a_logScale, double a_linScale)
 {
     auto f = [this, a_paramId, a_logScale, a_linScale]() {
-                for (int i = -1; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).getUnit(m_unitId).param(a_paramId).nudge(a_logScale, a_linScale);
-                }
+                syn::Unit& unit = m_vm->getUnit(m_unitId);
+                unit.param(a_paramId).nudge(a_logScale, a_linScale);
+                unit.updateParameters();
                 m_isDirty = true;
             };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 void synui::UnitEditor::setParamFromString(int a_paramId, const string& a_str)
 {
     auto f = [this, a_paramId, a_str]() {
-                for (int i = -1; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).getUnit(m_unitId).param(a_paramId).setFromString(a_str);
-                }
+                syn::Unit& unit = m_vm->getUnit(m_unitId);
+                unit.param(a_paramId).setFromString(a_str);
+                unit.updateParameters();
                 m_isDirty = true;
             };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 void synui::UnitEditor::draw(NVGcontext* ctx)
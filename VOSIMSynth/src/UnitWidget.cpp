@@ -4,7 +4,6 @@
 #include "vosimsynth/MainGUI.h"
 #include <vosimlib/Unit.h>
 #include <vosimlib/VoiceManager.h>
-#include <vosimlib/Command.h>
 
 synui::UnitWidget::UnitWidget(CircuitWidget* a_parent, syn::VoiceManager* a_vm, int a_unitId)
     : Widget(a_parent),
@@ -32,7 +31,7 @@ void synui::UnitWidget::setName(const string& a_name) {
         }
         m_vm->getPrototypeCircuit().getUnit(m_unitId).setName(m_name);
     };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 synui::UnitWidget::operator json() const {
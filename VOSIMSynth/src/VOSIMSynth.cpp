@@ -36,17 +36,21 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #include "vosimsynth/widgets/GainUnitWidget.h"
 #include "vosimsynth/widgets/OscilloscopeWidget.h"
 #include "vosimlib/Logging.h"
+#include <thread>
+#include <algorithm>
 
 VOSIMSynth::VOSIMSynth(IPlugInstanceInfo instanceInfo)
     : IPLUG_CTOR(0, 1, instanceInfo),
       m_voiceManager(),
-      m_MIDIReceiver(m_voiceManager),
+      m_MIDIReceiver(),
       m_tempo(0),
       m_tickCount(0)
 {
     SYN_TIMING_TRACE;
     makeInstrument();
     makeGraphics();
+    // Start generating the band-limited tables, without waiting for them
+    syn::ResampledTable::setBackgroundGeneration(true);
     syn::lut_bl_tri_table();
     syn::lut_bl_saw_table();
     syn::lut_bl_square_table();
@@ -64,23 +68,32 @@ void VOSIMSynth::makeInstrument() {
     SYN_TIMING_TRACE;
     registerUnits();
     m_voiceManager.setMaxVoices(8);
+    // Evaluate modulation sources and filter coefficients every 16 samples (about 0.4 ms at 44.1 kHz).
+    m_voiceManager.setControlPeriod(16);
+    // Leave some cores to the host and the GUI.
+    m_voiceManager.setNumWorkerThreads(std::max(0, int(std::thread::hardware_concurrency()) / 2 - 1));
 }
 
 void VOSIMSynth::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames) {
     // Mutex is already locked for us.
 
-    for (int s = 0; s < nFrames; s++) {
-        m_MIDIReceiver.advance();
-    }
-
     // If tempo has changed, notify instrument
     if (m_tempo != GetTempo()) {
         m_tempo = GetTempo();
         m_voiceManager.setTempo(GetTempo());
     }
 
-    // Process samples
-    m_voiceManager.tick(inputs[0], inputs[1], outputs[0], outputs[1]);
+    // Process samples, splitting the block at each MIDI event
+    const std::vector<syn::MidiEvent>& events = m_MIDIReceiver.gatherEvents(nFrames);
+#if defined(VOSIMLIB_SINGLE_PRECISION)
+    std::copy_n(inputs[0], nFrames, m_sampleBuffers[0].data());
+    std::copy_n(inputs[1], nFrames, m_sampleBuffers[1].data());
+    m_voiceManager.tick(m_sampleBuffers[0].data(), m_sampleBuffers[1].data(), m_sampleBuffers[2].data(), m_sampleBuffers[3].data(), events.data(), int(events.size()));
+    std::copy_n(m_sampleBuffers[2].data(), nFrames, outputs[0]);
+    std::copy_n(m_sampleBuffers[3].data(), nFrames, outputs[1]);
+#else
+    m_voiceManager.tick(inputs[0], inputs[1], outputs[0], outputs[1], events.data(), int(events.size()));
+#endif
 
     m_MIDIReceiver.Flush(nFrames);
     m_tickCount++;
@@ -99,6 +112,7 @@ bool VOSIMSynth::SerializeState(ByteChunk* pChunk) {
     // Store synthesizer data
     json& synth = j["synth"] = json();
     synth["circuit"] = circuit.operator json();
+    synth["global_circuit"] = m_voiceManager.getGlobalCircuit().operator json();
 
     // Store gui data
     j["gui"] = GetAppWindow()->operator json();
@@ -115,6 +129,7 @@ int VOSIMSynth::UnserializeState(ByteChunk* pChunk, int startPos) {
     startPos = pChunk->Get(&input, startPos);
     std::stringstream ss{ input };
 
+    const bool wasAudioActive = m_voiceManager.isAudioActive();
     try {
         json j; ss >> j;
 
@@ -127,21 +142,39 @@ int VOSIMSynth::UnserializeState(ByteChunk* pChunk, int startPos) {
             throw std::runtime_error("Error loading circuit.");
         }
 
+        // Presets saved before the global circuit existed fall back to passing the voice mix through
+        std::unique_ptr<syn::Unit> globalCircuit;
+        if (synth.find("global_circuit") != synth.end()) {
+            globalCircuit.reset(syn::Unit::fromJSON(synth["global_circuit"]));
+            if (!globalCircuit) {
+                throw std::runtime_error("Error loading global circuit.");
+            }
+        }
+
+        // The host holds the plug-in's mutex, so the audio thread cannot tick until the state is loaded, and
+        // the voice manager has to apply the new circuits itself
+        m_voiceManager.setAudioActive(false);
         // Reset gui
         GetAppWindow()->reset();
-        // Load new circuit into voice manager
+        // Load new circuits into voice manager
         m_voiceManager.setPrototypeCircuit(*static_cast<const syn::Circuit*>(circuit));
+        if (globalCircuit)
+            m_voiceManager.setGlobalCircuit(*static_cast<const syn::Circuit*>(globalCircuit.get()));
+        else
+            m_voiceManager.resetGlobalCircuit();
         // Inform new circuit of buffer size, sampling rate, etc...
         Reset();
         // Load gui
         GetAppWindow()->load(gui);
         m_voiceManager.onIdle();
+        m_voiceManager.setAudioActive(wasAudioActive);
         startPos += ss.gcount();
         return startPos;
     } catch (const std::exception& e) {
         std::ostringstream alertmsg;
         alertmsg << "Unable to load preset!" << std::endl;
         alertmsg << e.what();
+        m_voiceManager.setAudioActive(wasAudioActive);
         GetAppWindow()->alert("Error", alertmsg.str(), nanogui::MessageDialog::Type::Warning);
         return -1;
     }
@@ -211,9 +244,18 @@ void VOSIMSynth::registerUnitWidgets(synui::CircuitWidget& a_cw)
 }
 
 
+void VOSIMSynth::OnActivate(bool active) {
+    // Called with the plug-in's mutex held, so no tick is in progress
+    m_voiceManager.setAudioActive(active);
+}
+
 void VOSIMSynth::Reset() {
     SYN_TIMING_TRACE
     m_MIDIReceiver.Resize(GetBlockSize());
     m_voiceManager.setBufferSize(GetBlockSize());
+#if defined(VOSIMLIB_SINGLE_PRECISION)
+    for (std::vector<syn::Sample>& buffer : m_sampleBuffers)
+        buffer.resize(GetBlockSize());
+#endif
     m_voiceManager.setFs(GetSampleRate());
 }
\ No newline at end of file